@@ -3,6 +3,7 @@
 #include <fstream>
 
 #include <external/ImGui/imgui.h>
+#include <external/portable-file-dialogs/portable-file-dialogs.h>
 
 #include <external/imgui_node/imgui_node_editor_internal.h>
 
@@ -14,6 +15,7 @@ namespace ed = ax::NodeEditor;
 static const char *node_type_to_name[] = {
 	"Input", "Clip Node", "Synced Clip Node",
 	"Linear Blend Node", "1D Blend Node",
+	"Layer Blend Node", "Additive Node", "IK Node",
 	"Output Node"
 };
 constexpr int node_types_len = (sizeof(node_type_to_name) / sizeof(*node_type_to_name));
@@ -24,6 +26,9 @@ static const gef::Colour node_colours[] = {
 	gef::Colour::dark_green, // sync clip
 	gef::Colour::red,        // blend
 	gef::Colour::purple,     // blend1d
+	gef::Colour::gold,       // layer blend
+	gef::Colour::sky_blue,   // additive
+	gef::Colour::pink,       // ik
 	gef::Colour::orange,     // output
 };
 
@@ -58,9 +63,16 @@ void Anim3DEditor::init(AnimSystem3D *anim_sys, gef::Platform &plat) {
 void Anim3DEditor::cleanup() {
 	ed::DestroyEditor(ctx);
 	links.destroy();
+	// the nodes are in the arena, which doesn't call their destructors
+	for (Node *node = head_node; node; node = node->next) {
+		node->ik_rig.destroy();
+	}
 	head_node = nullptr;
 	first_free = nullptr;
 	arena.cleanup();
+#ifdef BLEND_TREE_PROFILER
+	profiled_node = nullptr;
+#endif
 }
 
 void Anim3DEditor::draw() {
@@ -95,6 +107,15 @@ void Anim3DEditor::draw() {
 		ImGui::EndPopup();
 	}
 
+#ifdef BLEND_TREE_PROFILER
+	ImGui::SameLine();
+	ImGui::Checkbox("Profiler", &show_profiler);
+
+	if (show_profiler) {
+		drawProfilerTimeline();
+	}
+#endif
+
 	ed::SetCurrentEditor(ctx);
 	ed::Begin("Blend Tree");
 
@@ -104,6 +125,12 @@ void Anim3DEditor::draw() {
 		auto context = (ed::Detail::EditorContext *)ctx;
 		bool is_first_time = !context->FindNode(node->id);
 
+#ifdef BLEND_TREE_PROFILER
+		if (show_profiler) {
+			ed::PushStyleColor(ed::StyleColor_NodeBg, getProfilerHeat(node));
+		}
+#endif
+
 		ed::BeginNode(node->id);
 		ImGui::PushID(node);
 
@@ -113,18 +140,36 @@ void Anim3DEditor::draw() {
 
 		ImGui::Text(node_type_to_name[(int)node->type]);
 
+#ifdef BLEND_TREE_PROFILER
+		if (show_profiler) {
+			drawProfilerStats(node);
+		}
+#endif
+
 		switch (node->type) {
 		case Node::Type::Anim:     drawClip(node); break;
 		case Node::Type::Clip:     drawClipNode(node); break;
 		case Node::Type::SyncClip: drawSyncedClipNode(node); break;
 		case Node::Type::Blend:    drawBlendNode(node); break;
 		case Node::Type::Blend1D:  drawBlendNode1D(node); break;
+		case Node::Type::LayerBlend: drawLayerBlendNode(node); break;
+		case Node::Type::Additive: drawAdditiveNode(node); break;
+		case Node::Type::IK:       drawIKNode(node); break;
 		case Node::Type::Output:   drawOutputNode(node); break;
 		default: fatal("unrecognized node type"); break;
 		}
 
 		ImGui::PopID();
 		ed::EndNode();
+
+#ifdef BLEND_TREE_PROFILER
+		if (show_profiler) {
+			ed::PopStyleColor();
+			if (ed::IsNodeSelected(node->id)) {
+				profiled_node = node;
+			}
+		}
+#endif
 	}
 
 	for (Link &link : links) {
@@ -224,6 +269,11 @@ void Anim3DEditor::draw() {
 				}
 
 				if (ed::AcceptDeletedItem()) {
+#ifdef BLEND_TREE_PROFILER
+					if (profiled_node == deleted) {
+						profiled_node = nullptr;
+					}
+#endif
 					removeNode(deleted);
 					first_free = deleted;
 					deleted->next = first_free;
@@ -293,6 +343,9 @@ void Anim3DEditor::draw() {
 					case Node::Type::SyncClip: addSyncedClipNode(); break;
 					case Node::Type::Blend:    addBlendNode(); break;
 					case Node::Type::Blend1D:  addBlendNode1D(); break;
+					case Node::Type::LayerBlend: addLayerBlendNode(); break;
+					case Node::Type::Additive: addAdditiveNode(); break;
+					case Node::Type::IK:       addIKNode(); break;
 					default: fatal("unknown node type"); break;
 					}
 
@@ -468,9 +521,80 @@ void Anim3DEditor::generateFromNode(
 
 		break;
 	}
+	case NodeType::LayerBlend:
+	{
+		LayerBlendNode *node = (LayerBlendNode *)base_node;
+		gef::Vector2 p = pos;
+
+		addLayerBlendNode();
+		p.x -= offset_x;
+		head_node->pos = p;
+		links.push_back({ unique_id++, &head_node->output, &pin });
+		head_node->float_value = node->blending_value;
+		head_node->joint_name = node->root_joint;
+
+		new_node = node;
+		new_clip = head_node;
+
+		generateFromNode(node->input_nodes[0], new_clip, new_clip->inputs[0], p);
+		generateFromNode(node->input_nodes[1], new_clip, new_clip->inputs[1], p);
+
+		pos.y = p.y + 25.f;
+
+		break;
+	}
+	case NodeType::Additive:
+	{
+		AdditiveNode *node = (AdditiveNode *)base_node;
+		gef::Vector2 p = pos;
+
+		addAdditiveNode();
+		p.x -= offset_x;
+		head_node->pos = p;
+		links.push_back({ unique_id++, &head_node->output, &pin });
+		head_node->float_value = node->blending_value;
+
+		new_node = node;
+		new_clip = head_node;
+
+		generateFromNode(node->input_nodes[0], new_clip, new_clip->inputs[0], p);
+
+		addClip(node->clip);
+		p.x -= offset_x;
+		p.y += 100.f;
+		head_node->pos = p;
+		links.push_back({ unique_id++, &head_node->output, &new_clip->inputs[1] });
+		head_node->float_value = node->clip->playback_speed;
+
+		pos.y = p.y + 125.f;
+
+		break;
+	}
+	case NodeType::IK:
+	{
+		IKNode *node = (IKNode *)base_node;
+		gef::Vector2 p = pos;
+
+		addIKNode();
+		p.x -= offset_x;
+		head_node->pos = p;
+		links.push_back({ unique_id++, &head_node->output, &pin });
+		head_node->float_value = node->rig.weight;
+		head_node->ik_rig = gef::ptr<IKRig>::make(node->rig);
+
+		new_node = node;
+		new_clip = head_node;
+
+		generateFromNode(node->input_nodes[0], new_clip, new_clip->inputs[0], p);
+
+		pos.y = p.y + 25.f;
+
+		break;
+	}
 	}
 
 	assert(new_clip);
+	new_clip->tree_node = new_node;
 	
 	float *bind_value = new_node->getInputValue();
 	if (auto bound_name = isBinded(tree, bind_value)) {
@@ -593,12 +717,165 @@ void Anim3DEditor::drawBlendNode1D(Node *node) {
 	}
 }
 
+void Anim3DEditor::drawLayerBlendNode(Node *node) {
+	assert(node && node->inputs.size() == 2);
+
+	drawPinIn(node->inputs[0], "-> base");
+
+	ImGui::SameLine();
+
+	drawPinOut(node->output);
+
+	drawPinIn(node->inputs[1], "-> layer");
+
+	ImGui::SetNextItemWidth(50.f);
+	ImGui::DragFloat("Blend", &node->float_value, 0.01f, 0.f, 1.f);
+
+	ImGui::SetNextItemWidth(100.f);
+	imInputText("Root joint", node->joint_name);
+	imHelper("The layer overrides this joint and all of its children, e.g. Spine1");
+
+	if (ImGui::Checkbox("Bind", &node->bind_value) && node->bind_value) {
+		bind_popup = node;
+	}
+}
+
+void Anim3DEditor::drawAdditiveNode(Node *node) {
+	assert(node && node->inputs.size() == 2);
+
+	drawPinIn(node->inputs[0], "-> base");
+
+	ImGui::SameLine();
+
+	drawPinOut(node->output);
+
+	drawPinIn(node->inputs[1], "-> additive clip");
+
+	ImGui::SetNextItemWidth(50.f);
+	ImGui::DragFloat("Weight", &node->float_value, 0.01f, 0.f, 1.f);
+
+	if (ImGui::Checkbox("Bind", &node->bind_value) && node->bind_value) {
+		bind_popup = node;
+	}
+}
+
+void Anim3DEditor::drawIKNode(Node *node) {
+	assert(node && node->inputs.size() == 1);
+
+	drawPinIn(node->inputs[0], "-> base");
+
+	ImGui::SameLine();
+
+	drawPinOut(node->output);
+
+	ImGui::SetNextItemWidth(50.f);
+	ImGui::DragFloat("Weight", &node->float_value, 0.01f, 0.f, 1.f);
+	ImGui::Text("%d chains", node->ik_rig ? node->ik_rig->getChainCount() : 0);
+	imHelper("The chains and their targets are set up in the Inverse Kinematics system");
+
+	if (ImGui::Checkbox("Bind", &node->bind_value) && node->bind_value) {
+		bind_popup = node;
+	}
+}
+
 void Anim3DEditor::drawOutputNode(Node *node) {
 	assert(node && node->inputs.size() == 1);
 
 	drawPinIn(node->inputs[0], "-> output");
 }
 
+#ifdef BLEND_TREE_PROFILER
+
+void Anim3DEditor::drawProfilerTimeline() {
+	BlendTreeProfiler &profiler = tree->profiler;
+
+	ImGui::Checkbox("Pause", &profiler.paused);
+	ImGui::SameLine();
+
+	if (ImGui::Button("Export CSV")) {
+		std::string destination = pfd::save_file::save_file(
+			"Export profile",
+			".",
+			{ "CSV file (.csv)", "*.csv" }
+		).result();
+		if (!destination.empty()) {
+			if (!strEndsWith(destination, ".csv")) {
+				destination += ".csv";
+			}
+			profiler.exportCsv(destination.c_str());
+		}
+	}
+
+	const float plot_width = ImGui::GetContentRegionAvail().x;
+	const int frame_count = profiler.getFrameCount();
+
+	auto overlay = strfmt("tree: %.1fus", profiler.getFrameTime());
+	ImGui::PlotLines(
+		"##TreeTime",
+		profiler.getFrameTimes(),
+		frame_count,
+		profiler.getHistoryOffset(),
+		overlay.get(),
+		0.f, FLT_MAX,
+		{ plot_width, 50.f }
+	);
+
+	// find the maximum self time of the last frame, used to colour the nodes
+	max_self_us = 0.f;
+	for (int i = 0; i < profiler.getNodeCount(); ++i) {
+		max_self_us = gef::max(max_self_us, profiler.getAverage(i).self_us);
+	}
+
+	if (!profiled_node || !profiled_node->tree_node) {
+		ImGui::TextDisabled("select a node to see its timeline");
+		return;
+	}
+
+	// oldest to newest
+	float node_times[BlendTreeProfiler::history_len] = { 0 };
+	int node_id = profiled_node->tree_node->profile_id;
+	for (int i = 0; i < frame_count; ++i) {
+		if (const NodeStats *stats = profiler.getStats(node_id, frame_count - 1 - i)) {
+			node_times[i] = stats->self_us;
+		}
+	}
+
+	overlay = strfmt("%s: %.1fus", node_type_to_name[(int)profiled_node->type], node_times[gef::max(frame_count - 1, 0)]);
+	ImGui::PlotLines(
+		"##NodeTime",
+		node_times,
+		frame_count,
+		0,
+		overlay.get(),
+		0.f, FLT_MAX,
+		{ plot_width, 50.f }
+	);
+}
+
+void Anim3DEditor::drawProfilerStats(Node *node) {
+	if (!node->tree_node) {
+		return;
+	}
+
+	NodeStats stats = tree->profiler.getAverage(node->tree_node->profile_id);
+	ImGui::Text("%.1fus (%.1fus)", stats.self_us, stats.total_us);
+	ImGui::Text("samples: %u blends: %u", stats.samples, stats.blends);
+}
+
+gef::Colour Anim3DEditor::getProfilerHeat(Node *node) {
+	static const gef::Colour cold = { 0.12f, 0.12f, 0.12f, 0.8f };
+	static const gef::Colour hot = { 0.8f, 0.1f, 0.05f, 0.9f };
+
+	if (!node->tree_node || max_self_us <= 0.f) {
+		return cold;
+	}
+
+	float heat = tree->profiler.getAverage(node->tree_node->profile_id).self_us / max_self_us;
+	return gef::lerp(cold, hot, gef::clamp(heat, 0.f, 1.f));
+}
+
+#endif
+
 Node *Anim3DEditor::makeNode() {
 	Node *node = nullptr;
 	if (first_free) {
@@ -674,6 +951,35 @@ void Anim3DEditor::addBlendNode1D() {
 	node->output = { ed::PinId(unique_id++), ed::PinKind::Output, node };
 }
 
+void Anim3DEditor::addLayerBlendNode() {
+	Node *node = makeNode();
+	node->type = Node::Type::LayerBlend;
+	node->id = unique_id++;
+	node->float_value = 1.f;
+	node->inputs.push_back({ unique_id++, ed::PinKind::Input, node });
+	node->inputs.push_back({ unique_id++, ed::PinKind::Input, node });
+	node->output = { ed::PinId(unique_id++), ed::PinKind::Output, node };
+}
+
+void Anim3DEditor::addAdditiveNode() {
+	Node *node = makeNode();
+	node->type = Node::Type::Additive;
+	node->id = unique_id++;
+	node->float_value = 1.f;
+	node->inputs.push_back({ unique_id++, ed::PinKind::Input, node });
+	node->inputs.push_back({ unique_id++, ed::PinKind::Input, node, Pin::Type::Clip });
+	node->output = { ed::PinId(unique_id++), ed::PinKind::Output, node };
+}
+
+void Anim3DEditor::addIKNode() {
+	Node *node = makeNode();
+	node->type = Node::Type::IK;
+	node->id = unique_id++;
+	node->float_value = 1.f;
+	node->inputs.push_back({ unique_id++, ed::PinKind::Input, node });
+	node->output = { ed::PinId(unique_id++), ed::PinKind::Output, node };
+}
+
 void Anim3DEditor::addOutputNode() {
 	Node *node = makeNode();
 	node->type = Node::Type::Output;
@@ -701,7 +1007,16 @@ bool Anim3DEditor::buildTreeFromNode(Node *node, Pin *end_pin, ITreeNode *child)
 		Pin *clip_pin = anim_to_clip->end;
 		Node *clip_node = clip_pin->node;
 		
-		if (clip_node->type == Node::Type::SyncClip) {
+		if (clip_node->type == Node::Type::Additive) {
+			AdditiveNode *additive = (AdditiveNode *)child;
+			if (!node->clip->isAdditive()) {
+				fail_reason = strfmt("Clip %s is not additive", node->clip->name);
+				return false;
+			}
+			additive->clip = node->clip;
+			additive->clip->playback_speed = node->float_value;
+		}
+		else if (clip_node->type == Node::Type::SyncClip) {
 			SyncedClipNode *clip = (SyncedClipNode *)child;
 			if (clip_pin == &clip_node->inputs[0]) {
 				clip->clip = node->clip;
@@ -741,6 +1056,35 @@ bool Anim3DEditor::buildTreeFromNode(Node *node, Pin *end_pin, ITreeNode *child)
 		new_node = clip;
 		break;
 	}
+	case Node::Type::LayerBlend:
+	{
+		LayerBlendNode *clip = tree->arena.make<LayerBlendNode>(*tree);
+		clip->blending_value = node->float_value;
+		if (!clip->setRootJoint(node->joint_name.c_str())) {
+			fail_reason = strfmt("Couldn't find root joint \"%s\" in the skeleton", node->joint_name.c_str());
+			return false;
+		}
+		new_node = clip;
+		break;
+	}
+	case Node::Type::Additive:
+	{
+		AdditiveNode *clip = tree->arena.make<AdditiveNode>(*tree);
+		clip->blending_value = node->float_value;
+		new_node = clip;
+		break;
+	}
+	case Node::Type::IK:
+	{
+		IKNode *clip = tree->arena.make<IKNode>(*tree);
+		if (node->ik_rig) {
+			clip->rig = *node->ik_rig;
+		}
+		clip->rig.weight = node->float_value;
+		clip->buildRig();
+		new_node = clip;
+		break;
+	}
 	}
 
 	if (child) child->input_nodes.emplace_back(new_node);
@@ -750,6 +1094,8 @@ bool Anim3DEditor::buildTreeFromNode(Node *node, Pin *end_pin, ITreeNode *child)
 		tree->all_nodes.emplace_back(new_node);
 	}
 
+	node->tree_node = new_node;
+
 	bool is_valid = true;
 
 	if (node->bind_value) {
@@ -787,6 +1133,14 @@ bool Anim3DEditor::buildTreeFromNode(Node *node, Pin *end_pin, ITreeNode *child)
 
 bool Anim3DEditor::buildTree() {
 	assert(tree);
+
+	// the old tree is about to go, keep the chains of its ik nodes for the new one
+	for (Node *node = head_node; node; node = node->next) {
+		if (node->type == Node::Type::IK && node->tree_node) {
+			node->ik_rig = gef::ptr<IKRig>::make(((IKNode *)node->tree_node)->rig);
+		}
+	}
+
 	tree->cleanup();
 	tree->mesh = system->getSkinnedMesh();
 	fail_reason.destroy();
@@ -803,10 +1157,17 @@ bool Anim3DEditor::buildTree() {
 	}
 	assert(output);
 
+	for (Node *node = head_node; node; node = node->next) {
+		node->tree_node = nullptr;
+	}
+
 	bool success = buildTreeFromNode(output, &output->inputs[0], nullptr);
 
 	if (!success) {
 		tree->cleanup();
+		for (Node *node = head_node; node; node = node->next) {
+			node->tree_node = nullptr;
+		}
 	}
 
 	return success;
@@ -4,15 +4,18 @@
 
 #include <system/ptr.h>
 #include <system/vec.h>
+#include <graphics/colour.h>
 #include <external/imgui_node/imgui_node_editor.h>
 
 #include "arena.h"
+#include "blend_tree_profiler.h"
 
 namespace gef {
 	class Platform;
 } // namespace gef
 
 class AnimSystem3D;
+class IKRig;
 struct Animation3D;
 struct BlendTree;
 struct ITreeNode;
@@ -36,7 +39,7 @@ struct Pin {
 
 struct Node {
 	enum class Type : uint8_t {
-		Anim, Clip, SyncClip, Blend, Blend1D, Output, Count
+		Anim, Clip, SyncClip, Blend, Blend1D, LayerBlend, Additive, IK, Output, Count
 	};
 
 	Node(Arena &arena);
@@ -49,10 +52,18 @@ struct Node {
 
 	Animation3D *clip = nullptr;
 	float float_value = 0.f;
+	// root of the masked subtree for layer blend nodes
+	std::string joint_name;
+	// chains of ik nodes, they're set up in the ik system so they're
+	// only kept here to survive the tree being built again
+	gef::ptr<IKRig> ik_rig;
 
 	bool bind_value = false;
 	std::string bind_name;
 
+	// node in the blend tree that was built from this one
+	ITreeNode *tree_node = nullptr;
+
 	Node *next = nullptr;
 	Node *prev = nullptr;
 };
@@ -91,8 +102,17 @@ private:
 	void drawSyncedClipNode(Node *node);
 	void drawBlendNode(Node *node);
 	void drawBlendNode1D(Node *node);
+	void drawLayerBlendNode(Node *node);
+	void drawAdditiveNode(Node *node);
+	void drawIKNode(Node *node);
 	void drawOutputNode(Node *node);
 
+#ifdef BLEND_TREE_PROFILER
+	void drawProfilerTimeline();
+	void drawProfilerStats(Node *node);
+	gef::Colour getProfilerHeat(Node *node);
+#endif
+
 	Node *makeNode();
 	void removeNode(Node *node);
 
@@ -101,6 +121,9 @@ private:
 	void addSyncedClipNode();
 	void addBlendNode();
 	void addBlendNode1D();
+	void addLayerBlendNode();
+	void addAdditiveNode();
+	void addIKNode();
 	void addOutputNode();
 
 	bool buildTreeFromNode(Node *node, Pin *end_pin, ITreeNode *child_clip);
@@ -132,4 +155,10 @@ private:
 	Popup<Node *> clip_popup = nullptr;
 	Popup<Int64> new_node_popup = 0;
 	Popup<Node *> bind_popup = nullptr;
+
+#ifdef BLEND_TREE_PROFILER
+	bool show_profiler = false;
+	Node *profiled_node = nullptr;
+	float max_self_us = 0.f;
+#endif
 };
\ No newline at end of file
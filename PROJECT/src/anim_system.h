@@ -4,7 +4,7 @@
 #include "utils.h"
 
 enum class AnimSystemType {
-	None, Sprite2D, Skeleton2D, Skeleton3D, InverseKinematics, Count
+	None, Sprite2D, Skeleton2D, Skeleton3D, InverseKinematics, Crowd, Count
 };
 
 constexpr int INVALID_ID = -1;
@@ -30,6 +30,9 @@ public:
 	virtual gef::Transform getTransform() const = 0;
 	virtual void setTransform(const gef::Transform &tran) = 0;
 
+	// the app switched to another system, this one won't be updated until it's picked again
+	virtual void deactivate() {}
+
 	int getCurrentId() const { return cur_animation; }
 
 	AnimSystemType getType() const { assert((int)type); return type; }
@@ -21,6 +21,8 @@ format_ver       | uint8_t
 transform        | float * 16
 scene_file_len   | uint8_t
 scene_filename   | char * scene_file_len
+retarget_len     | uint8_t (since version 6)
+retarget_source  | char * retarget_len
 animations_count | uint8_t
 -----------------------------------
 			 animation			   
@@ -29,8 +31,16 @@ filename_len     | uint8_t
 filename         | char * filename_len
 name_len         | uint8_t
 name             | char * name_len
+additive         | uint8_t (since version 3)
+root_motion      | bool (since version 5)
 playback_spd     | float
 looping          | bool
+event_count      | uint8_t (since version 4)
+------------ for each event -------
+time             | float
+event_type       | uint8_t
+name_len         | uint8_t
+name             | char * name_len
 -----------------------------------
 			 blend tree
 -----------------------------------
@@ -53,6 +63,20 @@ blend            | float
 right            | uint8_t
 centre           | uint8_t
 left             | uint8_t
+  ~~~~~~ layer blend node ~~~~~~~
+blend            | float
+base             | uint8_t
+layer            | uint8_t
+root_len         | uint8_t
+root_joint       | char * root_len
+  ~~~~~~~~ additive node ~~~~~~~~
+clip_id          | uint8_t
+blend            | float
+base             | uint8_t
+  ~~~~~~~~~~~ ik node ~~~~~~~~~~~ (since version 7)
+weight           | float
+base             | uint8_t
+rig              | see IKRig::save (joint limits since version 8)
 ---------- for each value ---------
 node_id          | uint8_t
 namelen          | uint8_t
@@ -62,36 +86,27 @@ name             | char * namelen
 // increase this every time a change to the format is made
 // it'll make sure that it won't try to load the wrong 
 // version of the file
-static constexpr uint8_t format_ver = 2;
-
-bool Animation3D::updateTimer(float delta_time) {
-	timer += delta_time * playback_speed;
-	if (timer >= duration) {
-		timer = 0;
-		if (!looping) {
-			return true;
-		}
-	}
+static constexpr uint8_t format_ver = 8;
+// oldest version that can still be read
+static constexpr uint8_t min_format_ver = 2;
 
-	return false;
-}
+// == ANIMATION 3D ==================================
 
-void Animation3D::updatePose(gef::SkeletonPose &pose, const gef::SkeletonPose &bind_pose) {
-	// add the clip start time to the playback time to calculate the final time
-	// that will be used to sample the animation data
-	float anim_time = timer + anim_data.start_time();
-
-	// sample the animation data at the calculated time
-	// any bones that don't have animation data are set to the bind pose
-	pose.SetPoseFromAnim(anim_data, bind_pose, anim_time);
+void Animation3D::bindSkeleton(const gef::Skeleton &skeleton, const RetargetMap *retarget) {
+	binding = clip.bind(skeleton, retarget);
 }
 
-bool Animation3D::update(float delta_time, gef::SkeletonPose &pose, const gef::SkeletonPose &bind_pose) {
-	bool finished = updateTimer(delta_time);
-	updatePose(pose, bind_pose);
-	return finished;
+void Animation3D::sample(float time, const gef::SkeletonPose &bind_pose, gef::SkeletonPose &out_pose, const Int32 *joints, size_t joint_count) const {
+	if (binding) {
+		::sample(*clip, *binding, time, bind_pose, out_pose, joints, joint_count);
+	}
+	else {
+		::sample(*clip, time, bind_pose, out_pose, joints, joint_count);
+	}
 }
 
+// == ANIM SYSTEM 3D ================================
+
 bool AnimSystem3D::update(float delta_time) {
 	if (!skinned_mesh) {
 		return true;
@@ -105,24 +120,94 @@ bool AnimSystem3D::update(float delta_time) {
 
 	delta_time *= speed_multiplier;
 
-	if (is_using_blend_tree) {
+	// culled characters still advance their clips, but they don't update the palette.
+	// the last bounds move with the character so root motion can bring it back in view
+	is_visible = cull();
+	if (!is_visible) {
+		culled_frames++;
+	}
+
+	const gef::SkeletonPose *pose = nullptr;
+
+	if (is_using_motion_matching) {
+		applyRootMotion(motion_matcher.update(delta_time, anim_pose));
+		pose = &anim_pose;
+	}
+	else if (is_using_blend_tree) {
 		blend_tree.update(delta_time);
+		applyRootMotion(blend_tree.root_motion);
+		pose = blend_tree.getPose();
 	}
-	else {
-		if (isAnimationIdValid(cur_animation)) {
-			animations[cur_animation].update(delta_time, anim_pose, skinned_mesh->bind_pose());
-			skinned_mesh->UpdateBoneMatrices(anim_pose);
-		}
-		else {
-			skinned_mesh->UpdateBoneMatrices(skinned_mesh->bind_pose());
+	else if (isAnimationIdValid(cur_animation)) {
+		const Animation3D &anim = animations[cur_animation];
+		anim.advance(playback, delta_time);
+		anim.events.emit(playback, event_queue, (int16_t)cur_animation);
+		applyRootMotion(anim.clip->root_motion.extract(playback));
+		if (is_visible) {
+			anim.sample(playback.time, skinned_mesh->bind_pose(), anim_pose);
 		}
+		pose = &anim_pose;
+	}
+	else {
+		pose = &skinned_mesh->bind_pose();
+	}
+
+	if (pose && is_visible) {
+		updateBounds(*pose);
+		skinned_mesh->UpdateBoneMatrices(*pose);
 	}
 
 	return false;
 }
 
+bool AnimSystem3D::cull() {
+	world_bounds = transformAabb(model_bounds, skinned_mesh->transform());
+
+	if (!is_using_culling || !renderer) {
+		return true;
+	}
+
+	// the camera is set by the app before drawing, so this is last frame's, close enough
+	frustum.ExtractPlanesD3D(renderer->view_matrix() * renderer->projection_matrix(), true);
+	return frustum.Intersects(world_bounds) != gef::FI_OUT;
+}
+
+void AnimSystem3D::updateBounds(const gef::SkeletonPose &pose) {
+	if (!skinned_bounds.empty()) {
+		model_bounds = skinned_bounds.calculate(pose);
+	}
+	else if (mesh) {
+		model_bounds = mesh->aabb();
+	}
+	world_bounds = transformAabb(model_bounds, skinned_mesh->transform());
+
+	if (is_using_picking && !skinned_bounds.empty()) {
+		double start = timeNowUs();
+		pose_bvh.build(skinned_bounds, pose);
+		bvh_build_us = (float)(timeNowUs() - start);
+	}
+}
+
+void AnimSystem3D::setPicking(bool enabled) {
+	is_using_picking = enabled;
+	if (!enabled) {
+		pose_bvh.clear();
+	}
+}
+
+bool AnimSystem3D::raycast(const gef::Vector4 &start, const gef::Vector4 &direction, RayHit &hit, Int32 ignore_subtree) const {
+	if (!skinned_mesh || pose_bvh.empty()) {
+		return false;
+	}
+
+	// the direction isn't normalised again, so the distance is the same as along the world ray
+	gef::Matrix44 world_to_model;
+	world_to_model.Inverse(skinned_mesh->transform());
+	return pose_bvh.raycast(start.Transform(world_to_model), direction.TransformNoTranslation(world_to_model), hit, ignore_subtree);
+}
+
 void AnimSystem3D::draw() {
-	if (!renderer || !skinned_mesh) {
+	if (!renderer || !skinned_mesh || !is_visible) {
 		return;
 	}
 
@@ -133,36 +218,184 @@ void AnimSystem3D::debugDraw() {
 	ImGui::SliderFloat("speed", &speed_multiplier, 0.f, 1.f);
 	ImGui::Checkbox("use blend tree", &is_using_blend_tree);
 	ImGui::Checkbox("spinning", &spinning);
+	ImGui::Checkbox("root motion", &is_using_root_motion);
+	imHelper("Moves the character with the clips that were loaded with root motion");
+	ImGui::Checkbox("frustum culling", &is_using_culling);
+	imHelper(
+		"Skips the bone matrices and the draw when the animated bounds are outside of the camera. "
+		"The clips keep playing"
+	);
+	ImGui::SameLine();
+	ImGui::Text("%s, culled for %u frames", is_visible ? "visible" : "culled", culled_frames);
+	{
+		gef::Vector4 size = world_bounds.max_vtx() - world_bounds.min_vtx();
+		ImGui::Text("Bounds: %.1f x %.1f x %.1f from %zu joints", size.x(), size.y(), size.z(), skinned_bounds.getJointCount());
+		if (is_using_picking) {
+			ImGui::Text("Picking bvh: %zu nodes, built in %.2f us", pose_bvh.getNodeCount(), bvh_build_us);
+		}
+	}
+	if (ImGui::Checkbox("motion matching", &is_using_motion_matching) && is_using_motion_matching) {
+		motion_matcher.build();
+	}
+	if (is_using_motion_matching && ImGui::TreeNode("Motion matching")) {
+		motion_matcher.debugDraw();
+		ImGui::TreePop();
+	}
 	if (ImGui::Button("Reset Spin")) {
 		const gef::Matrix44 &tran = skinned_mesh->transform();
 		skinned_mesh->set_transform(mat4FromPosScale(tran.GetTranslation(), tran.GetScale()));
 	}
+	ImGui::SameLine();
+	if (ImGui::Button("Reset Position")) {
+		const gef::Matrix44 &tran = skinned_mesh->transform();
+		skinned_mesh->set_transform(mat4FromPosScale(gef::Vector4::kZero, tran.GetScale()));
+	}
+	debugDrawRetarget();
 	ImGui::Separator();
 
 	for (Animation3D &anim : animations) {
 		ImGui::PushID(&anim);
 
 		ImGui::Text("Name: %s", anim.name);
+		if (anim.isAdditive()) {
+			ImGui::Text(
+				"Additive (%s): %zu tracks", 
+				anim.clip->additive == AdditiveMode::FirstFrame ? "first frame" : "bind pose",
+				anim.clip->additive_tracks.size()
+			);
+		}
+		if (anim.clip->has_root_motion) {
+			ImGui::Text("Root motion: %zu keys", anim.clip->root_motion.keys.size());
+		}
+		if (!anim.isAdditive()) {
+			bool root_motion = anim.clip->has_root_motion;
+			if (ImGui::Checkbox("Extract root motion", &root_motion)) {
+				setRootMotion(getAnimationId(&anim), root_motion);
+			}
+		}
 		ImGui::Checkbox("Looping", &anim.looping);
 		imHelper(
 			"This setting does nothing for viewing purposes, "
 			"but all the logic is still implemented"
 		);
 		ImGui::DragFloat("Playback Speed", &anim.playback_speed, 0.1f, 0.f, 5.f);
-		ImGui::Text("Timer: %.3f/%.3f", anim.timer, anim.duration);
+		ImGui::Text("Duration: %.3f", anim.clip->duration);
+		ImGui::Text("Shared by %d", anim.clip->ref_count);
+		debugDrawEvents(anim);
 		ImGui::Separator();
 
 		ImGui::PopID();
 	}
+
+	// the debug ui stands in for the gameplay code here, it drains the events every frame
+	FiredEvent fired;
+	while (event_queue.pop(fired)) {
+		memmove(event_log + 1, event_log, sizeof(FiredEvent) * (event_log_len - 1));
+		event_log[0] = fired;
+		event_log_count = gef::min(event_log_count + 1, event_log_len);
+	}
+
+	ImGui::Text("Fired events (dropped %u)", event_queue.getDropped());
+	for (int i = 0; i < event_log_count; ++i) {
+		const FiredEvent &log = event_log[i];
+		Animation3D *anim = getAnimation(log.clip_id);
+		ImGui::Text(
+			"%s: %s %s at %.2f", anim ? anim->name : "?",
+			getEventTypeName(log.event.type), log.event.name, log.event.time
+		);
+	}
+}
+
+void AnimSystem3D::debugDrawRetarget() {
+	if (!ImGui::TreeNode("Retargeting")) {
+		return;
+	}
+
+	ImGui::InputText("Source skeleton", retarget_input, sizeof(retarget_input));
+	imHelper("Scene file with the skeleton the clips were made for, e.g. ybot/ybot.scn");
+	if (ImGui::Button("Retarget")) {
+		setRetargetSource(retarget_input);
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Clear")) {
+		setRetargetSource(nullptr);
+	}
+
+	if (retarget.empty()) {
+		ImGui::Text("Playing the clips as they are");
+	}
+	else {
+		ImGui::Text("From %s", retarget_source.c_str());
+		ImGui::Text("Matched %d of %zu joints, root scale %.3f", retarget.getMappedCount(), retarget.getJointCount(), retarget.root_scale);
+	}
+
+	ImGui::TreePop();
+}
+
+void AnimSystem3D::debugDrawEvents(Animation3D &anim) {
+	if (!ImGui::TreeNode("Events", "Events (%zu)", anim.events.size())) {
+		return;
+	}
+
+	bool needs_sort = false;
+	for (size_t i = 0; i < anim.events.size(); ++i) {
+		ClipEvent &event = anim.events.events[i];
+		ImGui::PushID((int)i);
+
+		ImGui::SetNextItemWidth(60.f);
+		if (ImGui::DragFloat("##time", &event.time, 0.01f, 0.f, anim.clip->duration, "%.2f")) {
+			needs_sort = true;
+		}
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(90.f);
+		if (ImGui::BeginCombo("##type", getEventTypeName(event.type))) {
+			for (uint8_t t = 0; t < (uint8_t)ClipEventType::Count; ++t) {
+				if (ImGui::Selectable(getEventTypeName((ClipEventType)t), t == (uint8_t)event.type)) {
+					event.type = (ClipEventType)t;
+				}
+			}
+			ImGui::EndCombo();
+		}
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(100.f);
+		ImGui::InputText("##name", event.name, sizeof(event.name));
+		ImGui::SameLine();
+		bool remove = ImGui::Button("x");
+
+		ImGui::PopID();
+
+		if (remove) {
+			anim.events.remove(i);
+			break;
+		}
+	}
+
+	if (needs_sort) {
+		anim.events.sort();
+	}
+
+	if (ImGui::Button("Add event")) {
+		ClipEvent event;
+		event.time = playback.time;
+		anim.events.add(event);
+	}
+	imHelper("Adds an event at the current time of the animation when the blend tree isn't used");
+
+	ImGui::TreePop();
 }
 
 void AnimSystem3D::cleanup() {
 	blend_tree.cleanup();
+	motion_matcher.cleanup();
 	mesh.destroy();
 	skinned_mesh.destroy();
 	textures.clear();
 	materials.clear();
 	animations.clear();
+	skinned_bounds.clear();
+	pose_bvh.clear();
+	retarget.clear();
+	retarget_source.clear();
 }
 
 void AnimSystem3D::setAnimation(const char *name) {
@@ -182,6 +415,7 @@ void AnimSystem3D::setAnimation(int id) {
 		id = INVALID_ID;
 	}
 	cur_animation = id;
+	playback = ClipPlayback();
 }
 
 gef::Transform AnimSystem3D::getTransform() const {
@@ -210,29 +444,105 @@ void AnimSystem3D::read(FILE *fp) {
 	fileRead(scenefile_len, fp);
 	scene_filename.resize(scenefile_len);
 	fileRead(scene_filename, fp);
+	std::string retarget_file;
+	if (file_version >= 6) {
+		uint8_t retarget_len = 0;
+		fileRead(retarget_len, fp);
+		retarget_file.resize(retarget_len);
+		fileRead(retarget_file, fp);
+	}
 	fileRead(animations_count, fp);
 
-	loadSkeleton(scene_filename.c_str());
-	skinned_mesh->set_transform(transform);
+	// start loading every file straight away, loadSkeleton and loadAnimations pick them up
+	AsyncLoader &scene_loader = getLoader();
+	scene_loader.prefetch(scene_filename.c_str(), this);
+	if (!retarget_file.empty()) {
+		scene_loader.prefetch(retarget_file.c_str(), this);
+	}
+
+	struct ClipEntry {
+		std::string filename;
+		char name[sizeof(Animation3D::name)];
+		AdditiveMode additive = AdditiveMode::None;
+		bool root_motion = false;
+		float playback_speed = 1.f;
+		bool looping = true;
+		gef::Vec<ClipEvent> events;
+	};
+	gef::Vec<ClipEntry> entries;
+	entries.reserve(animations_count);
 
 	for (uint8_t i = 0; i < animations_count; ++i) {
 		uint8_t filename_len = 0;
 		uint8_t name_len = 0;
-		std::string filename;
+		ClipEntry entry;
 
 		fileRead(filename_len, fp);
-		filename.resize(filename_len);
-		fileRead(filename, fp);
+		entry.filename.resize(filename_len);
+		fileRead(entry.filename, fp);
 		fileRead(name_len, fp);
-		char name[sizeof(Animation3D::name)];
-		memset(name, 0, sizeof(name));
-		fread(name, 1, name_len, fp);
+		memset(entry.name, 0, sizeof(entry.name));
+		fread(entry.name, 1, name_len, fp);
+		if (file_version >= 3) {
+			fileRead(entry.additive, fp);
+		}
+		if (file_version >= 5) {
+			fileRead(entry.root_motion, fp);
+		}
+		fileRead(entry.playback_speed, fp);
+		fileRead(entry.looping, fp);
+		if (file_version >= 4) {
+			uint8_t event_count = 0;
+			fileRead(event_count, fp);
+			entry.events.reserve(event_count);
+			for (uint8_t e = 0; e < event_count; ++e) {
+				ClipEvent event;
+				uint8_t event_name_len = 0;
+				fileRead(event.time, fp);
+				fileRead(event.type, fp);
+				fileRead(event_name_len, fp);
+				fread(event.name, 1, gef::min(event_name_len, (uint8_t)(sizeof(event.name) - 1)), fp);
+				if (event_name_len >= sizeof(event.name)) {
+					fseek(fp, event_name_len - (sizeof(event.name) - 1), SEEK_CUR);
+				}
+				entry.events.push_back(event);
+			}
+		}
+
+		// the skeleton isn't loaded yet, so baked clips always miss the library here
+		if (!getClipLibrary().find(entry.filename.c_str(), nullptr, entry.additive, entry.root_motion)) {
+			scene_loader.prefetch(entry.filename.c_str(), this);
+		}
+		entries.emplace_back(std::move(entry));
+	}
+
+	loadSkeleton(scene_filename.c_str());
+	skinned_mesh->set_transform(transform);
+	setRetargetSource(retarget_file.c_str());
+
+	gef::Vec<ClipRequest> requests;
+	requests.reserve(entries.size());
+	for (const ClipEntry &entry : entries) {
+		ClipRequest request;
+		request.filename = entry.filename.c_str();
+		request.name = entry.name;
+		request.additive = entry.additive;
+		request.root_motion = entry.root_motion;
+		requests.emplace_back(request);
+	}
 
-		loadAnimation(filename.c_str(), name);
-		Animation3D &anim = animations.back();
-		fileRead(anim.playback_speed, fp);
-		fileRead(anim.looping, fp);
+	int first_id = loadAnimations(requests.data(), (int)requests.size());
+	if (first_id != INVALID_ID) {
+		for (size_t i = 0; i < entries.size(); ++i) {
+			Animation3D &anim = animations[first_id + i];
+			anim.playback_speed = entries[i].playback_speed;
+			anim.looping = entries[i].looping;
+			anim.events.events = std::move(entries[i].events);
+			anim.events.sort();
+		}
 	}
+	// clips that were found in the library with the skeleton weren't loaded
+	scene_loader.dropPrefetches(this);
 
 	blend_tree.init(this);
 	blend_tree.read(fp);
@@ -247,6 +557,8 @@ void AnimSystem3D::save(FILE *fp) const {
 	fileWrite(skinned_mesh->transform(), fp);
 	fileWrite((uint8_t)scene_filename.size(), fp);
 	fileWrite(scene_filename, fp);
+	fileWrite((uint8_t)retarget_source.size(), fp);
+	fileWrite(retarget_source, fp);
 	fileWrite(animations_count, fp);
 
 	for (uint8_t i = 0; i < animations_count; ++i) {
@@ -258,8 +570,19 @@ void AnimSystem3D::save(FILE *fp) const {
 		fileWrite(fname,                 fp);
 		fileWrite(name_len,              fp);
 		fwrite(anim.name, 1, name_len,   fp);
+		fileWrite(anim.clip->additive,   fp);
+		fileWrite(anim.clip->has_root_motion, fp);
 		fileWrite(anim.playback_speed,   fp);
 		fileWrite(anim.looping,          fp);
+
+		fileWrite((uint8_t)anim.events.size(), fp);
+		for (const ClipEvent &event : anim.events.events) {
+			uint8_t event_name_len = (uint8_t)strlen(event.name);
+			fileWrite(event.time, fp);
+			fileWrite(event.type, fp);
+			fileWrite(event_name_len, fp);
+			fwrite(event.name, 1, event_name_len, fp);
+		}
 	}
 
 	blend_tree.save(fp);
@@ -267,9 +590,9 @@ void AnimSystem3D::save(FILE *fp) const {
 
 bool AnimSystem3D::checkFormatVersion(FILE *fp) {
 	if (!fp) return false;
-	uint8_t version = 0;
-	fread(&version, 1, sizeof(version), fp);
-	return version == format_ver;
+	file_version = 0;
+	fread(&file_version, 1, sizeof(file_version), fp);
+	return file_version >= min_format_ver && file_version <= format_ver;
 }
 
 void AnimSystem3D::init(gef::Platform &plat, gef::Renderer3D *renderer3D, const char *mesh_fname) {
@@ -285,60 +608,210 @@ void AnimSystem3D::init(gef::Platform &plat, gef::Renderer3D *renderer3D, const
 
 void AnimSystem3D::loadSkeleton(const char *filename) {
 	assert(platform);
-	gef::Platform &plat = *platform;
 	scene_filename = filename;
 
-	SceneLoader model_scene;
-	if (model_scene.loadScene(plat, filename)) {
-		model_scene.createMaterials(plat);
-		model_scene.createMeshes(plat);
-
-		skeleton = model_scene.popFirstSkeleton();
-		mesh = model_scene.popFirstMesh();
+	SceneFuture future = getLoader().load(filename, this);
+	if (SceneLoader *model_scene = getLoader().get(future)) {
+		skeleton = model_scene->popFirstSkeleton();
+		mesh = model_scene->popFirstMesh();
+		joint_map = model_scene->getJointMap(skeleton);
 
 		skinned_mesh = gef::ptr<gef::SkinnedMeshInstance>::make(skeleton);
 		anim_pose = skinned_mesh->bind_pose();
+
+		if (const gef::MeshData *mesh_data = model_scene->getFirstMeshData()) {
+			skinned_bounds.build(*mesh_data, skeleton);
+		}
+		updateBounds(anim_pose);
+		motion_matcher.init(this);
 		skinned_mesh->set_mesh(mesh.get());
 
-		textures = model_scene.moveTextures();
-		materials = model_scene.moveMaterials();
+		textures = model_scene->moveTextures();
+		materials = model_scene->moveMaterials();
 	}
 }
 
-int AnimSystem3D::loadAnimation(const char *anim_scene, const char *anim_name) {
+int AnimSystem3D::loadAnimation(const char *anim_scene, const char *anim_name, AdditiveMode additive) {
+	ClipRequest request;
+	request.filename = anim_scene;
+	request.name = anim_name;
+	request.additive = additive;
+	return loadAnimations(&request, 1);
+}
+
+int AnimSystem3D::loadAnimations(const ClipRequest *requests, int count) {
 	PushAllocInfo("Anim3DLoad");
-	gef::Scene scene;
-	if (scene.ReadSceneFromFile(*platform, anim_scene)) {
-		animation_scenes.emplace_back(anim_scene);
-
-		auto it = scene.animations.begin();
-
-		if (it != scene.animations.end()) {
-			int id = (int)animations.size();
-			Animation3D new_anim(std::move(*it->second));
-			strCopyInto(new_anim.name, anim_name ? anim_name : anim_scene);
-			animations.emplace_back(new_anim);
-			if (cur_animation == INVALID_ID) {
-				cur_animation = id;
-			}
-			
-			PopAllocInfo();
-			return id;
+	AsyncLoader &scene_loader = getLoader();
+
+	ClipLibrary &library = getClipLibrary();
+
+	// start all of them before waiting on any, so they're loaded at the same time.
+	// clips that are already in the library don't need to be loaded again
+	const gef::Skeleton *bind_skeleton = skinned_mesh ? skinned_mesh->bind_pose().skeleton() : nullptr;
+	gef::Vec<ClipRef> clips;
+	gef::Vec<SceneFuture> futures;
+	clips.reserve(count);
+	futures.reserve(count);
+	for (int i = 0; i < count; ++i) {
+		clips.emplace_back(library.find(requests[i].filename, nullptr, requests[i].additive, requests[i].root_motion, bind_skeleton));
+		futures.emplace_back(clips.back() ? nullptr : scene_loader.load(requests[i].filename, this));
+	}
+
+	int first_id = INVALID_ID;
+	for (int i = 0; i < count; ++i) {
+		if (!clips[i]) {
+			clips[i] = addToLibrary(scene_loader.get(futures[i]), requests[i]);
 		}
-		else {
-			fatal("couldn't load animation, no animation in scene");
+		int id = addAnimation(clips[i], requests[i]);
+		if (first_id == INVALID_ID) {
+			first_id = id;
 		}
 	}
-	else {
+
+	PopAllocInfo();
+	return first_id;
+}
+
+ClipRef AnimSystem3D::addToLibrary(SceneLoader *scene, const ClipRequest &request) {
+	if (!scene) {
 		fatal("couldn't load animation, couldn't load scene file");
+		return ClipRef();
 	}
 
-	PopAllocInfo();
-	return INVALID_ID;
+	gef::Animation anim;
+	if (!scene->popFirstAnimation(anim)) {
+		fatal("couldn't load animation, no animation in scene");
+		return ClipRef();
+	}
+
+	const gef::SkeletonPose *bind_pose = skinned_mesh ? &skinned_mesh->bind_pose() : nullptr;
+	return getClipLibrary().add(
+		request.filename, std::move(anim), scene->getStringTable(), 
+		request.additive, bind_pose, request.root_motion
+	);
+}
+
+int AnimSystem3D::addAnimation(const ClipRef &clip, const ClipRequest &request) {
+	if (!clip) {
+		return INVALID_ID;
+	}
+
+	animation_scenes.emplace_back(request.filename);
+
+	int id = (int)animations.size();
+	Animation3D new_anim(clip);
+	strCopyInto(new_anim.name, request.name ? request.name : request.filename);
+	new_anim.bindSkeleton(skeleton, &retarget);
+	animations.emplace_back(new_anim);
+	if (cur_animation == INVALID_ID) {
+		cur_animation = id;
+	}
+
+	return id;
+}
+
+void AnimSystem3D::setRootMotion(int id, bool enabled) {
+	if (!isAnimationIdValid(id)) {
+		return;
+	}
+
+	Animation3D &anim = animations[id];
+	if (anim.clip->has_root_motion == enabled) {
+		return;
+	}
+
+	ClipRequest request;
+	request.filename = animation_scenes[id].c_str();
+	request.name = anim.name;
+	request.additive = anim.clip->additive;
+	request.root_motion = enabled;
+
+	const gef::Skeleton *bind_skeleton = skinned_mesh ? skinned_mesh->bind_pose().skeleton() : nullptr;
+	ClipRef clip = getClipLibrary().find(request.filename, nullptr, request.additive, enabled, bind_skeleton);
+	if (!clip) {
+		AsyncLoader &scene_loader = getLoader();
+		SceneFuture future = scene_loader.load(request.filename, this);
+		clip = addToLibrary(scene_loader.get(future), request);
+	}
+
+	// the tree nodes point to the animation, so swap the clip in place
+	if (clip) {
+		anim.clip = clip;
+		anim.bindSkeleton(skeleton, &retarget);
+	}
+}
+
+bool AnimSystem3D::setRetargetSource(const char *skeleton_scene) {
+	retarget.clear();
+	retarget_source.clear();
+
+	if (!skeleton_scene || !skeleton_scene[0] || !skinned_mesh) {
+		rebindAnimations();
+		return true;
+	}
+
+	AsyncLoader &scene_loader = getLoader();
+	SceneFuture future = scene_loader.load(skeleton_scene, this);
+	SceneLoader *scene = scene_loader.get(future);
+	if (!scene) {
+		err("couldn't load retarget source %s", skeleton_scene);
+		rebindAnimations();
+		return false;
+	}
+
+	gef::Skeleton source_skeleton = scene->popFirstSkeleton();
+	if (source_skeleton.joints().empty()) {
+		err("retarget source %s has no skeleton", skeleton_scene);
+		rebindAnimations();
+		return false;
+	}
+
+	// the map keeps everything it needs, the source skeleton can go away after this
+	gef::SkeletonPose source_bind;
+	source_bind.CreateBindPose(&source_skeleton);
+	if (!retarget.build(source_bind, scene->getJointMap(source_skeleton), skinned_mesh->bind_pose(), joint_map)) {
+		err("no joint of %s matched the skeleton of %s", skeleton_scene, scene_filename.c_str());
+		retarget.clear();
+		rebindAnimations();
+		return false;
+	}
+
+	retarget_source = skeleton_scene;
+	rebindAnimations();
+	return true;
+}
+
+void AnimSystem3D::rebindAnimations() {
+	for (Animation3D &anim : animations) {
+		anim.bindSkeleton(skeleton, &retarget);
+	}
+}
+
+void AnimSystem3D::applyRootMotion(const RootMotion &motion) {
+	if (!is_using_root_motion) {
+		return;
+	}
+	if (retarget.empty()) {
+		skinned_mesh->set_transform(motion.toMatrix() * skinned_mesh->transform());
+		return;
+	}
+	// the curves were baked on the source skeleton, move as much as the target's legs would
+	RootMotion scaled = motion;
+	scaled.x *= retarget.root_scale;
+	scaled.z *= retarget.root_scale;
+	skinned_mesh->set_transform(scaled.toMatrix() * skinned_mesh->transform());
+}
+
+AsyncLoader &AnimSystem3D::getLoader() {
+	if (loader) {
+		return *loader;
+	}
+	sync_loader.init(*platform, nullptr);
+	return sync_loader;
 }
 
 bool AnimSystem3D::isAnimationIdValid(int id) {
-	return id >= 0 && id < animations.size();
+	return id >= 0 && id < (int)animations.size();
 }
 
 void AnimSystem3D::setPose(const gef::SkeletonPose &new_pose) {
@@ -362,6 +835,11 @@ Animation3D *AnimSystem3D::getCurrentAnimation() {
 	return getAnimation(cur_animation);
 }
 
+int AnimSystem3D::getJointId(const std::string &name) const {
+	auto it = joint_map.find(name);
+	return it == joint_map.end() ? INVALID_ID : it->second;
+}
+
 int AnimSystem3D::getAnimationId(const Animation3D *anim) const {
 	size_t index = animations.findIt(anim);
 	return index == SIZE_MAX ? INVALID_ID : (int)index;
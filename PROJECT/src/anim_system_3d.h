@@ -7,9 +7,16 @@
 #include <graphics/mesh.h>
 #include <graphics/material.h>
 #include <graphics/skinned_mesh_instance.h>
+#include <maths/frustum.h>
 
 #include "anim_system.h"
 #include "blend_tree.h"
+#include "async_loader.h"
+#include "clip_library.h"
+#include "clip_events.h"
+#include "motion_matching.h"
+#include "skinned_bounds.h"
+#include "pose_bvh.h"
 
 namespace gef {
 	class Platform;
@@ -18,21 +25,42 @@ namespace gef {
 	class Texture;
 }
 
+// one of the clips to load with loadAnimations
+struct ClipRequest {
+	const char *filename = nullptr;
+	const char *name = nullptr;
+	AdditiveMode additive = AdditiveMode::None;
+	// bakes the movement of the root joint out of the clip, for locomotion clips
+	bool root_motion = false;
+};
+
+// a clip loaded by a system, the clip data itself is shared through the clip library.
+// the playback settings are per system but the time is not, see ClipPlayback
 struct Animation3D {
 	Animation3D() = default;
-	Animation3D(gef::Animation &&anim) 
-		: anim_data(std::move(anim)), duration(anim_data.duration()) {}
-	
-	bool updateTimer(float delta_time);
-	void updatePose(gef::SkeletonPose &pose, const gef::SkeletonPose &bind_pose);
-	bool update(float delta_time, gef::SkeletonPose &pose, const gef::SkeletonPose &bind_pose);
+	Animation3D(ClipRef clip_ref) 
+		: clip(std::move(clip_ref)) {}
+
+	// gets the track of every joint in <skeleton> so sampling doesn't need to look them up by name.
+	// with <retarget> the clip is played on <skeleton> even though it was made for another one
+	void bindSkeleton(const gef::Skeleton &skeleton, const RetargetMap *retarget = nullptr);
+	// samples the clip through the binding if there is one, see sample in clip_library.h
+	void sample(
+		float time, const gef::SkeletonPose &bind_pose, gef::SkeletonPose &out_pose,
+		const Int32 *joints = nullptr, size_t joint_count = 0
+	) const;
+	// advances <playback> with this clip's speed and looping settings
+	bool advance(ClipPlayback &playback, float delta_time) const { return playback.advance(*clip, delta_time, playback_speed, looping); }
+	float getNormalizedTime(const ClipPlayback &playback) const { return playback.getNormalizedTime(*clip); }
+
+	bool isAdditive() const { return clip->additive != AdditiveMode::None; }
 	
-	gef::Animation anim_data;
+	ClipRef clip;
+	const ClipBinding *binding = nullptr;
 	char name[24] = { 0 };
-	float duration = 0.f;
-	float timer = 0.f;
 	float playback_speed = 1.f;
 	bool looping = true;
+	EventTrack events;
 };
 
 class AnimSystem3D : public AnimSystem {
@@ -51,12 +79,35 @@ public:
 	void init(gef::Platform &plat, gef::Renderer3D *renderer3D, const char *mesh_fname);
 	void cleanup();
 
+	// when set, the scene files are loaded on the job system
+	void setAsyncLoader(AsyncLoader *async_loader) { loader = async_loader; }
+
 	void loadSkeleton(const char *filename);
-	int loadAnimation(const char *anim_scene, const char *anim_name = nullptr);
+	int loadAnimation(const char *anim_scene, const char *anim_name = nullptr, AdditiveMode additive = AdditiveMode::None);
+	// loads all the clips at the same time and adds them in order, returns the id of the first one
+	int loadAnimations(const ClipRequest *requests, int count);
 	bool isAnimationIdValid(int id);
+	// reloads the clip with or without root motion, it's baked at load time
+	void setRootMotion(int id, bool enabled);
+	// plays the clips, which were made for the skeleton in <skeleton_scene>, on this system's
+	// skeleton. null goes back to playing them as they are
+	bool setRetargetSource(const char *skeleton_scene);
 
 	gef::SkinnedMeshInstance *getSkinnedMesh() { return skinned_mesh.get(); }
 
+	// box around the character in world space, from the last pose that was sampled
+	const gef::Aabb &getWorldBounds() const { return world_bounds; }
+	// false if the character was outside of the camera in the last update
+	bool isVisible() const { return is_visible; }
+
+	// the joint boxes are only put in a bvh every update while picking is on
+	void setPicking(bool enabled);
+	bool isPicking() const { return is_using_picking; }
+	// closest joint box under a world space ray, against the pose of the last update.
+	// the hit is in model space, its distance is along the ray given
+	bool raycast(const gef::Vector4 &start, const gef::Vector4 &direction, RayHit &hit, Int32 ignore_subtree = -1) const;
+	const PoseBVH &getPoseBVH() const { return pose_bvh; }
+
 	void setPose(const gef::SkeletonPose &new_pose);
 	gef::SkeletonPose &getPose() { return anim_pose; }
 
@@ -65,12 +116,35 @@ public:
 	Animation3D *getCurrentAnimation();
 
 	int getAnimationId(const Animation3D *anim) const;
+	// joint name without the "namespace:" prefix
+	int getJointId(const std::string &name) const;
+	const std::unordered_map<std::string, int> &getJointMap() const { return joint_map; }
+	// version of the last file that was read
+	uint8_t getFileVersion() const { return file_version; }
 
 	BlendTree &getBlendTree() { return blend_tree; }
+	MotionMatcher &getMotionMatcher() { return motion_matcher; }
+	// events fired by the clips during the update, drain them once per frame
+	EventQueue &getEvents() { return event_queue; }
 
 private:
+	ClipRef addToLibrary(SceneLoader *scene, const ClipRequest &request);
+	int addAnimation(const ClipRef &clip, const ClipRequest &request);
+	AsyncLoader &getLoader();
+	void debugDrawEvents(Animation3D &anim);
+	void debugDrawRetarget();
+	// binds every clip again, after the skeleton or the retarget map changed
+	void rebindAnimations();
+	void applyRootMotion(const RootMotion &motion);
+	// tests the bounds against the camera of the renderer
+	bool cull();
+	void updateBounds(const gef::SkeletonPose &pose);
+
 	gef::Platform *platform = nullptr;
 	gef::Renderer3D *renderer = nullptr;
+	AsyncLoader *loader = nullptr;
+	// used when there's no async loader, loads everything straight away
+	AsyncLoader sync_loader;
 	gef::Skeleton skeleton;
 	gef::ptr<gef::Mesh> mesh = nullptr;
 	gef::ptr<gef::SkinnedMeshInstance> skinned_mesh = nullptr;
@@ -78,11 +152,42 @@ private:
 	gef::Vec<gef::Material> materials;
 	gef::SkeletonPose anim_pose;
 	gef::Vec<Animation3D> animations;
+	std::unordered_map<std::string, int> joint_map;
 	BlendTree blend_tree;
+	MotionMatcher motion_matcher;
+	// == culling ==
+	SkinnedBounds skinned_bounds;
+	// == picking ==
+	PoseBVH pose_bvh;
+	bool is_using_picking = false;
+	float bvh_build_us = 0.f;
+	// in model space, only updated when the character is visible
+	gef::Aabb model_bounds;
+	gef::Aabb world_bounds;
+	gef::Frustum frustum;
+	bool is_using_culling = true;
+	bool is_visible = true;
+	uint32_t culled_frames = 0;
+	// == retargeting, the map is empty when the clips are played as they are ==
+	RetargetMap retarget;
+	// scene with the skeleton the clips were made for
+	std::string retarget_source;
+	char retarget_input[64] = { 0 };
+	// time of the current animation when the blend tree is not used
+	ClipPlayback playback;
+	EventQueue event_queue;
+	// last events drained by the debug ui, newest first
+	static constexpr int event_log_len = 8;
+	FiredEvent event_log[event_log_len];
+	int event_log_count = 0;
 	float speed_multiplier = 1.f;
 	bool spinning = false;
 	bool is_using_blend_tree = true;
+	bool is_using_root_motion = true;
+	// takes over from the blend tree and the current animation
+	bool is_using_motion_matching = false;
 
+	uint8_t file_version = 0;
 	std::string scene_filename;
 	gef::Vec<std::string> animation_scenes;
 };
@@ -0,0 +1,878 @@
+#include "anim_system_crowd.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <system/platform.h>
+#include <system/allocator.h>
+#include <graphics/scene.h>
+#include <graphics/renderer_3d.h>
+#include <maths/math_utils.h>
+#include <external/ImGui/imgui.h>
+
+#include "scene_loader.h"
+#include "utils.h"
+
+/*
+save format:
+
+name             | type
+-----------------------------------
+		       header
+-----------------------------------
+format_ver       | uint8_t
+transform        | float * 16
+scene_file_len   | uint8_t
+scene_filename   | char * scene_file_len
+animations_count | uint8_t
+-----------------------------------
+			 animation
+-----------------------------------
+filename_len     | uint8_t
+filename         | char * filename_len
+name_len         | uint8_t
+name             | char * name_len
+-----------------------------------
+			   crowd
+-----------------------------------
+character_count  | uint32_t
+seed             | uint32_t
+spacing          | float
+*/
+
+// increase this every time a change to the format is made
+// it'll make sure that it won't try to load the wrong
+// version of the file
+static constexpr uint8_t format_ver = 1;
+
+// == ANIM SYSTEM CROWD =============================
+
+bool AnimSystemCrowd::update(float delta_time) {
+	if (!character_count || clips.empty()) {
+		return true;
+	}
+
+	delta_time *= speed_multiplier;
+
+	updateScratch();
+
+	double start = timeNowUs();
+	cullPass();
+	double cull_end = timeNowUs();
+
+	if (jobs) {
+		// the passes are interleaved between batches, only the total makes sense
+		updateJobs(delta_time);
+		timings = Timings();
+		timings.cull_us = (float)(cull_end - start);
+		timings.total_us = (float)(timeNowUs() - start);
+	}
+	else {
+		advancePass(delta_time, 0, character_count);
+		double advance_end = timeNowUs();
+		samplePass(0, character_count);
+		double sample_end = timeNowUs();
+		palettePass(0, character_count);
+		double palette_end = timeNowUs();
+
+		timings.cull_us    = (float)(cull_end - start);
+		timings.advance_us = (float)(advance_end - cull_end);
+		timings.sample_us  = (float)(sample_end - advance_end);
+		timings.palette_us = (float)(palette_end - sample_end);
+		timings.total_us   = (float)(palette_end - start);
+	}
+
+	// smooth the numbers out so they're readable in the ui
+	constexpr float smoothing = 0.05f;
+	average.cull_us    = gef::lerp(average.cull_us,    timings.cull_us,    smoothing);
+	average.advance_us = gef::lerp(average.advance_us, timings.advance_us, smoothing);
+	average.sample_us  = gef::lerp(average.sample_us,  timings.sample_us,  smoothing);
+	average.palette_us = gef::lerp(average.palette_us, timings.palette_us, smoothing);
+	average.total_us   = gef::lerp(average.total_us,   timings.total_us,   smoothing);
+
+	return false;
+}
+
+void AnimSystemCrowd::draw() {
+	if (!renderer || !mesh || !should_draw) {
+		return;
+	}
+
+	for (int i = 0; i < character_count; ++i) {
+		if (!visible[i]) {
+			continue;
+		}
+		mesh_instance.set_transform(transforms[i] * origin);
+		renderer->DrawSkinnedMesh(mesh_instance, getPalette(i), (UInt32)joint_count);
+	}
+}
+
+void AnimSystemCrowd::debugDraw() {
+	ImGui::SliderFloat("speed", &speed_multiplier, 0.f, 2.f);
+	ImGui::Checkbox("draw", &should_draw);
+	imHelper("Disable drawing to only measure the update");
+	ImGui::Checkbox("frustum culling", &is_using_culling);
+	imHelper("Characters outside of the camera keep their time but aren't sampled or drawn");
+	ImGui::Separator();
+
+	ImGui::Text("Stress test");
+	ImGui::DragInt("Count", &stress_count, 1.f, 1, 10000);
+	ImGui::DragFloat("Spacing", &spacing, 1.f, 10.f, 1000.f);
+	if (ImGui::Button("Spawn")) {
+		spawn(stress_count);
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Clear")) {
+		clearCharacters();
+	}
+
+	ImGui::Text("Characters: %d, joints: %d, clips: %zu", character_count, joint_count, clips.size());
+
+	if (ImGui::Button("Culling benchmark")) {
+		runCullingBenchmark();
+	}
+	imHelper("Culls random spheres and boxes one at a time and in batches");
+
+	if (!cull_benchmark_results.empty() && ImGui::BeginTable("cull benchmark", 6, ImGuiTableFlags_Borders)) {
+		ImGui::TableSetupColumn("objects");
+		ImGui::TableSetupColumn("sphere us");
+		ImGui::TableSetupColumn("batch sphere us");
+		ImGui::TableSetupColumn("aabb us");
+		ImGui::TableSetupColumn("batch aabb us");
+		ImGui::TableSetupColumn("indices us");
+		ImGui::TableHeadersRow();
+
+		for (const CullBenchmarkResult &result : cull_benchmark_results) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%u", result.objects);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", result.scalar_sphere_us);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f (%.1fx)", result.batch_sphere_us, result.scalar_sphere_us / result.batch_sphere_us);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", result.scalar_aabb_us);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f (%.1fx)", result.batch_aabb_us, result.scalar_aabb_us / result.batch_aabb_us);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", result.cull_indices_us);
+		}
+
+		ImGui::EndTable();
+	}
+
+	if (character_count) {
+		size_t per_character_bytes =
+			sizeof(gef::Matrix44) + sizeof(float) * 3 + sizeof(uint8_t) * 2 +
+			(sizeof(gef::JointPose) + sizeof(gef::Matrix44)) * joint_count;
+		ImGui::Text("Per character state: %zu bytes", per_character_bytes);
+
+		float per_character = 1.f / (float)character_count;
+		ImGui::Text("visible: %d of %d", visible_count, character_count);
+		ImGui::Text("cull:    %9.2f us (%.3f us per character)", average.cull_us, average.cull_us * per_character);
+		if (!jobs) ImGui::Text("advance: %9.2f us (%.3f us per character)", average.advance_us, average.advance_us * per_character);
+		if (!jobs) ImGui::Text("sample:  %9.2f us (%.3f us per character)", average.sample_us,  average.sample_us  * per_character);
+		if (!jobs) ImGui::Text("palette: %9.2f us (%.3f us per character)", average.palette_us, average.palette_us * per_character);
+		ImGui::Text("total:   %9.2f us (%.3f us per character)", average.total_us,   average.total_us   * per_character);
+	}
+
+	if (!jobs) {
+		return;
+	}
+
+	ImGui::Separator();
+	ImGui::Text("Job system");
+
+	// the job system is the one of the app, loading and ik can still have jobs on it
+	int threads = (int)jobs->getThreadCount();
+	bool deterministic = jobs->isDeterministic();
+	if (ImGui::Checkbox("Deterministic (single thread)", &deterministic)) {
+		jobs->waitIdle();
+		jobs->init(deterministic ? 0 : -1);
+	}
+	imHelper("Runs every job on the main thread in the order it was queued, for the whole app");
+	if (ImGui::SliderInt("Threads", &threads, 1, gef::max((int)std::thread::hardware_concurrency(), 1))) {
+		jobs->waitIdle();
+		jobs->init(threads - 1);
+	}
+	imHelper("Threads of the job system of the whole app, with the main thread");
+	ImGui::DragInt("Batch size", &batch_size, 1.f, 1, 1024);
+	imHelper("Number of characters in every job");
+
+	ImGui::DragInt("Benchmark frames", &benchmark_frames, 1.f, 1, 1000);
+	if (ImGui::Button("Scaling benchmark")) {
+		runScalingBenchmark(benchmark_frames);
+	}
+	imHelper("Updates the crowd with 1 to N threads and compares the frame times");
+
+	if (!benchmark_results.empty() && ImGui::BeginTable("benchmark", 3, ImGuiTableFlags_Borders)) {
+		ImGui::TableSetupColumn("threads");
+		ImGui::TableSetupColumn("us per frame");
+		ImGui::TableSetupColumn("speedup");
+		ImGui::TableHeadersRow();
+
+		float single_thread_us = benchmark_results[0].frame_us;
+		for (const BenchmarkResult &result : benchmark_results) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%d", result.threads);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", result.frame_us);
+			ImGui::TableNextColumn(); ImGui::Text("%.2fx", single_thread_us / result.frame_us);
+		}
+
+		ImGui::EndTable();
+	}
+}
+
+void AnimSystemCrowd::setAnimation(const char *name) {
+	for (size_t i = 0; i < clips.size(); ++i) {
+		if (strcmp(clips[i].name, name) == 0) {
+			setAnimation((int)i);
+			return;
+		}
+	}
+	setAnimation(INVALID_ID);
+}
+
+void AnimSystemCrowd::setAnimation(int id) {
+	if (id < 0 || id >= (int)clips.size()) {
+		cur_animation = INVALID_ID;
+		return;
+	}
+
+	// everyone plays the same clip, without blending
+	cur_animation = id;
+	for (int i = 0; i < character_count; ++i) {
+		clips_a[i] = (uint8_t)id;
+		blends[i] = 0.f;
+	}
+}
+
+gef::Transform AnimSystemCrowd::getTransform() const {
+	return origin;
+}
+
+void AnimSystemCrowd::setTransform(const gef::Transform &tran) {
+	origin = tran.GetMatrix();
+	bounds_dirty = true;
+}
+
+void AnimSystemCrowd::read(FILE *fp) {
+	if (!fp) return;
+	cleanup();
+
+	uint8_t scenefile_len = 0;
+	uint8_t animations_count = 0;
+	uint32_t count = 0;
+	uint32_t file_seed = 0;
+
+	fileRead(origin, fp);
+	fileRead(scenefile_len, fp);
+	scene_filename.resize(scenefile_len);
+	fileRead(scene_filename, fp);
+	fileRead(animations_count, fp);
+
+	// start loading every file straight away, loadSkeleton and loadAnimations pick them up
+	AsyncLoader &scene_loader = getLoader();
+	scene_loader.prefetch(scene_filename.c_str(), this);
+
+	struct ClipEntry {
+		std::string filename;
+		char name[sizeof(Animation3D::name)];
+	};
+	gef::Vec<ClipEntry> entries;
+	entries.reserve(animations_count);
+
+	for (uint8_t i = 0; i < animations_count; ++i) {
+		uint8_t filename_len = 0;
+		uint8_t name_len = 0;
+		ClipEntry entry;
+
+		fileRead(filename_len, fp);
+		entry.filename.resize(filename_len);
+		fileRead(entry.filename, fp);
+		fileRead(name_len, fp);
+		memset(entry.name, 0, sizeof(entry.name));
+		fread(entry.name, 1, name_len, fp);
+
+		if (!getClipLibrary().find(entry.filename.c_str())) {
+			scene_loader.prefetch(entry.filename.c_str(), this);
+		}
+		entries.emplace_back(std::move(entry));
+	}
+
+	loadSkeleton(scene_filename.c_str());
+
+	gef::Vec<ClipRequest> requests;
+	requests.reserve(entries.size());
+	for (const ClipEntry &entry : entries) {
+		ClipRequest request;
+		request.filename = entry.filename.c_str();
+		request.name = entry.name;
+		requests.emplace_back(request);
+	}
+	loadAnimations(requests.data(), (int)requests.size());
+	scene_loader.dropPrefetches(this);
+
+	fileRead(count, fp);
+	fileRead(file_seed, fp);
+	fileRead(spacing, fp);
+
+	stress_count = (int)count;
+	spawn((int)count, file_seed);
+}
+
+void AnimSystemCrowd::save(FILE *fp) const {
+	if (!fp) return;
+
+	uint8_t animations_count = (uint8_t)clips.size();
+
+	fileWrite(format_ver, fp);
+	fileWrite(origin, fp);
+	fileWrite((uint8_t)scene_filename.size(), fp);
+	fileWrite(scene_filename, fp);
+	fileWrite(animations_count, fp);
+
+	for (uint8_t i = 0; i < animations_count; ++i) {
+		const std::string &fname = animation_scenes[i];
+		uint8_t name_len = (uint8_t)strlen(clips[i].name);
+
+		fileWrite((uint8_t)fname.size(), fp);
+		fileWrite(fname, fp);
+		fileWrite(name_len, fp);
+		fwrite(clips[i].name, 1, name_len, fp);
+	}
+
+	fileWrite((uint32_t)character_count, fp);
+	fileWrite(seed, fp);
+	fileWrite(spacing, fp);
+}
+
+bool AnimSystemCrowd::checkFormatVersion(FILE *fp) {
+	if (!fp) return false;
+	uint8_t version = 0;
+	fread(&version, 1, sizeof(version), fp);
+	return version == format_ver;
+}
+
+void AnimSystemCrowd::init(gef::Platform &plat, gef::Renderer3D *renderer3D, const char *mesh_fname) {
+	type = AnimSystemType::Crowd;
+	platform = &plat;
+	renderer = renderer3D;
+
+	PushAllocInfo("CrowdInit");
+	loadSkeleton(mesh_fname);
+	PopAllocInfo();
+}
+
+void AnimSystemCrowd::cleanup() {
+	clearCharacters();
+	mesh.destroy();
+	textures.clear();
+	materials.clear();
+	clips.clear();
+	animation_scenes.clear();
+	parents.clear();
+	inv_bind.clear();
+	joint_count = 0;
+}
+
+void AnimSystemCrowd::loadSkeleton(const char *filename) {
+	assert(platform);
+	scene_filename = filename;
+
+	SceneFuture future = getLoader().load(filename, this);
+	if (SceneLoader *model_scene = getLoader().get(future)) {
+		skeleton = model_scene->popFirstSkeleton();
+		mesh = model_scene->popFirstMesh();
+		mesh_instance.set_mesh(mesh.get());
+		bind_pose.CreateBindPose(&skeleton);
+
+		textures = model_scene->moveTextures();
+		materials = model_scene->moveMaterials();
+
+		// keep what the palette pass needs in flat arrays
+		const auto &joints = skeleton.joints();
+		joint_count = (int)joints.size();
+		parents.clear();
+		inv_bind.clear();
+		parents.reserve(joint_count);
+		inv_bind.reserve(joint_count);
+		for (const gef::Joint &joint : joints) {
+			parents.push_back(joint.parent);
+			inv_bind.push_back(joint.inv_bind_pose);
+		}
+
+		updateScratch();
+	}
+}
+
+int AnimSystemCrowd::loadAnimation(const char *anim_scene, const char *anim_name) {
+	ClipRequest request;
+	request.filename = anim_scene;
+	request.name = anim_name;
+	return loadAnimations(&request, 1);
+}
+
+int AnimSystemCrowd::loadAnimations(const ClipRequest *requests, int count) {
+	PushAllocInfo("CrowdLoad");
+	AsyncLoader &scene_loader = getLoader();
+
+	ClipLibrary &library = getClipLibrary();
+
+	// start all of them before waiting on any, so they're loaded at the same time.
+	// clips that are already in the library don't need to be loaded again
+	gef::Vec<ClipRef> shared_clips;
+	gef::Vec<SceneFuture> futures;
+	shared_clips.reserve(count);
+	futures.reserve(count);
+	for (int i = 0; i < count; ++i) {
+		shared_clips.emplace_back(library.find(requests[i].filename));
+		futures.emplace_back(shared_clips.back() ? nullptr : scene_loader.load(requests[i].filename, this));
+	}
+
+	int first_id = INVALID_ID;
+	for (int i = 0; i < count; ++i) {
+		if (!shared_clips[i]) {
+			shared_clips[i] = addToLibrary(scene_loader.get(futures[i]), requests[i]);
+		}
+		int id = addAnimation(shared_clips[i], requests[i]);
+		if (first_id == INVALID_ID) {
+			first_id = id;
+		}
+	}
+
+	PopAllocInfo();
+	return first_id;
+}
+
+ClipRef AnimSystemCrowd::addToLibrary(SceneLoader *scene, const ClipRequest &request) {
+	if (!scene) {
+		err("couldn't load crowd animation, couldn't load scene file %s", request.filename);
+		return ClipRef();
+	}
+
+	gef::Animation anim;
+	if (!scene->popFirstAnimation(anim)) {
+		err("couldn't load crowd animation, no animation in scene");
+		return ClipRef();
+	}
+
+	return getClipLibrary().add(request.filename, std::move(anim), scene->getStringTable());
+}
+
+int AnimSystemCrowd::addAnimation(const ClipRef &clip, const ClipRequest &request) {
+	if (!clip) {
+		return INVALID_ID;
+	}
+
+	int id = (int)clips.size();
+	Animation3D new_clip(clip);
+	strCopyInto(new_clip.name, request.name ? request.name : request.filename);
+	new_clip.bindSkeleton(skeleton);
+	clips.emplace_back(new_clip);
+	animation_scenes.emplace_back(request.filename);
+
+	return id;
+}
+
+AsyncLoader &AnimSystemCrowd::getLoader() {
+	if (loader) {
+		return *loader;
+	}
+	sync_loader.init(*platform, nullptr);
+	return sync_loader;
+}
+
+void AnimSystemCrowd::spawn(int count, uint32_t new_seed) {
+	clearCharacters();
+	if (count <= 0 || clips.empty() || !joint_count) {
+		return;
+	}
+
+	PushAllocInfo("CrowdSpawn");
+
+	seed = new_seed;
+	character_count = count;
+	transforms.resize(count);
+	phases.resize(count);
+	speeds.resize(count);
+	blends.resize(count);
+	clips_a.resize(count);
+	clips_b.resize(count);
+	local_poses.resize((size_t)count * joint_count);
+	palettes.resize((size_t)count * joint_count);
+	bounds_x.resize(count);
+	bounds_y.resize(count);
+	bounds_z.resize(count);
+	bounds_radius.resize(count);
+	// everyone is visible until the first cull
+	visible.resize(count, 1);
+	visible_count = count;
+	bounds_dirty = true;
+
+	uint32_t state = seed ? seed : 1;
+	int side = (int)ceilf(sqrtf((float)count));
+	float half = (float)(side - 1) * 0.5f;
+	uint32_t clip_count = (uint32_t)clips.size();
+
+	for (int i = 0; i < count; ++i) {
+		float x = ((float)(i % side) - half) * spacing;
+		float z = ((float)(i / side) - half) * spacing;
+
+		gef::Matrix44 transform;
+		transform.RotationY(randFloat(state, -gef::pi, gef::pi));
+		transform.SetTranslation(gef::Vector4(x, 0.f, z));
+
+		transforms[i] = transform;
+		phases[i] = randFloat(state, 0.f, 1.f);
+		speeds[i] = randFloat(state, 0.8f, 1.2f);
+		blends[i] = randFloat(state, 0.f, 1.f);
+		clips_a[i] = (uint8_t)(randNext(state) % clip_count);
+		clips_b[i] = (uint8_t)(randNext(state) % clip_count);
+	}
+
+	// start from a valid pose so the first draw isn't garbage
+	updateScratch();
+	samplePass(0, character_count);
+	palettePass(0, character_count);
+
+	PopAllocInfo();
+
+	info("spawned %d crowd characters", count);
+}
+
+void AnimSystemCrowd::clearCharacters() {
+	character_count = 0;
+	transforms.clear();
+	phases.clear();
+	speeds.clear();
+	blends.clear();
+	clips_a.clear();
+	clips_b.clear();
+	local_poses.clear();
+	palettes.clear();
+	bounds_x.clear();
+	bounds_y.clear();
+	bounds_z.clear();
+	bounds_radius.clear();
+	visible.clear();
+	visible_count = 0;
+	timings = average = Timings();
+}
+
+// == PASSES ========================================
+
+void AnimSystemCrowd::cullPass() {
+	if (!is_using_culling || !renderer) {
+		memset(visible.data(), 1, visible.size());
+		visible_count = character_count;
+		return;
+	}
+
+	if (bounds_dirty) {
+		updateBounds();
+	}
+
+	frustum.ExtractPlanesD3D(renderer->view_matrix() * renderer->projection_matrix(), true);
+	gef::SphereBatch spheres = { bounds_x.data(), bounds_y.data(), bounds_z.data(), bounds_radius.data() };
+	frustum.Visible(spheres, (UInt32)character_count, visible.data());
+
+	visible_count = 0;
+	for (uint8_t is_visible : visible) {
+		visible_count += is_visible;
+	}
+}
+
+void AnimSystemCrowd::updateBounds() {
+	bounds_dirty = false;
+	if (!mesh) {
+		return;
+	}
+
+	// the sphere of the bind pose, animations that stay in place don't go too far out of it
+	const gef::Sphere &sphere = mesh->bounding_sphere();
+	gef::Vector4 scale = origin.GetScale();
+	float radius = sphere.radius() * gef::max(scale.x(), gef::max(scale.y(), scale.z()));
+
+	for (int i = 0; i < character_count; ++i) {
+		gef::Vector4 centre = sphere.position().Transform(transforms[i] * origin);
+		bounds_x[i] = centre.x();
+		bounds_y[i] = centre.y();
+		bounds_z[i] = centre.z();
+		bounds_radius[i] = radius;
+	}
+}
+
+void AnimSystemCrowd::advancePass(float delta_time, int begin, int end) {
+	for (int i = begin; i < end; ++i) {
+		const Animation3D &clip_a = clips[clips_a[i]];
+		const Animation3D &clip_b = clips[clips_b[i]];
+
+		// both clips are synced, so they advance at the blended speed
+		float duration = gef::lerp(clip_a.clip->duration, clip_b.clip->duration, blends[i]);
+		if (duration <= 0.f) {
+			continue;
+		}
+
+		float phase = phases[i] + (delta_time * speeds[i]) / duration;
+		phases[i] = phase - floorf(phase);
+	}
+}
+
+void AnimSystemCrowd::samplePass(int begin, int end) {
+	const gef::JointPose *bind = bind_pose.local_pose().data();
+	size_t scratch_offset = (size_t)getScratchIndex() * joint_count;
+	gef::JointPose *scratch_a = sample_a.data() + scratch_offset;
+	gef::JointPose *scratch_b = sample_b.data() + scratch_offset;
+
+	for (int i = begin; i < end; ++i) {
+		if (!visible[i]) {
+			continue;
+		}
+
+		const Animation3D &clip_a = clips[clips_a[i]];
+		const Animation3D &clip_b = clips[clips_b[i]];
+		gef::JointPose *out = local_poses.data() + (size_t)i * joint_count;
+		float phase = phases[i];
+		float blend = blends[i];
+
+		float time_a = phase * clip_a.clip->duration;
+		float time_b = phase * clip_b.clip->duration;
+
+		if (blend <= 0.f) {
+			sampleLocal(*clip_a.clip, *clip_a.binding, time_a, bind, out);
+		}
+		else if (blend >= 1.f) {
+			sampleLocal(*clip_b.clip, *clip_b.binding, time_b, bind, out);
+		}
+		else {
+			sampleLocal(*clip_a.clip, *clip_a.binding, time_a, bind, scratch_a);
+			sampleLocal(*clip_b.clip, *clip_b.binding, time_b, bind, scratch_b);
+			for (int j = 0; j < joint_count; ++j) {
+				out[j] = gef::Transform::lerp(scratch_a[j], scratch_b[j], blend);
+			}
+		}
+	}
+}
+
+void AnimSystemCrowd::palettePass(int begin, int end) {
+	gef::Matrix44 *global = global_pose.data() + (size_t)getScratchIndex() * joint_count;
+
+	for (int i = begin; i < end; ++i) {
+		if (!visible[i]) {
+			continue;
+		}
+
+		const gef::JointPose *local = local_poses.data() + (size_t)i * joint_count;
+		gef::Matrix44 *palette = palettes.data() + (size_t)i * joint_count;
+
+		// parents always come before their children
+		for (int j = 0; j < joint_count; ++j) {
+			gef::Matrix44 local_matrix = local[j].GetMatrix();
+			Int32 parent = parents[j];
+			global[j] = parent < 0 ? local_matrix : local_matrix * global[parent];
+			palette[j] = inv_bind[j] * global[j];
+		}
+	}
+}
+
+// == JOBS ==========================================
+
+void AnimSystemCrowd::sampleJob(void *user_data, uint32_t begin, uint32_t end) {
+	AnimSystemCrowd *crowd = (AnimSystemCrowd *)user_data;
+	crowd->advancePass(crowd->frame_delta, (int)begin, (int)end);
+	crowd->samplePass((int)begin, (int)end);
+}
+
+void AnimSystemCrowd::paletteJob(void *user_data, uint32_t begin, uint32_t end) {
+	AnimSystemCrowd *crowd = (AnimSystemCrowd *)user_data;
+	crowd->palettePass((int)begin, (int)end);
+}
+
+void AnimSystemCrowd::updateJobs(float delta_time) {
+	frame_delta = delta_time;
+
+	// every batch is sampled and then turned into palettes as soon as it's ready,
+	// batches don't wait for each other so there isn't a barrier between passes
+	gef::Job *root = jobs->create(nullptr, nullptr);
+	uint32_t count = (uint32_t)character_count;
+	uint32_t batch = (uint32_t)gef::max(batch_size, 1);
+	// two jobs per batch, make sure they all fit in the job pool
+	batch = gef::max(batch, (count * 2) / (gef::JobSystem::max_jobs - 1) + 1);
+
+	for (uint32_t begin = 0; begin < count; begin += batch) {
+		uint32_t end = gef::min(begin + batch, count);
+		gef::Job *sample = jobs->create(sampleJob, this, begin, end, root);
+		gef::Job *palette = jobs->create(paletteJob, this, begin, end, root);
+		jobs->addDependency(palette, sample);
+		jobs->run(palette);
+		jobs->run(sample);
+	}
+
+	jobs->run(root);
+	jobs->wait(root);
+}
+
+void AnimSystemCrowd::updateScratch() {
+	size_t size = (size_t)getScratchCount() * joint_count;
+	if (global_pose.size() != size) {
+		sample_a.resize(size);
+		sample_b.resize(size);
+		global_pose.resize(size);
+	}
+}
+
+int AnimSystemCrowd::getScratchCount() const {
+	return jobs ? (int)jobs->getThreadCount() : 1;
+}
+
+int AnimSystemCrowd::getScratchIndex() const {
+	return jobs ? (int)jobs->getThreadIndex() : 0;
+}
+
+// == SCALING BENCHMARK =============================
+
+void AnimSystemCrowd::runScalingBenchmark(int frames) {
+	if (!jobs || !character_count) {
+		warn("the scaling benchmark needs a job system and some characters");
+		return;
+	}
+
+	constexpr int warmup_frames = 5;
+	constexpr float delta_time = 1.f / 60.f;
+
+	// the crowd gets a job system of its own for each thread count, the one of the app
+	// is shared and other systems can still have jobs on it
+	gef::JobSystem bench_jobs;
+	gef::JobSystem *app_jobs = jobs;
+	jobs = &bench_jobs;
+	int max_threads = gef::max((int)std::thread::hardware_concurrency(), 1);
+
+	benchmark_results.clear();
+	for (int threads = 1; threads <= max_threads; ++threads) {
+		bench_jobs.init(threads - 1);
+		updateScratch();
+
+		for (int i = 0; i < warmup_frames; ++i) {
+			updateJobs(delta_time);
+		}
+
+		double start = timeNowUs();
+		for (int i = 0; i < frames; ++i) {
+			updateJobs(delta_time);
+		}
+		float frame_us = (float)(timeNowUs() - start) / (float)frames;
+
+		benchmark_results.push_back({ threads, frame_us });
+		info("crowd benchmark: %d threads, %.2f us per frame", threads, frame_us);
+	}
+
+	bench_jobs.cleanup();
+	jobs = app_jobs;
+	updateScratch();
+}
+
+// == CULLING BENCHMARK =============================
+
+void AnimSystemCrowd::runCullingBenchmark() {
+	constexpr uint32_t counts[] = { 1000, 10000, 100000 };
+	constexpr int repeats = 10;
+	constexpr float range = 5000.f;
+
+	// the camera of the app if there is one, otherwise one looking down -z from the origin
+	gef::Matrix44 view_proj;
+	if (renderer) {
+		view_proj = renderer->view_matrix() * renderer->projection_matrix();
+	}
+	else {
+		gef::Matrix44 view, projection;
+		view.LookAt(gef::Vector4(0.f, 0.f, 0.f), gef::Vector4(0.f, 0.f, -1.f), gef::Vector4(0.f, 1.f, 0.f));
+		projection.PerspectiveFovD3D(gef::pi * 0.25f, 16.f / 9.f, 1.f, range);
+		view_proj = view * projection;
+	}
+	gef::Frustum test_frustum;
+	test_frustum.ExtractPlanesD3D(view_proj, true);
+
+	uint32_t state = 1;
+	cull_benchmark_results.clear();
+
+	for (uint32_t count : counts) {
+		gef::Vec<float> x, y, z, radius, extent_x, extent_y, extent_z;
+		gef::Vec<gef::Sphere> spheres;
+		gef::Vec<gef::Aabb> boxes;
+		x.reserve(count); y.reserve(count); z.reserve(count); radius.reserve(count);
+		extent_x.reserve(count); extent_y.reserve(count); extent_z.reserve(count);
+		spheres.reserve(count);
+		boxes.reserve(count);
+
+		for (uint32_t i = 0; i < count; ++i) {
+			x.push_back(randFloat(state, -range, range));
+			y.push_back(randFloat(state, -range, range));
+			z.push_back(randFloat(state, -range, range));
+			radius.push_back(randFloat(state, 1.f, 100.f));
+			extent_x.push_back(randFloat(state, 1.f, 100.f));
+			extent_y.push_back(randFloat(state, 1.f, 100.f));
+			extent_z.push_back(randFloat(state, 1.f, 100.f));
+
+			gef::Vector4 centre(x[i], y[i], z[i]);
+			gef::Vector4 extent(extent_x[i], extent_y[i], extent_z[i]);
+			spheres.push_back(gef::Sphere(centre, radius[i]));
+			boxes.push_back(gef::Aabb(centre - extent, centre + extent));
+		}
+
+		gef::SphereBatch sphere_batch = { x.data(), y.data(), z.data(), radius.data() };
+		gef::AabbBatch aabb_batch = { x.data(), y.data(), z.data(), extent_x.data(), extent_y.data(), extent_z.data() };
+		gef::Vec<uint8_t> flags;
+		gef::Vec<UInt32> indices;
+		flags.resize(count);
+		indices.resize(count);
+
+		CullBenchmarkResult result = { count, 0.f, 0.f, 0.f, 0.f, 0.f };
+		// the counts keep the scalar loops from being optimised away, and check the results
+		uint32_t scalar_visible = 0;
+		uint32_t scalar_boxes_visible = 0;
+		uint32_t batch_visible = 0;
+
+		for (int r = 0; r < repeats; ++r) {
+			double start = timeNowUs();
+			scalar_visible = 0;
+			for (const gef::Sphere &sphere : spheres) {
+				scalar_visible += test_frustum.Intersects(sphere) != gef::FI_OUT;
+			}
+			result.scalar_sphere_us += (float)(timeNowUs() - start);
+
+			start = timeNowUs();
+			test_frustum.Visible(sphere_batch, count, flags.data());
+			result.batch_sphere_us += (float)(timeNowUs() - start);
+
+			start = timeNowUs();
+			scalar_boxes_visible = 0;
+			for (const gef::Aabb &box : boxes) {
+				scalar_boxes_visible += test_frustum.Intersects(box) != gef::FI_OUT;
+			}
+			result.scalar_aabb_us += (float)(timeNowUs() - start);
+
+			start = timeNowUs();
+			test_frustum.Visible(aabb_batch, count, flags.data());
+			result.batch_aabb_us += (float)(timeNowUs() - start);
+
+			start = timeNowUs();
+			batch_visible = test_frustum.Cull(sphere_batch, count, indices.data());
+			result.cull_indices_us += (float)(timeNowUs() - start);
+		}
+
+		if (scalar_visible != batch_visible) {
+			warn("culling benchmark: the scalar test found %u spheres, the batch %u", scalar_visible, batch_visible);
+		}
+		uint32_t batch_boxes_visible = test_frustum.Cull(aabb_batch, count, indices.data());
+		if (scalar_boxes_visible != batch_boxes_visible) {
+			warn("culling benchmark: the scalar test found %u boxes, the batch %u", scalar_boxes_visible, batch_boxes_visible);
+		}
+
+		result.scalar_sphere_us /= repeats;
+		result.batch_sphere_us /= repeats;
+		result.scalar_aabb_us /= repeats;
+		result.batch_aabb_us /= repeats;
+		result.cull_indices_us /= repeats;
+		cull_benchmark_results.push_back(result);
+
+		info(
+			"culling benchmark: %u objects, spheres %.2f us -> %.2f us, boxes %.2f us -> %.2f us, %u visible",
+			count, result.scalar_sphere_us, result.batch_sphere_us, result.scalar_aabb_us, result.batch_aabb_us, batch_visible
+		);
+	}
+}
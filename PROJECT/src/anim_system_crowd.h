@@ -0,0 +1,182 @@
+#pragma once
+
+#include <string>
+
+#include <system/vec.h>
+#include <system/ptr.h>
+#include <system/job_system.h>
+#include <animation/skeleton.h>
+#include <graphics/mesh.h>
+#include <graphics/mesh_instance.h>
+#include <graphics/material.h>
+#include <graphics/texture.h>
+#include <maths/frustum.h>
+
+#include "anim_system.h"
+#include "anim_system_3d.h"
+
+namespace gef {
+	class Platform;
+	class Renderer3D;
+}
+
+// draws lots of characters that all share the same skeleton, mesh and clips.
+// every character blends between two clips synced on their normalized time,
+// the per character state is kept in flat arrays (one entry per character)
+// and updated one pass at a time over all the characters
+class AnimSystemCrowd : public AnimSystem {
+public:
+	virtual bool update(float delta_time) override;
+	virtual void draw() override;
+	virtual void debugDraw() override;
+	virtual void setAnimation(const char *name) override;
+	virtual void setAnimation(int id) override;
+	virtual gef::Transform getTransform() const override;
+	virtual void setTransform(const gef::Transform &tran) override;
+	virtual void read(FILE *fp) override;
+	virtual void save(FILE *fp) const override;
+	virtual bool checkFormatVersion(FILE *fp) override;
+
+	void init(gef::Platform &plat, gef::Renderer3D *renderer3D, const char *mesh_fname);
+	void cleanup();
+
+	// when set, the scene files are loaded on the job system
+	void setAsyncLoader(AsyncLoader *async_loader) { loader = async_loader; }
+
+	void loadSkeleton(const char *filename);
+	int loadAnimation(const char *anim_scene, const char *anim_name = nullptr);
+	// loads all the clips at the same time and adds them in order, returns the id of the first one
+	int loadAnimations(const ClipRequest *requests, int count);
+
+	// removes all the characters and spawns <count> new ones in a grid, with
+	// random clips, speeds and blend values. same <seed>, same crowd
+	void spawn(int count, uint32_t seed = 1);
+	void clearCharacters();
+
+	int getCharacterCount() const { return character_count; }
+	int getJointCount() const { return joint_count; }
+	const gef::Matrix44 *getPalette(int character) const { return palettes.data() + character * joint_count; }
+
+	// timings of the last update, in microseconds
+	struct Timings {
+		float cull_us = 0.f;
+		float advance_us = 0.f;
+		float sample_us = 0.f;
+		float palette_us = 0.f;
+		float total_us = 0.f;
+	};
+	const Timings &getTimings() const { return timings; }
+
+	// when set, the update is split in batches of characters that run on the job system
+	void setJobSystem(gef::JobSystem *job_system) { jobs = job_system; }
+
+	struct BenchmarkResult {
+		int threads;
+		float frame_us;
+	};
+	// updates the crowd <frames> times with 1 to N threads
+	void runScalingBenchmark(int frames);
+	const gef::Vec<BenchmarkResult> &getBenchmarkResults() const { return benchmark_results; }
+
+	struct CullBenchmarkResult {
+		uint32_t objects;
+		float scalar_sphere_us;
+		float batch_sphere_us;
+		float scalar_aabb_us;
+		float batch_aabb_us;
+		float cull_indices_us; // spheres, compacted into a list of indices
+	};
+	// tests random spheres and boxes against the camera with gef::Frustum::Intersects
+	// one at a time and then with the batch functions
+	void runCullingBenchmark();
+	const gef::Vec<CullBenchmarkResult> &getCullBenchmarkResults() const { return cull_benchmark_results; }
+
+	int getVisibleCount() const { return visible_count; }
+
+private:
+	// tests every character against the camera in one batch
+	void cullPass();
+	void updateBounds();
+
+	// all the passes work on the characters in [begin, end), culled characters only advance
+	void advancePass(float delta_time, int begin, int end);
+	void samplePass(int begin, int end);
+	void palettePass(int begin, int end);
+
+	static void sampleJob(void *user_data, uint32_t begin, uint32_t end);
+	static void paletteJob(void *user_data, uint32_t begin, uint32_t end);
+	void updateJobs(float delta_time);
+
+	// every thread gets its own slice of the scratch buffers
+	void updateScratch();
+	int getScratchCount() const;
+	int getScratchIndex() const;
+
+	ClipRef addToLibrary(SceneLoader *scene, const ClipRequest &request);
+	int addAnimation(const ClipRef &clip, const ClipRequest &request);
+	AsyncLoader &getLoader();
+
+	// == shared data ==
+	gef::Platform *platform = nullptr;
+	gef::Renderer3D *renderer = nullptr;
+	AsyncLoader *loader = nullptr;
+	AsyncLoader sync_loader;
+	gef::Skeleton skeleton;
+	gef::ptr<gef::Mesh> mesh = nullptr;
+	gef::MeshInstance mesh_instance;
+	gef::Vec<gef::ptr<gef::Texture>> textures;
+	gef::Vec<gef::Material> materials;
+	gef::SkeletonPose bind_pose;
+	gef::Vec<Animation3D> clips;
+	gef::Vec<Int32> parents;
+	gef::Vec<gef::Matrix44> inv_bind;
+	int joint_count = 0;
+
+	// == per character data ==
+	int character_count = 0;
+	gef::Vec<gef::Matrix44> transforms;
+	gef::Vec<float> phases;        // normalized time in both clips, range (0, 1)
+	gef::Vec<float> speeds;        // playback speed multiplier
+	gef::Vec<float> blends;        // 0 = clip_a, 1 = clip_b
+	gef::Vec<uint8_t> clips_a;
+	gef::Vec<uint8_t> clips_b;
+	gef::Vec<gef::JointPose> local_poses; // joint_count per character
+	gef::Vec<gef::Matrix44> palettes;     // joint_count per character
+	// bounding sphere in world space, as a structure of arrays for gef::Frustum::Visible
+	gef::Vec<float> bounds_x;
+	gef::Vec<float> bounds_y;
+	gef::Vec<float> bounds_z;
+	gef::Vec<float> bounds_radius;
+	gef::Vec<uint8_t> visible;
+
+	// == scratch buffers, joint_count per thread ==
+	gef::Vec<gef::JointPose> sample_a;
+	gef::Vec<gef::JointPose> sample_b;
+	gef::Vec<gef::Matrix44> global_pose;
+
+	gef::Matrix44 origin = gef::Matrix44::kIdentity;
+	float spacing = 150.f; // in model units, the crowd transform is applied on top
+	float speed_multiplier = 1.f;
+	bool should_draw = true;
+
+	gef::Frustum frustum;
+	bool is_using_culling = true;
+	// the spheres only move with the crowd transform
+	bool bounds_dirty = true;
+	int visible_count = 0;
+	gef::Vec<CullBenchmarkResult> cull_benchmark_results;
+
+	gef::JobSystem *jobs = nullptr;
+	int batch_size = 16;
+	float frame_delta = 0.f;
+	int benchmark_frames = 60;
+	gef::Vec<BenchmarkResult> benchmark_results;
+
+	Timings timings;
+	Timings average;
+	int stress_count = 100;
+	uint32_t seed = 1;
+
+	std::string scene_filename;
+	gef::Vec<std::string> animation_scenes;
+};
@@ -1,92 +1,485 @@
 #include "anim_system_ik.h"
 
+#include <algorithm>
+
 #include <system/platform.h>
 #include <input/input_manager.h>
 #include <input/touch_input_manager.h>
 #include <graphics/renderer_3d.h>
 #include <graphics/skinned_mesh_instance.h>
+#include <animation/joint.h>
+#include <external/ImGui/imgui.h>
 
-#include "scene_loader.h"
+#include "anim_system_3d.h"
+#include "blend_tree.h"
 #include "batch2d.h"
+#include "utils.h"
+
+// version of the file
+static constexpr uint8_t format_ver = 2;
+// oldest version that can still be read
+static constexpr uint8_t min_format_ver = 1;
+
+static IKJointLimit hingeLimit(const gef::Vector4 &axis, float min_degrees, float max_degrees) {
+	IKJointLimit limit;
+	limit.type = IKLimit::Hinge;
+	limit.axis = axis;
+	limit.min_angle = gef::DegToRad(min_degrees);
+	limit.max_angle = gef::DegToRad(max_degrees);
+	return limit;
+}
+
+static IKJointLimit coneLimit(float cone_degrees, float twist_degrees) {
+	IKJointLimit limit;
+	limit.type = IKLimit::Cone;
+	limit.max_angle = gef::DegToRad(cone_degrees);
+	limit.twist = gef::DegToRad(twist_degrees);
+	return limit;
+}
+
+// chains of the xbot skeleton, by the names the joint map has without the mixamo
+// prefix. it faces +z with the arms along x, the elbows and knees bend forward and
+// back from the bind pose
+struct ChainPreset {
+	static constexpr int joint_count = 3;
+	const char *name;
+	const char *joints[joint_count];
+	IKJointLimit limits[joint_count];
+};
+
+static const ChainPreset chain_presets[] = {
+	{ "Left arm",  { "LeftArm", "LeftForeArm", "LeftHand" },    { coneLimit(100.f, 60.f), hingeLimit(gef::Vector4(0.f, -1.f, 0.f), 0.f, 150.f) } },
+	{ "Right arm", { "RightArm", "RightForeArm", "RightHand" }, { coneLimit(100.f, 60.f), hingeLimit(gef::Vector4(0.f,  1.f, 0.f), 0.f, 150.f) } },
+	{ "Left leg",  { "LeftUpLeg", "LeftLeg", "LeftFoot" },      { coneLimit(90.f, 30.f),  hingeLimit(gef::Vector4(1.f,  0.f, 0.f), 0.f, 150.f) } },
+	{ "Right leg", { "RightUpLeg", "RightLeg", "RightFoot" },   { coneLimit(90.f, 30.f),  hingeLimit(gef::Vector4(1.f,  0.f, 0.f), 0.f, 150.f) } },
+	{ "Back",      { "Spine", "Spine1", "Spine2" },             { coneLimit(30.f, 20.f),  coneLimit(30.f, 20.f) } },
+};
+
+// indices of the joints of <preset>, false if one of them isn't in the skeleton
+static bool findPresetJoints(const ChainPreset &preset, const std::unordered_map<std::string, int> &joint_map, int *joints) {
+	for (int i = 0; i < ChainPreset::joint_count; ++i) {
+		auto it = joint_map.find(preset.joints[i]);
+		if (it == joint_map.end()) {
+			return false;
+		}
+		joints[i] = it->second;
+	}
+	return true;
+}
 
-static void getScreenPosRay(const gef::Vector2 &screen_position, const gef::Matrix44 &projection, const gef::Matrix44 &view, gef::Vector4 &start_point, gef::Vector4 &direction, const gef::Vector2 &screen_sz);
-static bool rayPlaneIntersect(gef::Vector4 &start_point, gef::Vector4 &direction, const gef::Vector4 &point_on_plane, const gef::Vector4 &plane_normal, gef::Vector4 &hitpoint);
+static IKResult solveCCDMatrix(gef::SkeletonPose &pose, const gef::Vec<Int32> &bones, const gef::Vector4 &target, int max_iterations, float epsilon);
 
-void AnimSystemIK::init(gef::Platform &plat, gef::Renderer3D *renderer3d, gef::InputManager *input_manager, const char *filename) {
+void AnimSystemIK::init(gef::Platform &plat, gef::Renderer3D *renderer3d, gef::InputManager *input_manager, AnimSystem3D *anim_system) {
 	type = AnimSystemType::InverseKinematics;
 	platform = &plat;
 	renderer = renderer3d;
 	input = input_manager;
-
-	PushAllocInfo("AnimIKInit");
-	loadSkeleton(filename);
-	PopAllocInfo();
+	anim3d = anim_system;
 }
 
 void AnimSystemIK::cleanup() {
 }
 
+static IKNode *findIKNode(BlendTree &tree) {
+	for (ITreeNode *node : tree.all_nodes) {
+		if (node->node_type == NodeType::IK) {
+			return (IKNode *)node;
+		}
+	}
+	return nullptr;
+}
+
+IKNode *AnimSystemIK::findNode() {
+	return findIKNode(anim3d->getBlendTree());
+}
+
+IKNode *AnimSystemIK::getNode() {
+	BlendTree &tree = anim3d->getBlendTree();
+
+	IKNode *node = findIKNode(tree);
+	bool added = false;
+	if (!node) {
+		if (!tree.exit_node) {
+			return nullptr;
+		}
+		// the tree was made without ik, it goes on top of everything else
+		PushAllocInfo("AnimIKNode");
+		node = tree.arena.make<IKNode>(tree);
+		PopAllocInfo();
+		node->input_nodes.emplace_back(tree.exit_node);
+		tree.all_nodes.emplace_back(node);
+		tree.exit_node = node;
+		added = true;
+	}
+
+	// a node made in the editor starts without chains
+	if (node->rig.getChainCount() == 0) {
+		buildDefaultRig(node->rig);
+		selected_chain = 0;
+	}
+
+	if (added && tree_changed) {
+		tree_changed(tree_changed_data);
+	}
+
+	return node;
+}
+
+bool AnimSystemIK::removeNode() {
+	BlendTree &tree = anim3d->getBlendTree();
+
+	// only the node on top of the tree can come out without rewiring the rest of it
+	IKNode *node = findIKNode(tree);
+	if (!node || node != tree.exit_node || node->input_nodes.size() != 1) {
+		return false;
+	}
+
+	for (auto it = tree.value_map.begin(); it != tree.value_map.end();) {
+		if (it->second == node->getInputValue()) it = tree.value_map.erase(it);
+		else                                      ++it;
+	}
+	tree.exit_node = node->input_nodes[0];
+	tree.all_nodes.erase(tree.all_nodes.find(node));
+	// the editor has a node pointing to this one, it has to go before it's destroyed
+	if (tree_changed) {
+		tree_changed(tree_changed_data);
+	}
+	// the arena gives the memory back when the tree is cleaned up
+	node->~IKNode();
+
+	selected_chain = 0;
+	return true;
+}
+
 bool AnimSystemIK::update(float delta_time) {
+	IKNode *node = findNode();
 	bool mb_down = false;
 
 	if (auto mouse = input->touch_manager()) {
 		mb_down = mouse->is_button_down(0);
 		mouse_pos = mouse->mouse_position();
 	}
+	bool mb_pressed = mb_down && !was_mouse_down;
+	was_mouse_down = mb_down;
+
+	// the joint boxes go in a bvh in the update of the 3d system, only while they're used
+	anim3d->setPicking(node && (snap_to_surface || pick_joints));
 
-	if (mb_down) {
+	if (node && mb_down && selected_chain < node->rig.getChainCount()) {
 		gef::Vector4 mouse_ray_start_point, mouse_ray_direction;
-		static float ndc_zmin_;
 		getScreenPosRay(
 			mouse_pos, 
-			renderer->projection_matrix(), 
-			renderer->view_matrix(), 
+			inv_view_projection.get(renderer->view_matrix(), renderer->projection_matrix()),
 			mouse_ray_start_point, 
 			mouse_ray_direction,
 			platform->size() 
 		);
 
-		if (rayPlaneIntersect(
-				mouse_ray_start_point, 
-				mouse_ray_direction, 
-				gef::Vector4::kZero, 
-				gef::Vector4(0.0f, 0.0f, 1.0f), 
-				dest_pos
-			)
-		) {
-			calculateCCD();
-			skinned_mesh->UpdateBoneMatrices(ik_pose);
+		if (!pick_joints) {
+			moveTarget(*node, mouse_ray_start_point, mouse_ray_direction);
+		}
+		else if (mb_pressed) {
+			pickJoint(*node, mouse_ray_start_point, mouse_ray_direction);
 		}
 	}
 
-	return true;
+	if (node) {
+		node->jobs = use_jobs ? jobs : nullptr;
+	}
+
+	// the node is solved by the blend tree, on top of the animation
+	return anim3d->update(delta_time);
 }
 
-void AnimSystemIK::draw() {
-	if (!renderer || !skinned_mesh) {
+void AnimSystemIK::moveTarget(IKNode &node, const gef::Vector4 &ray_start, const gef::Vector4 &ray_direction) {
+	const IKRigChain &rig_chain = node.rig.getChain(selected_chain);
+
+	// the chain is left out, otherwise the target would end up on the limb that's chasing it
+	Int32 ignore_subtree = rig_chain.chain.empty() ? -1 : rig_chain.chain.getRoot();
+	if (snap_to_surface && anim3d->raycast(ray_start, ray_direction, last_hit, ignore_subtree)) {
+		dest_pos = ray_start + ray_direction * last_hit.distance;
+		anim3d->getBlendTree().setTarget(rig_chain.name, last_hit.point);
+		return;
+	}
+
+	if (rayPlaneIntersect(
+			ray_start, 
+			ray_direction, 
+			gef::Vector4::kZero, 
+			gef::Vector4(0.0f, 0.0f, 1.0f), 
+			dest_pos
+		)
+	) {
+		// move the destination point from world space to model space
+		gef::Matrix44 world_to_model_tran;
+		world_to_model_tran.Inverse(anim3d->getSkinnedMesh()->transform());
+		anim3d->getBlendTree().setTarget(rig_chain.name, dest_pos.Transform(world_to_model_tran));
+	}
+}
+
+void AnimSystemIK::pickJoint(IKNode &node, const gef::Vector4 &ray_start, const gef::Vector4 &ray_direction) {
+	if (!anim3d->raycast(ray_start, ray_direction, last_hit)) {
+		picked_joint = -1;
+		picked_joint_name.clear();
 		return;
 	}
 
-	renderer->DrawSkinnedMesh(*skinned_mesh, skinned_mesh->bone_matrices());
+	picked_joint = last_hit.joint;
+	picked_joint_name.clear();
+	for (const auto &[name, index] : anim3d->getJointMap()) {
+		if (index == picked_joint) {
+			picked_joint_name = name;
+			break;
+		}
+	}
+
+	// fingers and toes aren't in a chain, the hand or foot above them is
+	const gef::Skeleton &skeleton = *anim3d->getSkinnedMesh()->bind_pose().skeleton();
+	for (Int32 joint = picked_joint; joint >= 0; joint = skeleton.joint(joint).parent) {
+		for (int i = 0; i < node.rig.getChainCount(); ++i) {
+			const gef::Vec<Int32> &joints = node.rig.getChain(i).chain.getJoints();
+			if (std::find(joints.begin(), joints.end(), joint) != joints.end()) {
+				selected_chain = i;
+				return;
+			}
+		}
+	}
+}
+
+void AnimSystemIK::deactivate() {
+	// the 3d system would keep building the bvh for a picking nobody does
+	anim3d->setPicking(false);
+	was_mouse_down = false;
+}
+
+void AnimSystemIK::draw() {
+	anim3d->draw();
 }
 
 void AnimSystemIK::debugDraw() {
-	ImGui::Text("Hello World!");
+	if (!anim3d->getBlendTree().exit_node) {
+		ImGui::Text("The blend tree of the 3D system is empty, there's nothing to put ik on");
+		return;
+	}
+
+	IKNode *node = findNode();
+	bool enabled = node != nullptr;
+	if (ImGui::Checkbox("IK node", &enabled)) {
+		if (enabled) node = getNode();
+		else if (removeNode()) node = nullptr;
+		else warn("the ik node isn't on top of the blend tree, remove it in the editor");
+	}
+	imHelper("Puts an ik node on top of the blend tree of the 3D system, the chains are solved after the animation");
+	if (!node) {
+		return;
+	}
+	IKRig &rig = node->rig;
+
+	imSaveAndRead(this, "IK Rig Files (.ikrig)", "*.ikrig");
+
+	if (rig.getChainCount() == 0) {
+		ImGui::Text("No ik chains");
+		return;
+	}
+
+	ImGui::SliderFloat("IK weight", &rig.weight, 0.f, 1.f);
+	imHelper("Weight of the ik node in the blend tree, it can also be bound to a value in the editor");
+
+	ImGui::Checkbox("Snap targets to the character", &snap_to_surface);
+	imHelper("Targets go on the joint boxes under the mouse, the z = 0 plane is only used when it misses them");
+	ImGui::Checkbox("Click picks joints", &pick_joints);
+	imHelper("Clicking on the character selects the chain of the joint under the mouse instead of moving a target");
+	if (pick_joints) {
+		ImGui::Text("Picked joint: %s", picked_joint >= 0 ? picked_joint_name.c_str() : "none");
+	}
+	if (anim3d->isPicking()) {
+		const PoseBVH &bvh = anim3d->getPoseBVH();
+		ImGui::Text("Picking: %zu bvh nodes, %d boxes tested by the last ray", bvh.getNodeCount(), bvh.getLastTestCount());
+	}
+
+	ImGui::Text("Chains (click to pick the one the mouse moves)");
+	for (int i = 0; i < rig.getChainCount(); ++i) {
+		const IKRigChain &rig_chain = rig.getChain(i);
+		gef::ptr<char> label = rig_chain.chain.empty() ?
+			strfmt("%s (missing joints)###chain%d", rig_chain.name.c_str(), i) :
+			strfmt("%s: %d iterations, %.3f away###chain%d", rig_chain.name.c_str(), rig_chain.result.iterations, rig_chain.result.distance, i);
+		if (ImGui::Selectable(label.get(), i == selected_chain)) {
+			selected_chain = i;
+		}
+	}
+
+	ImGui::Separator();
+
+	IKRigChain &rig_chain = rig.getChain(selected_chain);
+	ImGui::Text("%s", rig_chain.name.c_str());
+	if (rig_chain.depends_on >= 0) {
+		ImGui::SameLine();
+		ImGui::TextDisabled("(solved after %s)", rig.getChain(rig_chain.depends_on).name.c_str());
+	}
+
+	ImGui::Checkbox("Enabled", &rig_chain.enabled);
+	ImGui::SliderFloat("Weight", &rig_chain.weight, 0.f, 1.f);
+
+	if (ImGui::BeginCombo("Solver", getIKSolverName(rig_chain.solver))) {
+		for (uint8_t i = 0; i < (uint8_t)IKSolver::Count; ++i) {
+			if (ImGui::Selectable(getIKSolverName((IKSolver)i), (IKSolver)i == rig_chain.solver)) {
+				rig_chain.solver = (IKSolver)i;
+			}
+		}
+		ImGui::EndCombo();
+	}
+
+	ImGui::Checkbox("Pole", &rig_chain.has_pole);
+	imHelper("Model space point the middle joint of a two bone chain bends towards");
+	if (rig_chain.has_pole) {
+		float values[3] = { rig_chain.pole.x(), rig_chain.pole.y(), rig_chain.pole.z() };
+		if (ImGui::DragFloat3("Pole position", values)) {
+			rig_chain.pole = gef::Vector4(values[0], values[1], values[2]);
+		}
+	}
+
+	if (ImGui::TreeNode("Joint limits")) {
+		imHelper("Relative to the bind pose. CCD keeps to them on every step, the other solvers clamp their result");
+		bool changed = false;
+		if (rig_chain.limits.size() < rig_chain.joint_names.size()) {
+			rig_chain.limits.resize(rig_chain.joint_names.size(), IKJointLimit());
+		}
+		// the end effector doesn't move the chain, it has no limit
+		for (size_t i = 0; i + 1 < rig_chain.joint_names.size(); ++i) {
+			IKJointLimit &limit = rig_chain.limits[i];
+			ImGui::PushID((int)i);
+			ImGui::Text("%s", rig_chain.joint_names[i].c_str());
+			if (ImGui::BeginCombo("Limit", getIKLimitName(limit.type))) {
+				for (uint8_t t = 0; t < (uint8_t)IKLimit::Count; ++t) {
+					if (ImGui::Selectable(getIKLimitName((IKLimit)t), (IKLimit)t == limit.type)) {
+						limit.type = (IKLimit)t;
+						changed = true;
+					}
+				}
+				ImGui::EndCombo();
+			}
+			switch (limit.type) {
+			case IKLimit::Hinge:
+			{
+				float values[3] = { limit.axis.x(), limit.axis.y(), limit.axis.z() };
+				if (ImGui::DragFloat3("Axis", values, 0.01f, -1.f, 1.f)) {
+					limit.axis = gef::Vector4(values[0], values[1], values[2]);
+					changed = true;
+				}
+				imHelper("Model space, in the bind pose");
+				changed |= ImGui::SliderAngle("Min", &limit.min_angle, -180.f, 180.f);
+				changed |= ImGui::SliderAngle("Max", &limit.max_angle, -180.f, 180.f);
+				break;
+			}
+			case IKLimit::Cone:
+				changed |= ImGui::SliderAngle("Cone", &limit.max_angle, 0.f, 180.f);
+				changed |= ImGui::SliderAngle("Twist", &limit.twist, 0.f, 180.f);
+				break;
+			default:
+				break;
+			}
+			ImGui::PopID();
+		}
+		if (changed) {
+			node->buildRig();
+		}
+		ImGui::TreePop();
+	}
+
+	if (rig_chain.has_target && ImGui::Button("Clear target")) {
+		anim3d->getBlendTree().clearTarget(rig_chain.name);
+	}
+
+	ImGui::Separator();
+
+	if (jobs) {
+		ImGui::Checkbox("Solve on the job system", &use_jobs);
+		imHelper("Chains that don't move each other are solved at the same time");
+	}
+	ImGui::Checkbox("Warm start", &rig.warm_start);
+	imHelper("Every chain starts from the solution of the last frame");
+	ImGui::DragFloat("Early out distance", &rig.early_out_distance, 0.001f, 0.f, 10.f, "%.3f");
+	imHelper("Converged chains whose target moved less than this aren't solved again");
+	ImGui::DragFloat("Time budget (us)", &rig.time_budget_us, 1.f, 0.f, 10000.f, "%.0f");
+	imHelper("Chains stop iterating once it runs out and carry on next frame, 0 means no budget");
+
+	const IKRig::Stats &frame = rig.getFrameStats();
+	const IKRig::Stats &total = rig.getTotalStats();
+	ImGui::Text("%d chains, %d independent", rig.getChainCount(), rig.getIndependentCount());
+	ImGui::Text("Last solve: %.2f us", node->last_solve_us);
+	ImGui::Text("frame: %d solved, %d skipped, %d out of time, %d iterations", frame.solved, frame.skipped, frame.out_of_time, frame.iterations);
+	ImGui::Text("total: %d solved, %d skipped, %d out of time, %d iterations", total.solved, total.skipped, total.out_of_time, total.iterations);
+	if (ImGui::Button("Reset stats")) {
+		rig.resetStats();
+	}
+
+	ImGui::Separator();
+	ImGui::DragInt("Benchmark targets", &benchmark_targets, 1.f, 1, 10000);
+	if (ImGui::Button("Solver benchmark")) {
+		runSolverBenchmark(benchmark_targets);
+	}
+	imHelper("Solves every chain for the same random targets with each solver, starting from the bind pose");
+
+	if (!benchmark_results.empty() && ImGui::BeginTable("solver benchmark", 7, ImGuiTableFlags_Borders)) {
+		ImGui::TableSetupColumn("chain");
+		ImGui::TableSetupColumn("solver");
+		ImGui::TableSetupColumn("reached");
+		ImGui::TableSetupColumn("iterations");
+		ImGui::TableSetupColumn("distance");
+		ImGui::TableSetupColumn("us per solve");
+		ImGui::TableSetupColumn("iterations per us");
+		ImGui::TableHeadersRow();
+
+		for (const SolverBenchmarkResult &result : benchmark_results) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%s", result.chain);
+			ImGui::TableNextColumn(); ImGui::Text("%s", result.solver);
+			ImGui::TableNextColumn(); ImGui::Text("%d / %d", result.reached, result.solves);
+			ImGui::TableNextColumn(); ImGui::Text("%.1f", result.iterations);
+			ImGui::TableNextColumn(); ImGui::Text("%.4f", result.distance);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", result.solve_us);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", result.iterations_per_us);
+		}
+
+		ImGui::EndTable();
+	}
 }
 
 void AnimSystemIK::save(FILE *fp) const {
-	// no-op
-	(void)fp;
+	if (!fp) return;
+
+	fileWrite(format_ver, fp);
+	if (IKNode *node = findIKNode(anim3d->getBlendTree())) {
+		node->rig.save(fp);
+	}
+	else {
+		IKRig().save(fp);
+	}
 }
 
 void AnimSystemIK::read(FILE *fp) {
-	// no-op
-	(void)fp;
+	if (!fp) return;
+
+	IKNode *node = getNode();
+	if (!node) {
+		err("couldn't read the ik rig, the blend tree is empty");
+		return;
+	}
+
+	// the versions of the system and of the rig have been the same so far
+	if (!node->rig.read(fp, file_version)) {
+		err("couldn't read the ik rig");
+	}
+	node->buildRig();
+	node->pushTargets();
+	selected_chain = 0;
 }
 
 bool AnimSystemIK::checkFormatVersion(FILE *fp) {
-	// no-op
-	return false;
+	if (!fp) return false;
+	file_version = 0;
+	fread(&file_version, 1, sizeof(file_version), fp);
+	return file_version >= min_format_ver && file_version <= format_ver;
 }
 
 void AnimSystemIK::setAnimation(const char *name) {
@@ -100,13 +493,11 @@ void AnimSystemIK::setAnimation(int id) {
 }
 
 gef::Transform AnimSystemIK::getTransform() const {
-	return skinned_mesh ? skinned_mesh->transform() : gef::Transform::kIdentity;
+	return anim3d->getTransform();
 }
 
 void AnimSystemIK::setTransform(const gef::Transform &tran) {
-	if (skinned_mesh) {
-		skinned_mesh->set_transform(tran.GetMatrix());
-	}
+	anim3d->setTransform(tran);
 }
 
 void AnimSystemIK::drawPointer(Batch2D &batch) {
@@ -122,74 +513,142 @@ void AnimSystemIK::drawPointer(Batch2D &batch) {
 	batch.drawLine(c, d, wid, gef::Colour::green);
 }
 
-void AnimSystemIK::loadSkeleton(const char *filename) {
-	assert(platform);
-	
-	SceneLoader loader;
-	if (loader.loadScene(*platform, filename)) {
-		loader.createMaterials(*platform);
-		loader.createMeshes(*platform);
-
-		skeleton = loader.popFirstSkeleton();
-		mesh = loader.popFirstMesh();
-
-		skinned_mesh = gef::ptr<gef::SkinnedMeshInstance>::make(skeleton);
-		ik_pose = skinned_mesh->bind_pose();
-		skinned_mesh->set_mesh(mesh.get());
-		skinned_mesh->UpdateBoneMatrices(skinned_mesh->bind_pose());
-
-		textures = loader.moveTextures();
-		materials = loader.moveMaterials();
-
-		auto &string_table = loader.getStringTable();
-		const auto &joints = skeleton.joints();
-
-		for (size_t i = 0; i < joints.size(); ++i) {
-			std::string bone_name;
-			if (string_table.Find(joints[i].name_id, bone_name)) {
-				size_t start = bone_name.find_first_of(':');
-				if (start != std::string::npos) {
-					bone_name = bone_name.substr(++start);
+void AnimSystemIK::buildDefaultRig(IKRig &rig) {
+	rig.clear();
+	gef::SkinnedMeshInstance *skinned_mesh = anim3d->getSkinnedMesh();
+	if (!skinned_mesh) {
+		return;
+	}
+	buildPresetRig(rig, *skinned_mesh->bind_pose().skeleton(), anim3d->getJointMap());
+}
+
+void AnimSystemIK::buildPresetRig(IKRig &rig, const gef::Skeleton &skeleton, const std::unordered_map<std::string, int> &joint_map) {
+	rig.clear();
+
+	for (const ChainPreset &preset : chain_presets) {
+		gef::Vec<std::string> chain_joints;
+		for (const char *joint : preset.joints) {
+			chain_joints.push_back(joint);
+		}
+		int index = rig.addChain(preset.name, chain_joints);
+		for (const IKJointLimit &limit : preset.limits) {
+			rig.getChain(index).limits.push_back(limit);
+		}
+	}
+
+	rig.build(skeleton, joint_map);
+}
+
+// the matrix solver, then every solver of the chain but auto, then the iterative
+// ones again with the limits of the preset
+struct BenchmarkRow {
+	const char *name;
+	IKSolver solver;
+	bool matrix;
+	bool limits;
+};
+
+static const BenchmarkRow benchmark_rows[] = {
+	{ "Matrix CCD",    IKSolver::CCD,     true,  false },
+	{ "CCD",           IKSolver::CCD,     false, false },
+	{ "FABRIK",        IKSolver::FABRIK,  false, false },
+	{ "Two bone",      IKSolver::TwoBone, false, false },
+	{ "CCD limits",    IKSolver::CCD,     false, true },
+	{ "FABRIK limits", IKSolver::FABRIK,  false, true },
+};
+
+void AnimSystemIK::runSolverBenchmark(int targets) {
+	benchmark_results.clear();
+	gef::SkinnedMeshInstance *skinned_mesh = anim3d->getSkinnedMesh();
+	if (!skinned_mesh || targets <= 0) {
+		return;
+	}
+
+	const gef::SkeletonPose &bind_pose = skinned_mesh->bind_pose();
+	const gef::Skeleton &skeleton = *bind_pose.skeleton();
+	gef::SkeletonPose pose = bind_pose;
+	gef::Vec<gef::Vector4> points;
+	points.reserve(targets);
+	float per_target = 1.f / (float)targets;
+
+	for (const ChainPreset &preset : chain_presets) {
+		IKChain bench_chain;
+		int joints[ChainPreset::joint_count];
+		if (!findPresetJoints(preset, anim3d->getJointMap(), joints) || !bench_chain.init(skeleton, joints, ChainPreset::joint_count)) {
+			continue;
+		}
+
+		// targets around the root of the chain, some of them out of reach.
+		// the same seed for every chain so they can be compared
+		bench_chain.begin(bind_pose);
+		gef::Vector4 centre = bind_pose.global_pose()[joints[0]].GetTranslation();
+		float radius = bench_chain.getLength() * 1.2f;
+
+		points.clear();
+		uint32_t state = 0x2545f491u;
+		while ((int)points.size() < targets) {
+			gef::Vector4 offset(randFloat(state, -1.f, 1.f), randFloat(state, -1.f, 1.f), randFloat(state, -1.f, 1.f));
+			if (offset.LengthSqr() <= 1.f) {
+				points.push_back(centre + offset * radius);
+			}
+		}
+
+		for (const BenchmarkRow &row : benchmark_rows) {
+			SolverBenchmarkResult bench = { preset.name, row.name, targets, 0, 0.f, 0.f, 0.f, 0.f };
+			int iterations = 0;
+			double total_us = 0.0;
+
+			bench_chain.clearLimits();
+			if (row.limits) {
+				for (int i = 0; i < ChainPreset::joint_count; ++i) {
+					bench_chain.setLimit(i, preset.limits[i]);
 				}
-				info("%zu: %s", i, bone_name.c_str());
-				bone_map[bone_name] = (int)i;
 			}
-			else {
-				warn("could not find bone %zu in string table", i);
+
+			for (const gef::Vector4 &point : points) {
+				pose = bind_pose;
+				IKResult result;
+
+				double start = timeNowUs();
+				if (row.matrix) {
+					result = solveCCDMatrix(pose, bench_chain.getJoints(), point, max_iterations, epsilon);
+				}
+				else {
+					bench_chain.solver = row.solver;
+					bench_chain.begin(pose);
+					result = bench_chain.solve(point, max_iterations, epsilon);
+					bench_chain.apply(pose);
+				}
+				total_us += timeNowUs() - start;
+
+				iterations += result.iterations;
+				bench.reached += result.reached;
+				// the error of the pose, not what the solver thinks it is
+				bench.distance += (point - pose.global_pose()[joints[ChainPreset::joint_count - 1]].GetTranslation()).Length();
 			}
+
+			bench.iterations = iterations * per_target;
+			bench.distance *= per_target;
+			bench.solve_us = (float)total_us * per_target;
+			bench.iterations_per_us = total_us > 0.0 ? (float)(iterations / total_us) : 0.f;
+			benchmark_results.push_back(bench);
+
+			info("ik benchmark: %s %s, %.2f us, %.1f iterations, %d of %d reached", bench.chain, bench.solver, bench.solve_us, bench.iterations, bench.reached, targets);
 		}
 	}
-	// right arm
-	// ccd_bones = { 43, 44, 45 };
-	
-	// right leg
-	// ccd_bones = { 9, 10, 11 };
-	
-	// left arm
-	ccd_bones = { 18, 19, 20 };
-
-	// left leg
-	// ccd_bones = { 5, 6, 7 };
-	
-	// back
-	// ccd_bones = { 4, 13, 14 };
 }
 
-bool AnimSystemIK::calculateCCD() {
+// the first solver, it works on the global matrices and rebuilds the whole pose.
+// kept to compare the chain solver against in the benchmark
+static IKResult solveCCDMatrix(gef::SkeletonPose &ik_pose, const gef::Vec<Int32> &ccd_bones, const gef::Vector4 &dest_point_modelspace, int max_iterations, float epsilon) {
+	IKResult result;
 	if (ccd_bones.size() < 2) {
-		return false;
+		return result;
 	}
 
 	gef::Vec<gef::Matrix44> &global_pose = ik_pose.global_pose();
 	gef::Vec<gef::JointPose> &local_pose = ik_pose.local_pose();
 
-	//obtain the inverse of the animated model's transform
-	gef::Matrix44 world_to_model_tran;
-	world_to_model_tran.Inverse(skinned_mesh->transform());
-
-	//...and use it to move the destination point from world space to model space
-	gef::Vector4 dest_point_modelspace = dest_pos.Transform(world_to_model_tran);
-
 	// Get the end effectors position
 	gef::Vector4 end_effector = global_pose[ccd_bones.back()].GetTranslation();
 
@@ -198,18 +657,12 @@ bool AnimSystemIK::calculateCCD() {
 	float old_distance = distance;
 	float distance_delta = distance;
 
-	float epsilon = 0.01f;
-	//max number of iterations is used to stop CCD if there is no solution
-	int max_iterations = 200;
-
-	bool once = true;
-
 	//perform the CCD algorithm if all the following conditions are valid
 	/*
 	- if the distance between the end effector point is greater than epsilon
 	- we have not reached the maximum number of iterations
 	*/
-	while ((distance > epsilon) && (max_iterations > 0) && (distance_delta > epsilon)) {
+	while ((distance > epsilon) && (result.iterations < max_iterations) && (distance_delta > epsilon)) {
 		for (int i = (int)ccd_bones.size() - 2; i >= 0; --i) {
 			int bone = ccd_bones[i];
 
@@ -254,8 +707,7 @@ bool AnimSystemIK::calculateCCD() {
 		distance_delta = fabsf(old_distance - distance);
 		old_distance = distance;
 
-		//if a solution has not been reached, decrement the iterations counter
-		--max_iterations;
+		result.iterations++;
 	}
 
 	// This remain part of the function updates the gef::SkeletonPose with the newly calculate bone
@@ -288,70 +740,7 @@ bool AnimSystemIK::calculateCCD() {
 			global_pose[i] = local * global_pose[joint.parent];
 	}
 
-	return max_iterations > 0;
+	result.distance = distance;
+	result.reached = distance <= epsilon;
+	return result;
 }
-
-// http://antongerdelan.net/opengl/raycasting.html
-// https://forum.libcinder.org/topic/picking-ray-from-mouse-coords
-static void getScreenPosRay(
-	const gef::Vector2 &screen_position, 
-	const gef::Matrix44 &projection, 
-	const gef::Matrix44 &view, 
-	gef::Vector4 &start_point, 
-	gef::Vector4 &direction, 
-	const gef::Vector2 &screen_sz
-) {
-	gef::Vector2 half_sz = screen_sz / 2.f;
-
-	gef::Vector2 ndc = {
-		(screen_position.x - half_sz.x) / half_sz.x,
-		(half_sz.y - screen_position.y) / half_sz.y
-	};
-
-	gef::Matrix44 projectionInverse;
-	projectionInverse.Inverse(view * projection);
-
-	gef::Vector4 nearPoint, farPoint;
-
-	constexpr float ndc_z_min = 0.0001f;
-	nearPoint = gef::Vector4(ndc.x, ndc.y, ndc_z_min, 1.0f).TransformW(projectionInverse);
-	farPoint = gef::Vector4(ndc.x, ndc.y, 1.0f, 1.0f).TransformW(projectionInverse);
-
-	nearPoint /= nearPoint.w();
-	farPoint /= farPoint.w();
-
-	start_point = gef::Vector4(nearPoint.x(), nearPoint.y(), nearPoint.z());
-	direction = farPoint - nearPoint;
-	direction.Normalise();
-}
-
-// modified and fixed from https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-plane-and-ray-disk-intersection
-static bool rayPlaneIntersect(
-	gef::Vector4 &start_point, 
-	gef::Vector4 &direction, 
-	const gef::Vector4 &point_on_plane, 
-	const gef::Vector4 &plane_normal, 
-	gef::Vector4 &hitpoint
-) {
-	gef::Vector4 p0, l0, n, l;
-	l0 = start_point;
-	l = direction;
-	p0 = point_on_plane;
-	n = plane_normal;
-	float t = 0.0f;
-
-	// assuming vectors are all normalized
-	float denom = n.DotProduct(l);
-	if (fabsf(denom) > 1e-6) {
-		gef::Vector4 p0l0 = p0 - l0;
-		t = p0l0.DotProduct(n) / denom;
-
-		if (t >= 0)
-			hitpoint = start_point + direction * t;
-
-		return (t >= 0);
-	}
-
-	return false;
-}
-
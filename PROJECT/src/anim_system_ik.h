@@ -1,25 +1,26 @@
 #pragma once
 
-#include <unordered_map>
-#include <string>
-
 #include <system/vec.h>
-#include <system/ptr.h>
+#include <system/job_system.h>
 #include <animation/skeleton.h>
-#include <graphics/material.h>
-#include <graphics/texture.h>
 
 #include "anim_system.h"
+#include "ik_chain.h"
+#include "ik_rig.h"
+#include "pose_bvh.h"
 
 namespace gef {
 	class Platform;
 	class InputManager;
 	class Renderer3D;
-	class SkinnedMeshInstance;
 }
 
 struct Batch2D;
+struct IKNode;
+class AnimSystem3D;
 
+// edits the ik node of the blend tree of a 3d system, the chains are solved on
+// top of its animation. there's no character of its own, it draws the 3d one
 class AnimSystemIK : public AnimSystem {
 public:
 	virtual bool update(float delta_time) override;
@@ -32,29 +33,89 @@ public:
 	virtual void setAnimation(int id) override;
 	virtual gef::Transform getTransform() const override;
 	virtual void setTransform(const gef::Transform &tran) override;
+	virtual void deactivate() override;
 
-	void init(gef::Platform &plat, gef::Renderer3D *renderer, gef::InputManager *input_manager, const char *filename);
+	void init(gef::Platform &plat, gef::Renderer3D *renderer, gef::InputManager *input_manager, AnimSystem3D *anim_system);
 	void cleanup();
 
 	void drawPointer(Batch2D &batch);
 
+	// when set, the independent chains of the rig are solved at the same time
+	void setJobSystem(gef::JobSystem *job_system) { jobs = job_system; }
+	// called after the ik node is added to or removed from the blend tree, before a removed
+	// node is destroyed. the tree editor generates its nodes again from it
+	using TreeChangedFunc = void (*)(void *user_data);
+	void setTreeChangedCallback(TreeChangedFunc func, void *user_data) { tree_changed = func; tree_changed_data = user_data; }
+
+	// the ik node of the blend tree, one is added on top of the exit node if there
+	// isn't one. null if the tree has no exit node
+	IKNode *getNode();
+	// the ik node of the blend tree if it has one, without adding it
+	IKNode *findNode();
+	// takes the node added by getNode off the top of the tree, false if there isn't
+	// one or it's been wired somewhere else in the editor
+	bool removeNode();
+
+	struct SolverBenchmarkResult {
+		const char *chain;
+		const char *solver;
+		int solves;
+		int reached;
+		float iterations;   // average per solve
+		float distance;     // average distance left to the target
+		float solve_us;     // average per solve, with the pose update
+		float iterations_per_us;
+	};
+	// solves every chain for the same random targets with the matrix solver and
+	// each solver of IKChain, starting from the bind pose every time. ccd and fabrik
+	// run again with the joint limits of the chain
+	void runSolverBenchmark(int targets);
+	const gef::Vec<SolverBenchmarkResult> &getBenchmarkResults() const { return benchmark_results; }
+
+	// last joint clicked with joint picking on, -1 if there isn't one
+	Int32 getPickedJoint() const { return picked_joint; }
+
+	// a chain for each limb and one for the back of the xbot skeleton, with their joint
+	// limits. the joints are found by name, so any skeleton with the same names works
+	static void buildPresetRig(IKRig &rig, const gef::Skeleton &skeleton, const std::unordered_map<std::string, int> &joint_map);
+
 private:
-	void loadSkeleton(const char *filename);
-	bool calculateCCD();
+	// the preset rig on the skeleton of the 3d system
+	void buildDefaultRig(IKRig &rig);
+	// moves the target of the selected chain under the mouse ray
+	void moveTarget(IKNode &node, const gef::Vector4 &ray_start, const gef::Vector4 &ray_direction);
+	// selects the chain of the joint under the mouse ray, or of the closest joint above it
+	void pickJoint(IKNode &node, const gef::Vector4 &ray_start, const gef::Vector4 &ray_direction);
 
 	gef::Platform *platform = nullptr;
 	gef::Renderer3D *renderer = nullptr;
 	gef::InputManager *input = nullptr;
-	gef::Skeleton skeleton;
-	gef::ptr<gef::Mesh> mesh = nullptr;
-	gef::ptr<gef::SkinnedMeshInstance> skinned_mesh = nullptr;
-	gef::Vec<gef::ptr<gef::Texture>> textures;
-	gef::Vec<gef::Material> materials;
-
-	std::unordered_map<std::string, int> bone_map;
+	AnimSystem3D *anim3d = nullptr;
 
 	gef::Vector2 mouse_pos;
 	gef::Vector4 dest_pos;
-	gef::SkeletonPose ik_pose;
-	gef::Vec<int> ccd_bones;
+	bool was_mouse_down = false;
+	// the chain the mouse moves
+	int selected_chain = 0;
+	InverseViewProjection inv_view_projection;
+	// == picking against the joint boxes of the character ==
+	// targets go on the surface under the mouse instead of the z = 0 plane
+	bool snap_to_surface = true;
+	// a click selects the chain of the joint under it instead of moving a target
+	bool pick_joints = false;
+	Int32 picked_joint = -1;
+	std::string picked_joint_name;
+	RayHit last_hit;
+	gef::JobSystem *jobs = nullptr;
+	bool use_jobs = true;
+	TreeChangedFunc tree_changed = nullptr;
+	void *tree_changed_data = nullptr;
+
+	static constexpr int max_iterations = 200;
+	static constexpr float epsilon = 0.01f;
+
+	uint8_t file_version = 0;
+
+	int benchmark_targets = 256;
+	gef::Vec<SolverBenchmarkResult> benchmark_results;
 };
\ No newline at end of file
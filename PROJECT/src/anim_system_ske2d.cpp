@@ -92,9 +92,9 @@ namespace json = rapidjson;
 static gef::ptr<char[]> LoadJSON(const char *filename);
 
 template<typename T>
-static T getOrValue(const json::Value &value, const char *name, const T &default) {
+static T getOrValue(const json::Value &value, const char *name, const T &default_value) {
 	const auto &found = value.FindMember(name);
-	if (found == value.MemberEnd()) return default;
+	if (found == value.MemberEnd()) return default_value;
 	return found->value.Get<T>();
 }
 
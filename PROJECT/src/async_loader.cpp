@@ -0,0 +1,153 @@
+#include "async_loader.h"
+
+#include <thread>
+
+#include <system/platform.h>
+#include <system/job_system.h>
+#include <system/allocator.h>
+
+#include "utils.h"
+
+// == ASYNC LOADER ==================================
+
+AsyncLoader::~AsyncLoader() {
+	cleanup();
+}
+
+void AsyncLoader::init(gef::Platform &plat, gef::JobSystem *job_system) {
+	platform = &plat;
+	jobs = job_system;
+}
+
+void AsyncLoader::cleanup() {
+	// the jobs still have pointers to the requests, let them finish first
+	for (const SceneFuture &future : prefetched) {
+		wait(*future);
+	}
+	prefetched.clear();
+}
+
+SceneFuture AsyncLoader::load(const char *filename, const void *owner) {
+	for (size_t i = 0; i < prefetched.size(); ++i) {
+		if (prefetched[i]->owner == owner && prefetched[i]->filename == filename) {
+			SceneFuture future = std::move(prefetched[i]);
+			prefetched.erase(i);
+			return future;
+		}
+	}
+
+	return start(filename);
+}
+
+void AsyncLoader::prefetch(const char *filename, const void *owner) {
+	for (const SceneFuture &future : prefetched) {
+		if (future->owner == owner && future->filename == filename) {
+			return;
+		}
+	}
+	SceneFuture future = start(filename);
+	future->owner = owner;
+	prefetched.emplace_back(std::move(future));
+}
+
+void AsyncLoader::dropPrefetches(const void *owner) {
+	for (size_t i = 0; i < prefetched.size();) {
+		if (prefetched[i]->owner != owner) {
+			++i;
+			continue;
+		}
+		info("%s was prefetched but never loaded", prefetched[i]->filename.c_str());
+		// the jobs still have a pointer to it
+		wait(*prefetched[i]);
+		prefetched.erase(i);
+	}
+}
+
+bool AsyncLoader::isReady(const SceneFuture &future) const {
+	return future && future->pending.load() == 0;
+}
+
+SceneLoader *AsyncLoader::get(SceneFuture &future) {
+	if (!future) {
+		return nullptr;
+	}
+
+	SceneRequest &request = *future;
+	wait(request);
+
+	if (!request.success) {
+		err("couldn't load scene %s", request.filename.c_str());
+		return nullptr;
+	}
+
+	if (!request.resources_created) {
+		PushAllocInfo("AsyncLoader");
+		request.scene.createMaterials(*platform);
+		request.scene.createMeshes(*platform);
+		request.resources_created = true;
+		PopAllocInfo();
+	}
+
+	return &request.scene;
+}
+
+SceneFuture AsyncLoader::start(const char *filename) {
+	SceneFuture future = SceneFuture::make();
+	future->filename = filename;
+	future->platform = platform;
+	future->jobs = jobs;
+
+	if (jobs) {
+		jobs->run(jobs->create(sceneJob, future.get()));
+	}
+	else {
+		sceneJob(future.get(), 0, 1);
+	}
+
+	return future;
+}
+
+void AsyncLoader::wait(const SceneRequest &request) {
+	while (request.pending.load() > 0) {
+		if (!jobs || !jobs->runOne()) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void AsyncLoader::sceneJob(void *user_data, uint32_t begin, uint32_t end) {
+	(void)begin; (void)end;
+	SceneRequest &request = *(SceneRequest *)user_data;
+
+	PushAllocInfo("AsyncLoader");
+	request.success = request.scene.loadScene(*request.platform, request.filename.c_str());
+
+	if (request.success) {
+		int texture_count = request.scene.findTextures();
+		request.pending.fetch_add(texture_count);
+
+		for (int i = 0; i < texture_count; ++i) {
+			if (request.jobs) {
+				request.jobs->run(request.jobs->create(textureJob, &request, i, i + 1));
+			}
+			else {
+				textureJob(&request, i, i + 1);
+			}
+		}
+	}
+	PopAllocInfo();
+
+	request.pending.fetch_sub(1);
+}
+
+void AsyncLoader::textureJob(void *user_data, uint32_t begin, uint32_t end) {
+	SceneRequest &request = *(SceneRequest *)user_data;
+
+	PushAllocInfo("AsyncLoader");
+	for (uint32_t i = begin; i < end; ++i) {
+		request.scene.decodeTexture(*request.platform, (int)i);
+	}
+	PopAllocInfo();
+
+	request.pending.fetch_sub((int)(end - begin));
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include <system/vec.h>
+#include <system/ptr.h>
+
+#include "scene_loader.h"
+
+namespace gef {
+	class Platform;
+	class JobSystem;
+}
+
+// a scene that is being loaded in the background
+struct SceneRequest {
+	std::string filename;
+	// who the prefetch is for, only their load() picks it up
+	const void *owner = nullptr;
+	SceneLoader scene;
+	// the scene job plus one for every texture that still has to be decoded
+	std::atomic<int> pending = 1;
+	bool success = false;
+	bool resources_created = false;
+
+	gef::Platform *platform = nullptr;
+	gef::JobSystem *jobs = nullptr;
+};
+
+// keep it alive until get() has returned, the jobs write into it
+using SceneFuture = gef::ptr<SceneRequest>;
+
+// loads scene files on the job system: the file is read and parsed on a worker
+// thread, then every png it uses is decoded in its own job. only the gpu resources
+// (textures and vertex/index buffers) are created on the main thread, in get()
+class AsyncLoader {
+public:
+	~AsyncLoader();
+
+	// with no job system everything is loaded straight away in load()
+	void init(gef::Platform &plat, gef::JobSystem *job_system);
+	void cleanup();
+
+	// starts loading <filename> and returns straight away. a prefetch of the same
+	// file for the same <owner> is picked up instead of starting a new one
+	SceneFuture load(const char *filename, const void *owner = nullptr);
+	// starts loading <filename> for the next load() of <owner>. the scene is taken
+	// apart by whoever gets it, so two systems can't share a prefetch
+	void prefetch(const char *filename, const void *owner = nullptr);
+	// frees the prefetches of <owner> that weren't loaded, after their jobs are done
+	void dropPrefetches(const void *owner);
+
+	bool isReady(const SceneFuture &future) const;
+	// waits for <future> (running other jobs in the meantime) and creates its gpu
+	// resources, must be called on the main thread. returns null if loading failed
+	SceneLoader *get(SceneFuture &future);
+
+private:
+	SceneFuture start(const char *filename);
+	void wait(const SceneRequest &request);
+
+	static void sceneJob(void *user_data, uint32_t begin, uint32_t end);
+	static void textureJob(void *user_data, uint32_t begin, uint32_t end);
+
+	gef::Platform *platform = nullptr;
+	gef::JobSystem *jobs = nullptr;
+	gef::Vec<SceneFuture> prefetched;
+};
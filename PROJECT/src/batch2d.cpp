@@ -2,6 +2,7 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <math.h>
 #include <assert.h>
 
 #include <system/platform.h>
@@ -62,6 +63,8 @@ void Batch2D::begin(bool clear) {
 		platform->Clear();
 	}
 
+	drawn_vertices = 0;
+
 	proj = platform->OrthographicFrustum(
 		0.0f, (float)platform->width(),
 		0.0f, (float)platform->height(),
@@ -417,6 +420,7 @@ void Batch2D::drawBatch() {
 	// TODO vita support
 #endif
 
+	drawn_vertices += vertices.size();
 	texture = nullptr;
 	vertices.clear();
 }
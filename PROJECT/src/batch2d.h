@@ -62,6 +62,9 @@ struct Batch2D {
 	void drawText(const gef::Font *font, const gef::Vector2 &pos, float scale, const gef::Colour &colour, gef::TextJustification justification, const char *msg);
 	void drawChar(const gef::Font *font, char c, const gef::Vector2 &pos, const gef::Colour &col = gef::Colour::white, const gef::Vector2 &scale = gef::Vector2::kOne, float rot = 0.f, const gef::Vector2 &origin = { 0.5f, 0.5f });
 
+	// vertices sent to the vertex buffer since begin
+	size_t getDrawnVertexCount() const { return drawn_vertices; }
+
 private:
 	void drawBatch();
 	void updateVertexBuffer();
@@ -77,6 +80,7 @@ private:
 
 	bool is_const = false;
 	size_t max_vbuf_size = 0;
+	size_t drawn_vertices = 0;
 	const gef::Texture *texture = nullptr;
 	float cur_z = 0.f;
 };
@@ -1,6 +1,7 @@
 #include "blend_tree.h"
 
 #include "anim_system_3d.h"
+#include "utils.h"
 
 // == BLEND TREE ====================================
 
@@ -11,14 +12,23 @@ void BlendTree::init(AnimSystem3D *anim_system) {
 }
 
 void BlendTree::cleanup() {
+	// the nodes are in the arena, which doesn't call their destructors
+	for (ITreeNode *node : all_nodes) {
+		node->~ITreeNode();
+	}
 	arena.cleanup();
 	exit_node = nullptr;
 	mesh = nullptr;
 	value_map.clear();
 	all_nodes.destroy();
+#ifdef BLEND_TREE_PROFILER
+	profiler.reset();
+#endif
 }
 
 void BlendTree::update(float delta_time) {
+	root_motion = RootMotion();
+
 	if (!exit_node) {
 		return;
 	}
@@ -37,8 +47,15 @@ void BlendTree::update(float delta_time) {
 	//setValue("blend", alpha);
 	//setValue("blend2", alpha);
 
+	PROFILE_TREE_BEGIN(*this);
 	exit_node->update(delta_time);
-	mesh->UpdateBoneMatrices(exit_node->output);
+	PROFILE_TREE_END(*this);
+
+	root_motion = exit_node->root_motion;
+}
+
+const gef::SkeletonPose *BlendTree::getPose() const {
+	return exit_node ? &exit_node->output : nullptr;
 }
 
 void BlendTree::read(FILE *fp) {
@@ -56,7 +73,7 @@ void BlendTree::read(FILE *fp) {
 
 	struct ToAdd {
 		uint8_t a, b, c;
-		bool is_tree = false;
+		uint8_t count = 2;
 		ITreeNode *node;
 	};
 	gef::Vec<ToAdd> to_add;
@@ -107,7 +124,58 @@ void BlendTree::read(FILE *fp) {
 			fileRead(add.b, fp);
 			fileRead(add.c, fp);
 			add.node = node;
-			add.is_tree = true;
+			add.count = 3;
+			to_add.emplace_back(add);
+			new_node = node;
+			break;
+		}
+		case NodeType::LayerBlend:
+		{
+			LayerBlendNode *node = arena.make<LayerBlendNode>(*this);
+			ToAdd add{};
+			uint8_t root_len = 0;
+			char root_joint[sizeof(LayerBlendNode::root_joint)];
+			memset(root_joint, 0, sizeof(root_joint));
+			fileRead(node->blending_value, fp);
+			fileRead(add.a, fp);
+			fileRead(add.b, fp);
+			fileRead(root_len, fp);
+			fread(root_joint, 1, root_len, fp);
+			node->setRootJoint(root_joint);
+			add.node = node;
+			to_add.emplace_back(add);
+			new_node = node;
+			break;
+		}
+		case NodeType::Additive:
+		{
+			AdditiveNode *node = arena.make<AdditiveNode>(*this);
+			ToAdd add{};
+			uint8_t clip_id = 0;
+			fileRead(clip_id, fp);
+			fileRead(node->blending_value, fp);
+			fileRead(add.a, fp);
+			node->clip = system->getAnimation((int)clip_id);
+			add.node = node;
+			add.count = 1;
+			to_add.emplace_back(add);
+			new_node = node;
+			break;
+		}
+		case NodeType::IK:
+		{
+			IKNode *node = arena.make<IKNode>(*this);
+			ToAdd add{};
+			fileRead(node->rig.weight, fp);
+			fileRead(add.a, fp);
+			// the rig got its joint limits with version 8 of the 3d system
+			if (!node->rig.read(fp, system->getFileVersion() >= 8 ? IKRig::format_ver : 1)) {
+				err("couldn't read the rig of an ik node");
+			}
+			node->buildRig();
+			node->pushTargets();
+			add.node = node;
+			add.count = 1;
 			to_add.emplace_back(add);
 			new_node = node;
 			break;
@@ -120,8 +188,10 @@ void BlendTree::read(FILE *fp) {
 	// we need to do this later as the node might not have been loaded yet
 	for (ToAdd &add : to_add) {
 		add.node->input_nodes.emplace_back(all_nodes[add.a]);
-		add.node->input_nodes.emplace_back(all_nodes[add.b]);
-		if (add.is_tree) {
+		if (add.count > 1) {
+			add.node->input_nodes.emplace_back(all_nodes[add.b]);
+		}
+		if (add.count > 2) {
 			add.node->input_nodes.emplace_back(all_nodes[add.c]);
 		}
 	}
@@ -194,6 +264,41 @@ void BlendTree::save(FILE *fp) const {
 			fileWrite((uint8_t)left, fp);
 			break;
 		}
+		case NodeType::LayerBlend:
+		{
+			LayerBlendNode *node = (LayerBlendNode *)base_node;
+			size_t base = all_nodes.find(node->input_nodes[0]);
+			size_t layer = all_nodes.find(node->input_nodes[1]);
+			assert(base != SIZE_MAX && layer != SIZE_MAX);
+			fileWrite(node->blending_value, fp);
+			fileWrite((uint8_t)base, fp);
+			fileWrite((uint8_t)layer, fp);
+			uint8_t root_len = (uint8_t)strlen(node->root_joint);
+			fileWrite(root_len, fp);
+			fwrite(node->root_joint, 1, root_len, fp);
+			break;
+		}
+		case NodeType::Additive:
+		{
+			AdditiveNode *node = (AdditiveNode *)base_node;
+			int clip_id = system->getAnimationId(node->clip);
+			size_t base = all_nodes.find(node->input_nodes[0]);
+			assert(clip_id != INVALID_ID && base != SIZE_MAX);
+			fileWrite((uint8_t)clip_id, fp);
+			fileWrite(node->blending_value, fp);
+			fileWrite((uint8_t)base, fp);
+			break;
+		}
+		case NodeType::IK:
+		{
+			IKNode *node = (IKNode *)base_node;
+			size_t base = all_nodes.find(node->input_nodes[0]);
+			assert(base != SIZE_MAX);
+			fileWrite(node->rig.weight, fp);
+			fileWrite((uint8_t)base, fp);
+			node->rig.save(fp);
+			break;
+		}
 		}
 	}
 
@@ -213,7 +318,7 @@ void BlendTree::save(FILE *fp) const {
 }
 
 bool BlendTree::bindValue(const std::string &name, ITreeNode *node) {
-	auto &it = value_map.find(name);
+	auto it = value_map.find(name);
 	if (it == value_map.end()) {
 		if (float *value = node->getInputValue()) {
 			value_map[name] = value;
@@ -230,7 +335,7 @@ bool BlendTree::bindValue(const std::string &name, ITreeNode *node) {
 }
 
 bool BlendTree::setValue(const std::string &name, float value) {
-	auto &it = value_map.find(name);
+	auto it = value_map.find(name);
 	if (it != value_map.end()) {
 		if (it->second) {
 			*it->second = value;
@@ -241,13 +346,66 @@ bool BlendTree::setValue(const std::string &name, float value) {
 }
 
 float BlendTree::getValue(const std::string &name) {
-	auto &it = value_map.find(name);
+	auto it = value_map.find(name);
 	if (it != value_map.end() && it->second) {
 		return *it->second;
 	}
 	return 0.f;
 }
 
+void BlendTree::setTarget(const std::string &name, const gef::Vector4 &target) {
+	target_map[name] = target;
+}
+
+void BlendTree::clearTarget(const std::string &name) {
+	target_map.erase(name);
+}
+
+const gef::Vector4 *BlendTree::getTarget(const std::string &name) const {
+	auto it = target_map.find(name);
+	return it == target_map.end() ? nullptr : &it->second;
+}
+
+// == JOINT MASK ====================================
+
+void JointMask::build(const gef::Skeleton &skeleton, Int32 root_joint) {
+	clear();
+
+	const auto &skeleton_joints = skeleton.joints();
+	if (root_joint < 0 || root_joint >= (Int32)skeleton_joints.size()) {
+		return;
+	}
+
+	// parents always come before their children in the skeleton, so we only
+	// need to check if the parent was already added to know if a joint is in the subtree
+	gef::Vec<bool> in_mask;
+	in_mask.resize(skeleton_joints.size(), false);
+
+	for (Int32 i = root_joint; i < (Int32)skeleton_joints.size(); ++i) {
+		Int32 parent = skeleton_joints[i].parent;
+		if (i == root_joint || (parent >= 0 && in_mask[parent])) {
+			in_mask[i] = true;
+			joints.emplace_back(i);
+		}
+	}
+}
+
+void JointMask::intersect(const JointMask &a, const JointMask &b) {
+	clear();
+
+	// both are sorted, so it's a single pass over them
+	size_t i = 0, j = 0;
+	while (i < a.joints.size() && j < b.joints.size()) {
+		if      (a.joints[i] < b.joints[j]) i++;
+		else if (b.joints[j] < a.joints[i]) j++;
+		else {
+			joints.emplace_back(a.joints[i]);
+			i++;
+			j++;
+		}
+	}
+}
+
 // == TREE NODE =====================================
 
 ITreeNode::ITreeNode(BlendTree &tree)
@@ -259,6 +417,31 @@ ITreeNode::ITreeNode(BlendTree &tree)
 	input_nodes.setAllocator(&tree.arena);
 }
 
+void ITreeNode::setMask(const JointMask *new_mask) {
+	mask = new_mask;
+	for (ITreeNode *node : input_nodes) {
+		node->setMask(new_mask);
+	}
+}
+
+void ITreeNode::blendPoses(const gef::SkeletonPose &start, const gef::SkeletonPose &end, float alpha) {
+	if (mask) {
+		output.Linear2PoseBlend(start, end, alpha, mask->joints.data(), mask->joints.size());
+	}
+	else {
+		output.Linear2PoseBlend(start, end, alpha);
+	}
+}
+
+// fires the events that <playback> crossed in its last update
+static void emitEvents(BlendTree &tree, const Animation3D *clip, ClipPlayback &playback) {
+	if (clip->events.empty()) {
+		return;
+	}
+	int16_t clip_id = (int16_t)tree.system->getAnimationId(clip);
+	clip->events.emit(playback, tree.system->getEvents(), clip_id);
+}
+
 // == CLIP NODE =====================================
 
 ClipNode::ClipNode(BlendTree &tree)
@@ -275,11 +458,20 @@ void ClipNode::update(float delta_time) {
 	// clip node should not have any input
 	assert(input_nodes.empty());
 
-	clip->update(delta_time, output, tree.mesh->bind_pose());
+	PROFILE_TREE_NODE(this);
+	PROFILE_TREE_SAMPLES(this, mask ? mask->joints.size() : output.local_pose().size());
+
+	clip->advance(playback, delta_time);
+	emitEvents(tree, clip, playback);
+	root_motion = clip->clip->root_motion.extract(playback);
+	clip->sample(
+		playback.time, tree.mesh->bind_pose(), output,
+		mask ? mask->joints.data() : nullptr, mask ? mask->joints.size() : 0
+	);
 }
 
 float *ClipNode::getInputValue() {
-	return clip ? &clip->timer : nullptr;
+	return clip ? &playback.time : nullptr;
 }
 
 // == SYNCED CLIP NODE ==============================
@@ -297,10 +489,19 @@ void SyncedClipNode::update(float delta_time) {
 	// synced clip node should not have any input
 	assert(input_nodes.empty());
 
-	float norm = leader_clip->timer / leader_clip->duration;
-	clip->timer = clip->duration * norm;
+	PROFILE_TREE_NODE(this);
+	PROFILE_TREE_SAMPLES(this, mask ? mask->joints.size() : output.local_pose().size());
 
-	clip->updatePose(output, tree.mesh->bind_pose());
+	// follow the leader's normalized time without touching the leader itself
+	leader_clip->advance(leader_playback, delta_time);
+	playback.setTime(clip->clip->duration * leader_clip->getNormalizedTime(leader_playback), leader_playback.wrapped);
+	emitEvents(tree, clip, playback);
+	root_motion = clip->clip->root_motion.extract(playback);
+
+	clip->sample(
+		playback.time, tree.mesh->bind_pose(), output,
+		mask ? mask->joints.data() : nullptr, mask ? mask->joints.size() : 0
+	);
 }
 
 // == BLEND NODE ====================================
@@ -316,15 +517,15 @@ void BlendNode::update(float delta_time) {
 		return;
 	}
 
+	PROFILE_TREE_NODE(this);
+
 	for (ITreeNode *node : input_nodes) {
 		node->update(delta_time);
 	}
 
-	output.Linear2PoseBlend(
-		input_nodes[0]->output,
-		input_nodes[1]->output,
-		blending_value
-	);
+	PROFILE_TREE_BLENDS(this, 1);
+	blendPoses(input_nodes[0]->output, input_nodes[1]->output, blending_value);
+	root_motion = RootMotion::lerp(input_nodes[0]->root_motion, input_nodes[1]->root_motion, blending_value);
 }
 
 // == BLEND 1D NODE =================================
@@ -340,25 +541,205 @@ void BlendNode1D::update(float delta_time) {
 		return;
 	}
 
+	PROFILE_TREE_NODE(this);
+
 	for (ITreeNode *node : input_nodes) {
 		node->update(delta_time);
 	}
 
+	if (blending_value != 0) {
+		PROFILE_TREE_BLENDS(this, 1);
+	}
+
 	if (blending_value > 0) {
-		output.Linear2PoseBlend(
-			input_nodes[1]->output,
-			input_nodes[2]->output,
-			blending_value
-		);
+		blendPoses(input_nodes[1]->output, input_nodes[2]->output, blending_value);
+		root_motion = RootMotion::lerp(input_nodes[1]->root_motion, input_nodes[2]->root_motion, blending_value);
 	}
 	else if (blending_value < 0) {
+		blendPoses(input_nodes[1]->output, input_nodes[0]->output, fabsf(blending_value));
+		root_motion = RootMotion::lerp(input_nodes[1]->root_motion, input_nodes[0]->root_motion, fabsf(blending_value));
+	}
+	else {
+		output = input_nodes[1]->output;
+		root_motion = input_nodes[1]->root_motion;
+	}
+}
+
+// == LAYER BLEND NODE ==============================
+
+LayerBlendNode::LayerBlendNode(BlendTree &tree)
+	: ITreeNode(tree)
+{
+	node_type = NodeType::LayerBlend;
+	layer_mask.joints.setAllocator(&tree.arena);
+	masked_layer.joints.setAllocator(&tree.arena);
+}
+
+void LayerBlendNode::update(float delta_time) {
+	if (input_nodes.size() != 2) {
+		return;
+	}
+
+	PROFILE_TREE_NODE(this);
+
+	ITreeNode *base = input_nodes[0];
+	ITreeNode *layer = input_nodes[1];
+
+	// the base only needs what we need, the layer only needs the masked joints we need
+	const JointMask *layer_input = getLayerMask();
+	base->setMask(mask);
+	layer->setMask(layer_input);
+
+	base->update(delta_time);
+	layer->update(delta_time);
+
+	output.local_pose() = base->output.local_pose();
+	// the layer is only a part of the body, the base decides where the character goes
+	root_motion = base->root_motion;
+
+	if (!layer_input->empty() && blending_value > 0.f) {
+		PROFILE_TREE_BLENDS(this, 1);
 		output.Linear2PoseBlend(
-			input_nodes[1]->output,
-			input_nodes[0]->output,
-			fabsf(blending_value)
+			base->output, layer->output, gef::clamp(blending_value, 0.f, 1.f),
+			layer_input->joints.data(), layer_input->joints.size()
 		);
 	}
+
+	// if someone above us is masked they'll calculate the global pose
+	if (!mask) {
+		output.CalculateGlobalPose();
+	}
+}
+
+void LayerBlendNode::setMask(const JointMask *new_mask) {
+	// the inputs are masked in update, as the layer uses a different mask.
+	// this is called every frame, the intersection is only made again when a mask changed
+	bool changed = new_mask != mask || (new_mask && new_mask->version != masked_version);
+	mask = new_mask;
+	if (changed) {
+		updateMaskedLayer();
+	}
+}
+
+void LayerBlendNode::updateMaskedLayer() {
+	if (mask) {
+		masked_layer.intersect(*mask, layer_mask);
+		masked_version = mask->version;
+	}
 	else {
-		output = input_nodes[1]->output;
+		masked_layer.clear();
+	}
+}
+
+bool LayerBlendNode::setRootJoint(const char *joint_name) {
+	strCopyInto(root_joint, joint_name);
+	layer_mask.clear();
+
+	int joint_id = tree.system->getJointId(root_joint);
+	if (joint_id != INVALID_ID) {
+		layer_mask.build(*tree.mesh->bind_pose().skeleton(), joint_id);
+	}
+	updateMaskedLayer();
+
+	if (joint_id == INVALID_ID) {
+		warn("couldn't find joint %s for the layer blend mask", root_joint);
+		return false;
+	}
+	return true;
+}
+
+// == ADDITIVE NODE =================================
+
+AdditiveNode::AdditiveNode(BlendTree &tree)
+	: ITreeNode(tree)
+{
+	node_type = NodeType::Additive;
+}
+
+void AdditiveNode::update(float delta_time) {
+	if (input_nodes.size() != 1) {
+		return;
+	}
+
+	PROFILE_TREE_NODE(this);
+
+	ITreeNode *base = input_nodes[0];
+	base->update(delta_time);
+
+	output.local_pose() = base->output.local_pose();
+	// additive clips never have root motion
+	root_motion = base->root_motion;
+
+	if (clip) {
+		clip->advance(playback, delta_time);
+		emitEvents(tree, clip, playback);
+		if (blending_value > 0.f) {
+			PROFILE_TREE_SAMPLES(this, clip->clip->additive_tracks.size());
+			PROFILE_TREE_BLENDS(this, 1);
+			applyAdditive(*clip->clip, playback.time, gef::clamp(blending_value, 0.f, 1.f), output);
+		}
+	}
+
+	// if someone above us is masked they'll calculate the global pose
+	if (!mask) {
+		output.CalculateGlobalPose();
+	}
+}
+
+// == IK NODE =======================================
+
+IKNode::IKNode(BlendTree &tree)
+	: ITreeNode(tree)
+{
+	node_type = NodeType::IK;
+}
+
+void IKNode::update(float delta_time) {
+	if (input_nodes.size() != 1) {
+		return;
+	}
+
+	PROFILE_TREE_NODE(this);
+
+	ITreeNode *base = input_nodes[0];
+	base->update(delta_time);
+
+	output = base->output;
+	root_motion = base->root_motion;
+
+	for (int i = 0; i < rig.getChainCount(); ++i) {
+		IKRigChain &chain = rig.getChain(i);
+		if (const gef::Vector4 *target = tree.getTarget(chain.name)) {
+			rig.setTarget(i, *target);
+		}
+		else {
+			chain.has_target = false;
+		}
+	}
+
+	// the chains only update the global pose of their subtree
+	double start = timeNowUs();
+	rig.solve(output, max_iterations, epsilon, jobs);
+	last_solve_us = (float)(timeNowUs() - start);
+}
+
+void IKNode::setMask(const JointMask *new_mask) {
+	// the chains need the global pose of the input, which is only there without a mask
+	mask = new_mask;
+	for (ITreeNode *node : input_nodes) {
+		node->setMask(nullptr);
+	}
+}
+
+bool IKNode::buildRig() {
+	return rig.build(*tree.mesh->bind_pose().skeleton(), tree.system->getJointMap());
+}
+
+void IKNode::pushTargets() {
+	for (int i = 0; i < rig.getChainCount(); ++i) {
+		const IKRigChain &chain = rig.getChain(i);
+		if (chain.has_target) {
+			tree.setTarget(chain.name, chain.target);
+		}
 	}
 }
@@ -9,6 +9,9 @@
 #include <system/vec.h>
 
 #include "arena.h"
+#include "blend_tree_profiler.h"
+#include "clip_library.h"
+#include "ik_rig.h"
 
 namespace gef {
 	class SkinnedMeshInstance;
@@ -22,6 +25,8 @@ struct BlendTree {
 	void init(AnimSystem3D *anim_system);
 	void cleanup();
 	void update(float delta_time);
+	// output of the exit node after the last update, null if there is no exit node
+	const gef::SkeletonPose *getPose() const;
 
 	void read(FILE *fp);
 	void save(FILE *fp) const;
@@ -30,16 +35,43 @@ struct BlendTree {
 	bool setValue(const std::string &name, float value);
 	float getValue(const std::string &name);
 
+	// model space targets of the ik nodes, by the name of the chain they move.
+	// they aren't nodes, so they stay when the tree is cleaned up and built again
+	void setTarget(const std::string &name, const gef::Vector4 &target);
+	void clearTarget(const std::string &name);
+	const gef::Vector4 *getTarget(const std::string &name) const;
+
 	Arena arena;
 	AnimSystem3D *system = nullptr;
 	gef::SkinnedMeshInstance *mesh = nullptr;
 	ITreeNode *exit_node = nullptr;
 	gef::Vec<ITreeNode *> all_nodes = &arena;
+	// root motion of the exit node in the last update
+	RootMotion root_motion;
 	std::unordered_map<std::string, float *> value_map;
+	std::unordered_map<std::string, gef::Vector4> target_map;
+#ifdef BLEND_TREE_PROFILER
+	BlendTreeProfiler profiler;
+#endif
 };
 
 enum class NodeType : uint8_t {
-	Base, Clip, SyncClip, Blend, Blend1D, Count
+	Base, Clip, SyncClip, Blend, Blend1D, LayerBlend, Additive, IK, Count
+};
+
+// list of the joints that belong to the subtree starting at a root joint,
+// sorted so that parents always come before their children
+struct JointMask {
+	void build(const gef::Skeleton &skeleton, Int32 root_joint);
+	// the joints that are in both <a> and <b>
+	void intersect(const JointMask &a, const JointMask &b);
+	void clear() { joints.clear(); version++; }
+	bool empty() const { return joints.empty(); }
+
+	// sorted, parents before their children
+	gef::Vec<Int32> joints;
+	// changes every time the joints do, so a mask made from this one knows it's out of date
+	uint32_t version = 0;
 };
 
 struct ITreeNode {
@@ -47,11 +79,23 @@ struct ITreeNode {
 	virtual ~ITreeNode() {}
 	virtual void update(float delta_time) = 0;
 	virtual float *getInputValue() { return nullptr; }
+	// only the joints in <mask> need to be evaluated, nullptr means the full pose.
+	// by default it passes the mask down to all the inputs
+	virtual void setMask(const JointMask *new_mask);
+	// blends into <output> only the masked joints, if there is a mask
+	void blendPoses(const gef::SkeletonPose &start, const gef::SkeletonPose &end, float alpha);
 
 	BlendTree &tree;
+	const JointMask *mask = nullptr;
 	gef::SkeletonPose output;
+	// how much the clips moved the character in this update, blended like the pose
+	RootMotion root_motion;
 	gef::Vec<ITreeNode *> input_nodes;
 	NodeType node_type = NodeType::Base;
+#ifdef BLEND_TREE_PROFILER
+	// index in BlendTree::all_nodes, set by the profiler every frame
+	int profile_id = -1;
+#endif
 };
 
 // plays a clip
@@ -62,6 +106,8 @@ struct ClipNode : public ITreeNode {
 	virtual float *getInputValue();
 
 	Animation3D *clip = nullptr;
+	// every node has its own time, so the same clip can be used by more than one node
+	ClipPlayback playback;
 };
 
 // syncs to animation clips so "clip" runs for the same time as "leader_clip"
@@ -71,6 +117,8 @@ struct SyncedClipNode : public ClipNode {
 	virtual void update(float delta_time) override;
 
 	Animation3D *leader_clip = nullptr;
+	// the leader is only used for its normalized time, nothing is sampled from it
+	ClipPlayback leader_playback;
 };
 
 // linearly interpolates between two inputs based on a blending value, range (0, 1)
@@ -94,3 +142,63 @@ struct BlendNode1D : public ITreeNode {
 
 	float blending_value = 0.5f;
 };
+
+// overrides the joints under <root_joint> in the base input with the layer input
+// the layer is only sampled and blended for the masked joints
+// 2 inputs: base and layer
+struct LayerBlendNode : public ITreeNode {
+	LayerBlendNode(BlendTree &tree);
+	virtual void update(float delta_time) override;
+	virtual float *getInputValue() { return &blending_value; }
+	virtual void setMask(const JointMask *new_mask) override;
+
+	bool setRootJoint(const char *joint_name);
+
+	char root_joint[32] = { 0 };
+	JointMask layer_mask;
+	float blending_value = 1.f;
+
+private:
+	// the joints of the layer that are also in <mask>, a masked node above
+	// throws away the rest so the layer doesn't need to sample them
+	void updateMaskedLayer();
+	const JointMask *getLayerMask() const { return mask ? &masked_layer : &layer_mask; }
+
+	JointMask masked_layer;
+	uint32_t masked_version = 0;
+};
+
+// adds an additive clip on top of the input, scaled by a weight, range (0, 1)
+// only the joints that the clip actually moves are touched
+// 1 input
+struct AdditiveNode : public ITreeNode {
+	AdditiveNode(BlendTree &tree);
+	virtual void update(float delta_time) override;
+	virtual float *getInputValue() { return &blending_value; }
+
+	Animation3D *clip = nullptr;
+	ClipPlayback playback;
+	float blending_value = 1.f;
+};
+
+// solves the chains of <rig> on top of the input, each one against the target of the
+// tree with its name. only the subtree of each chain is updated, scaled by a weight, range (0, 1)
+// 1 input
+struct IKNode : public ITreeNode {
+	IKNode(BlendTree &tree);
+	virtual void update(float delta_time) override;
+	virtual float *getInputValue() { return &rig.weight; }
+	virtual void setMask(const JointMask *new_mask) override;
+
+	// finds the joints of the chains in the skeleton of the tree
+	bool buildRig();
+	// puts the targets saved with the rig in the tree
+	void pushTargets();
+
+	IKRig rig;
+	// when set, the independent chains are solved at the same time
+	gef::JobSystem *jobs = nullptr;
+	int max_iterations = 200;
+	float epsilon = 0.01f;
+	float last_solve_us = 0.f;
+};
\ No newline at end of file
@@ -0,0 +1,201 @@
+#include "blend_tree_profiler.h"
+
+#ifdef BLEND_TREE_PROFILER
+
+#include <string.h>
+
+#include "blend_tree.h"
+#include "utils.h"
+
+static const char *node_type_names[] = {
+	"Base", "Clip", "SyncClip", "Blend", "Blend1D", "LayerBlend", "Additive", "IK"
+};
+
+static_assert((sizeof(node_type_names) / sizeof(*node_type_names)) == (int)NodeType::Count);
+
+// == BLEND TREE PROFILER ===========================
+
+void BlendTreeProfiler::reset() {
+	history.destroy();
+	nodes.destroy();
+	node_types.destroy();
+	memset(frame_times, 0, sizeof(frame_times));
+	node_count = 0;
+	cur_frame = 0;
+	frames_recorded = 0;
+	stack_len = 0;
+}
+
+void BlendTreeProfiler::beginFrame(BlendTree &blend_tree) {
+	tree = &blend_tree;
+	if (paused) {
+		return;
+	}
+
+	// the tree was rebuilt, the old history doesn't mean anything anymore. a rebuild can
+	// end up with the same number of nodes, so they're compared one by one
+	bool rebuilt = node_count != (int)tree->all_nodes.size();
+	for (int i = 0; i < node_count && !rebuilt; ++i) {
+		rebuilt = nodes[i] != tree->all_nodes[i];
+	}
+
+	if (rebuilt) {
+		reset();
+		node_count = (int)tree->all_nodes.size();
+		history.resize(history_len * node_count);
+		nodes.resize(node_count);
+		node_types.resize(node_count);
+		for (int i = 0; i < node_count; ++i) {
+			ITreeNode *node = tree->all_nodes[i];
+			node->profile_id = i;
+			nodes[i] = node;
+			node_types[i] = (uint8_t)node->node_type;
+		}
+	}
+
+	NodeStats *stats = frameStats(cur_frame);
+	for (int i = 0; i < node_count; ++i) {
+		stats[i] = NodeStats();
+	}
+
+	stack_len = 0;
+	frame_start = timeNowUs();
+}
+
+void BlendTreeProfiler::endFrame() {
+	if (paused || !node_count) {
+		return;
+	}
+
+	assert(stack_len == 0);
+	frame_times[cur_frame] = (float)(timeNowUs() - frame_start);
+	cur_frame = (cur_frame + 1) % history_len;
+	if (frames_recorded < history_len) {
+		frames_recorded++;
+	}
+}
+
+void BlendTreeProfiler::beginNode(ITreeNode *node) {
+	if (paused || node->profile_id < 0 || node->profile_id >= node_count) {
+		return;
+	}
+
+	assert(stack_len < max_depth);
+	stack[stack_len++] = { node->profile_id, timeNowUs(), 0.0 };
+}
+
+void BlendTreeProfiler::endNode(ITreeNode *node) {
+	if (paused || node->profile_id < 0 || node->profile_id >= node_count) {
+		return;
+	}
+
+	assert(stack_len > 0 && stack[stack_len - 1].node_id == node->profile_id);
+	Scope &scope = stack[--stack_len];
+	double total = timeNowUs() - scope.start;
+
+	NodeStats &stats = frameStats(cur_frame)[scope.node_id];
+	stats.total_us += (float)total;
+	stats.self_us += (float)(total - scope.children_us);
+
+	// let the parent know how much of its time was actually spent in us
+	if (stack_len > 0) {
+		stack[stack_len - 1].children_us += total;
+	}
+}
+
+void BlendTreeProfiler::addSamples(ITreeNode *node, uint32_t count) {
+	if (paused || node->profile_id < 0 || node->profile_id >= node_count) {
+		return;
+	}
+	frameStats(cur_frame)[node->profile_id].samples += count;
+}
+
+void BlendTreeProfiler::addBlends(ITreeNode *node, uint32_t count) {
+	if (paused || node->profile_id < 0 || node->profile_id >= node_count) {
+		return;
+	}
+	frameStats(cur_frame)[node->profile_id].blends += count;
+}
+
+const NodeStats *BlendTreeProfiler::getStats(int node_id, int frames_ago) const {
+	if (node_id < 0 || node_id >= node_count || frames_ago >= frames_recorded) {
+		return nullptr;
+	}
+	int frame = (cur_frame - 1 - frames_ago + history_len * 2) % history_len;
+	return &history[frame * node_count + node_id];
+}
+
+NodeStats BlendTreeProfiler::getAverage(int node_id) const {
+	NodeStats out;
+	if (!frames_recorded) {
+		return out;
+	}
+
+	for (int i = 0; i < frames_recorded; ++i) {
+		const NodeStats *stats = getStats(node_id, i);
+		if (!stats) break;
+		out.self_us += stats->self_us;
+		out.total_us += stats->total_us;
+		out.samples += stats->samples;
+		out.blends += stats->blends;
+	}
+
+	float count = (float)frames_recorded;
+	out.self_us /= count;
+	out.total_us /= count;
+	out.samples = (uint32_t)((float)out.samples / count);
+	out.blends = (uint32_t)((float)out.blends / count);
+	return out;
+}
+
+float BlendTreeProfiler::getFrameTime(int frames_ago) const {
+	if (frames_ago >= frames_recorded) {
+		return 0.f;
+	}
+	return frame_times[(cur_frame - 1 - frames_ago + history_len * 2) % history_len];
+}
+
+bool BlendTreeProfiler::exportCsv(const char *filename) const {
+	CFile fp(filename, "wb");
+	if (!fp) {
+		err("couldn't open %s to export the blend tree profile", filename);
+		return false;
+	}
+
+	fprintf(fp, "frame,node,type,self_us,total_us,samples,blends\n");
+
+	// oldest frame first
+	for (int frame = frames_recorded - 1; frame >= 0; --frame) {
+		int frame_id = frames_recorded - 1 - frame;
+		for (int node = 0; node < node_count; ++node) {
+			const NodeStats *stats = getStats(node, frame);
+			fprintf(
+				fp, "%d,%d,%s,%.3f,%.3f,%u,%u\n",
+				frame_id, node, node_type_names[node_types[node]],
+				stats->self_us, stats->total_us,
+				stats->samples, stats->blends
+			);
+		}
+	}
+
+	info("exported %d frames of blend tree profile to %s", frames_recorded, filename);
+	return true;
+}
+
+NodeStats *BlendTreeProfiler::frameStats(int frame) {
+	return history.data() + frame * node_count;
+}
+
+// == PROFILE SCOPE =================================
+
+ProfileNodeScope::ProfileNodeScope(ITreeNode *node)
+	: node(node)
+{
+	node->tree.profiler.beginNode(node);
+}
+
+ProfileNodeScope::~ProfileNodeScope() {
+	node->tree.profiler.endNode(node);
+}
+
+#endif
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <system/vec.h>
+
+// the profiler only exists in debug builds, in release every macro
+// expands to nothing and the BlendTree doesn't even have the member
+#ifndef NDEBUG
+#define BLEND_TREE_PROFILER
+#endif
+
+struct BlendTree;
+struct ITreeNode;
+
+#ifdef BLEND_TREE_PROFILER
+
+// what a single node did in a single frame
+struct NodeStats {
+	float self_us = 0.f;  // time spent in the node, without its inputs
+	float total_us = 0.f; // time spent in the node, including its inputs
+	uint32_t samples = 0; // joint tracks sampled from a clip
+	uint32_t blends = 0;  // poses blended together
+};
+
+// records per-node stats for the last <history_len> frames in a ring buffer.
+// the nodes are identified by their index in BlendTree::all_nodes, the history
+// starts again whenever a different node is at any index
+struct BlendTreeProfiler {
+	static constexpr int history_len = 120;
+	static constexpr int max_depth = 32;
+
+	void reset();
+
+	void beginFrame(BlendTree &tree);
+	void endFrame();
+
+	void beginNode(ITreeNode *node);
+	void endNode(ITreeNode *node);
+	void addSamples(ITreeNode *node, uint32_t count);
+	void addBlends(ITreeNode *node, uint32_t count);
+
+	// <frames_ago> = 0 is the last finished frame
+	const NodeStats *getStats(int node_id, int frames_ago = 0) const;
+	// average over all the recorded history
+	NodeStats getAverage(int node_id) const;
+	// how long the whole tree took to update
+	float getFrameTime(int frames_ago = 0) const;
+	int getFrameCount() const { return frames_recorded; }
+	int getNodeCount() const { return node_count; }
+	// index of the oldest frame in <frame_times>, useful for ImGui::PlotLines
+	int getHistoryOffset() const { return frames_recorded < history_len ? 0 : cur_frame; }
+	const float *getFrameTimes() const { return frame_times; }
+
+	bool exportCsv(const char *filename) const;
+
+	bool paused = false;
+
+private:
+	NodeStats *frameStats(int frame);
+
+	struct Scope {
+		int node_id;
+		double start;
+		double children_us;
+	};
+
+	BlendTree *tree = nullptr;
+	gef::Vec<NodeStats> history;
+	gef::Vec<const ITreeNode *> nodes;
+	gef::Vec<uint8_t> node_types;
+	float frame_times[history_len] = { 0 };
+	double frame_start = 0.0;
+	int node_count = 0;
+	int cur_frame = 0;
+	int frames_recorded = 0;
+
+	Scope stack[max_depth];
+	int stack_len = 0;
+};
+
+struct ProfileNodeScope {
+	ProfileNodeScope(ITreeNode *node);
+	~ProfileNodeScope();
+	ITreeNode *node;
+};
+
+#define PROFILE_TREE_NODE(node)          ProfileNodeScope profile_scope_(node)
+#define PROFILE_TREE_SAMPLES(node, count) (node)->tree.profiler.addSamples(node, (uint32_t)(count))
+#define PROFILE_TREE_BLENDS(node, count)  (node)->tree.profiler.addBlends(node, (uint32_t)(count))
+#define PROFILE_TREE_BEGIN(tree)         (tree).profiler.beginFrame(tree)
+#define PROFILE_TREE_END(tree)           (tree).profiler.endFrame()
+
+#else
+
+#define PROFILE_TREE_NODE(node)
+#define PROFILE_TREE_SAMPLES(node, count)
+#define PROFILE_TREE_BLENDS(node, count)
+#define PROFILE_TREE_BEGIN(tree)
+#define PROFILE_TREE_END(tree)
+
+#endif
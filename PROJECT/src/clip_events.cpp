@@ -0,0 +1,116 @@
+#include "clip_events.h"
+
+#include "clip_library.h"
+
+static const char *event_type_names[] = {
+	"Footstep", "Sound", "Vfx"
+};
+
+static_assert((sizeof(event_type_names) / sizeof(*event_type_names)) == (int)ClipEventType::Count);
+
+const char *getEventTypeName(ClipEventType type) {
+	return (uint8_t)type < (uint8_t)ClipEventType::Count ? event_type_names[(uint8_t)type] : "Unknown";
+}
+
+// == EVENT QUEUE ===================================
+
+void EventQueue::push(const ClipEvent &event, int16_t clip_id) {
+	if (size() == capacity) {
+		head++;
+		dropped++;
+	}
+
+	FiredEvent &fired = events[tail++ % capacity];
+	fired.event = event;
+	fired.clip_id = clip_id;
+}
+
+bool EventQueue::pop(FiredEvent &out) {
+	if (empty()) {
+		return false;
+	}
+	out = events[head++ % capacity];
+	return true;
+}
+
+void EventQueue::clear() {
+	head = tail = 0;
+	dropped = 0;
+}
+
+// == EVENT TRACK ===================================
+
+void EventTrack::add(const ClipEvent &event) {
+	events.push_back(event);
+	sort();
+}
+
+void EventTrack::remove(size_t index) {
+	events.erase(index);
+}
+
+void EventTrack::sort() {
+	// insertion sort, there's only ever a handful of events and they're almost always sorted
+	for (size_t i = 1; i < events.size(); ++i) {
+		ClipEvent event = events[i];
+		size_t j = i;
+		while (j > 0 && events[j - 1].time > event.time) {
+			events[j] = events[j - 1];
+			j--;
+		}
+		events[j] = event;
+	}
+}
+
+size_t EventTrack::lowerBound(float time) const {
+	size_t first = 0;
+	size_t count = events.size();
+
+	while (count > 0) {
+		size_t step = count / 2;
+		size_t mid = first + step;
+		if (events[mid].time < time) {
+			first = mid + 1;
+			count -= step + 1;
+		}
+		else {
+			count = step;
+		}
+	}
+
+	return first;
+}
+
+void EventTrack::emit(ClipPlayback &playback, EventQueue &queue, int16_t clip_id) const {
+	size_t count = events.size();
+	if (!count) {
+		return;
+	}
+
+	// events in [prev_time, time) are fired, the cursor should be the first event
+	// at or after prev_time. if it isn't someone moved the time, find it again
+	size_t cursor = playback.event_cursor;
+	float from = playback.prev_time;
+	bool is_valid =
+		cursor <= count &&
+		(cursor == 0 || events[cursor - 1].time < from) &&
+		(cursor == count || events[cursor].time >= from);
+
+	if (!is_valid) {
+		cursor = lowerBound(from);
+	}
+
+	if (playback.wrapped) {
+		// everything until the end of the clip, then start again from the beginning
+		for (; cursor < count; ++cursor) {
+			queue.push(events[cursor], clip_id);
+		}
+		cursor = 0;
+	}
+
+	for (; cursor < count && events[cursor].time < playback.time; ++cursor) {
+		queue.push(events[cursor], clip_id);
+	}
+
+	playback.event_cursor = (uint32_t)cursor;
+}
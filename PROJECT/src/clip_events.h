@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <system/vec.h>
+
+struct ClipPlayback;
+
+enum class ClipEventType : uint8_t {
+	Footstep,
+	Sound,
+	Vfx,
+	Count
+};
+
+const char *getEventTypeName(ClipEventType type);
+
+struct ClipEvent {
+	float time = 0.f; // seconds from the start of the clip
+	ClipEventType type = ClipEventType::Footstep;
+	char name[19] = { 0 }; // which foot, sound or effect
+};
+
+// event that was crossed by a clip during an update
+struct FiredEvent {
+	ClipEvent event;
+	int16_t clip_id = -1;
+};
+
+// events sent by the animation systems during the frame, gameplay code drains them.
+// it's a fixed size ring, if nobody drains it the oldest events are overwritten
+class EventQueue {
+public:
+	static constexpr uint32_t capacity = 128;
+
+	void push(const ClipEvent &event, int16_t clip_id);
+	// returns false once there are no more events
+	bool pop(FiredEvent &out);
+	void clear();
+
+	uint32_t size() const { return tail - head; }
+	bool empty() const { return head == tail; }
+	// number of events that were overwritten before being drained
+	uint32_t getDropped() const { return dropped; }
+
+private:
+	FiredEvent events[capacity];
+	uint32_t head = 0;
+	uint32_t tail = 0;
+	uint32_t dropped = 0;
+};
+
+// events of a clip, always sorted by time
+struct EventTrack {
+	void add(const ClipEvent &event);
+	void remove(size_t index);
+	// call it after changing the time of an event
+	void sort();
+
+	// index of the first event at or after <time>
+	size_t lowerBound(float time) const;
+
+	// pushes every event crossed by the last update of <playback> to <queue>. the cursor in
+	// <playback> is used so that it's usually just a compare, it's only searched for again
+	// when the time jumped around
+	void emit(ClipPlayback &playback, EventQueue &queue, int16_t clip_id) const;
+
+	bool empty() const { return events.empty(); }
+	size_t size() const { return events.size(); }
+
+	gef::Vec<ClipEvent> events;
+};
@@ -0,0 +1,531 @@
+#include "clip_library.h"
+
+#include <string.h>
+
+#include <external/ImGui/imgui.h>
+
+#include "utils.h"
+
+// deltas smaller than this are considered zero when converting additive clips
+static constexpr float additive_rot_epsilon = 1e-6f; // 1 - w, roughly 0.16 degrees
+static constexpr float additive_pos_epsilon = 1e-4f;
+
+// converts every track to a delta against the reference pose and strips the ones that are constant zero
+static void makeAdditive(Clip &clip, AdditiveMode mode, const gef::SkeletonPose &bind_pose) {
+	clip.additive = mode;
+	clip.additive_tracks.clear();
+
+	if (mode == AdditiveMode::None) {
+		return;
+	}
+
+	const gef::Skeleton *skeleton = bind_pose.skeleton();
+	assert(skeleton);
+	size_t stripped = 0;
+
+	for (auto &[name_id, anim_node] : clip.anim_data.anim_nodes()) {
+		if (anim_node->type() != gef::AnimNode::kTransform) {
+			continue;
+		}
+
+		Int32 joint = skeleton->FindJointIndex(name_id);
+		if (joint < 0) {
+			continue;
+		}
+
+		gef::TransformAnimNode *node = (gef::TransformAnimNode *)anim_node.get();
+		const gef::JointPose &bind_joint = bind_pose.local_pose()[joint];
+		auto &rotation_keys = node->rotation_keys();
+		auto &translation_keys = node->translation_keys();
+
+		// scale is always ignored when sampling
+		node->scale_keys().clear();
+
+		if (!rotation_keys.empty()) {
+			const gef::Quaternion &reference = mode == AdditiveMode::FirstFrame ? rotation_keys[0].value : bind_joint.rotation();
+			gef::Quaternion inv_reference;
+			inv_reference.Conjugate(reference);
+
+			bool is_zero = true;
+			for (gef::QuaternionKey &key : rotation_keys) {
+				// gef's a * b rotates by a first, so this is delta = key then inverse(reference),
+				// which means that delta * reference gives back the original key
+				key.value = key.value * inv_reference;
+				if (key.value.w < 0.f) {
+					key.value = -key.value;
+				}
+				if (key.value.w < (1.f - additive_rot_epsilon)) {
+					is_zero = false;
+				}
+			}
+
+			if (is_zero) {
+				rotation_keys.clear();
+			}
+		}
+
+		if (!translation_keys.empty()) {
+			gef::Vector4 reference = mode == AdditiveMode::FirstFrame ? translation_keys[0].value : bind_joint.translation();
+
+			bool is_zero = true;
+			for (gef::Vector3Key &key : translation_keys) {
+				key.value -= reference;
+				if (key.value.LengthSqr() > (additive_pos_epsilon * additive_pos_epsilon)) {
+					is_zero = false;
+				}
+			}
+
+			if (is_zero) {
+				translation_keys.clear();
+			}
+		}
+
+		if (!rotation_keys.empty() || !translation_keys.empty()) {
+			clip.additive_tracks.push_back({ joint, node });
+		}
+		else {
+			stripped++;
+		}
+	}
+
+	info("converted %s to additive: %zu tracks kept, %zu stripped", clip.path.c_str(), clip.additive_tracks.size(), stripped);
+}
+
+// moves the ground plane movement of the root joint out of its track and into the root motion curve
+static void extractRootMotion(Clip &clip, const gef::Skeleton &skeleton) {
+	if (skeleton.joints().empty()) {
+		return;
+	}
+
+	// the root joint is always the first one
+	gef::StringId root_name = skeleton.joints()[0].name_id;
+	auto it = clip.anim_data.anim_nodes().find(root_name);
+	if (it == clip.anim_data.anim_nodes().end() || it->second->type() != gef::AnimNode::kTransform) {
+		warn("%s has no root track, it won't have root motion", clip.path.c_str());
+		return;
+	}
+
+	gef::TransformAnimNode *root_track = (gef::TransformAnimNode *)it->second.get();
+	clip.root_motion.bake(*root_track, clip.anim_data.start_time(), clip.duration);
+	clip.has_root_motion = true;
+
+	info("baked root motion of %s: %zu keys", clip.path.c_str(), clip.root_motion.keys.size());
+}
+
+uint32_t hashSkeleton(const gef::Skeleton &skeleton) {
+	uint32_t hash = 2166136261u;
+	for (const gef::Joint &joint : skeleton.joints()) {
+		hash ^= joint.name_id;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// == CLIP ==========================================
+
+const ClipBinding *Clip::bind(const gef::Skeleton &skeleton, const RetargetMap *retarget) {
+	if (retarget && retarget->empty()) {
+		retarget = nullptr;
+	}
+
+	uint32_t hash = retarget ? retarget->getHash() : hashSkeleton(skeleton);
+	// the clip is shared, another system could be binding it at the same time
+	std::lock_guard<std::mutex> lock(bind_mtx);
+	for (const gef::ptr<ClipBinding> &binding : bindings) {
+		if (binding->skeleton_hash == hash) {
+			return binding.get();
+		}
+	}
+
+	gef::ptr<ClipBinding> binding = gef::ptr<ClipBinding>::make();
+	binding->skeleton_hash = hash;
+
+	const auto &joints = skeleton.joints();
+	binding->joint_tracks.resize(joints.size(), nullptr);
+	for (size_t i = 0; i < joints.size(); ++i) {
+		gef::StringId name_id = joints[i].name_id;
+		if (retarget) {
+			const RetargetJoint &joint = retarget->getJoint((Int32)i);
+			if (joint.source < 0) {
+				binding->joint_tracks[i] = nullptr;
+				continue;
+			}
+			name_id = joint.source_name;
+		}
+
+		const gef::AnimNode *anim_node = anim_data.FindNode(name_id);
+		if (anim_node && anim_node->type() == gef::AnimNode::kTransform) {
+			binding->joint_tracks[i] = (const gef::TransformAnimNode *)anim_node;
+		}
+		else {
+			binding->joint_tracks[i] = nullptr;
+		}
+	}
+
+	if (retarget) {
+		binding->corrections.reserve(joints.size());
+		for (size_t i = 0; i < joints.size(); ++i) {
+			binding->corrections.push_back(retarget->getJoint((Int32)i));
+		}
+		binding->root_joint = retarget->root_joint;
+		binding->root_scale = retarget->root_scale;
+	}
+
+	bindings.emplace_back(std::move(binding));
+	return bindings.back().get();
+}
+
+size_t Clip::getMemoryUsage() const {
+	size_t bytes = sizeof(Clip) + path.capacity() + clip_name.capacity();
+
+	for (const auto &[name_id, anim_node] : anim_data.anim_nodes()) {
+		if (anim_node->type() == gef::AnimNode::kTransform) {
+			const gef::TransformAnimNode *node = (const gef::TransformAnimNode *)anim_node.get();
+			bytes += sizeof(gef::TransformAnimNode);
+			bytes += node->rotation_keys().capacity() * sizeof(gef::QuaternionKey);
+			bytes += node->translation_keys().capacity() * sizeof(gef::Vector3Key);
+			bytes += node->scale_keys().capacity() * sizeof(gef::Vector3Key);
+		}
+		else if (anim_node->type() == gef::AnimNode::kChannel) {
+			const gef::ChannelAnimNode *node = (const gef::ChannelAnimNode *)anim_node.get();
+			bytes += sizeof(gef::ChannelAnimNode);
+			bytes += node->keys().capacity() * sizeof(gef::ChannelKey);
+		}
+	}
+
+	bytes += additive_tracks.capacity() * sizeof(AdditiveTrack);
+	bytes += root_motion.getMemoryUsage();
+	std::lock_guard<std::mutex> lock(bind_mtx);
+	for (const gef::ptr<ClipBinding> &binding : bindings) {
+		bytes += sizeof(ClipBinding) + binding->joint_tracks.capacity() * sizeof(const gef::TransformAnimNode *);
+		bytes += binding->corrections.capacity() * sizeof(RetargetJoint);
+	}
+
+	return bytes;
+}
+
+// == CLIP PLAYBACK =================================
+
+bool ClipPlayback::advance(const Clip &clip, float delta_time, float speed, bool looping) {
+	prev_time = time;
+	wrapped = false;
+
+	time += delta_time * speed;
+	if (time >= clip.duration) {
+		time = 0;
+		wrapped = true;
+		if (!looping) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ClipPlayback::setTime(float new_time, bool has_wrapped) {
+	prev_time = time;
+	time = new_time;
+	wrapped = has_wrapped;
+}
+
+float ClipPlayback::getNormalizedTime(const Clip &clip) const {
+	return clip.duration > 0.f ? time / clip.duration : 0.f;
+}
+
+// == SAMPLING ======================================
+
+void sample(
+	const Clip &clip, float time, const gef::SkeletonPose &bind_pose, gef::SkeletonPose &out_pose,
+	const Int32 *joints, size_t joint_count
+) {
+	// add the clip start time to the playback time to calculate the final time
+	// that will be used to sample the animation data
+	float anim_time = time + clip.anim_data.start_time();
+
+	// any bones that don't have animation data are set to the bind pose
+	if (joints) {
+		out_pose.SetPoseFromAnim(clip.anim_data, bind_pose, anim_time, joints, joint_count);
+	}
+	else {
+		out_pose.SetPoseFromAnim(clip.anim_data, bind_pose, anim_time);
+	}
+}
+
+// local pose of <joint> out of its track, joints without one stay in bind pose
+static inline void sampleJoint(const ClipBinding &binding, size_t joint, float anim_time, const gef::JointPose &bind_joint, gef::JointPose &out) {
+	const gef::TransformAnimNode *track = binding.joint_tracks[joint];
+	if (!track) {
+		out = bind_joint;
+		return;
+	}
+
+	// same as SetPoseFromAnim, scale is always ignored
+	out.set_scale(gef::Vector4(1.f, 1.f, 1.f));
+
+	if (binding.corrections.empty()) {
+		out.set_rotation(track->rotation_keys().empty() ? bind_joint.rotation() : track->GetRotation(anim_time));
+		out.set_translation(track->translation_keys().empty() ? bind_joint.translation() : track->GetTranslation(anim_time));
+		return;
+	}
+
+	// retargeted: the rotation is moved into the space of the target joint, a source joint
+	// that doesn't rotate would be in its bind pose, which is the target's bind pose
+	if (track->rotation_keys().empty()) {
+		out.set_rotation(bind_joint.rotation());
+	}
+	else {
+		const RetargetJoint &correction = binding.corrections[joint];
+		out.set_rotation((correction.post * track->GetRotation(anim_time) * correction.pre).Norm());
+	}
+
+	// the bones have the target's lengths, only the root moves
+	if ((Int32)joint == binding.root_joint && !track->translation_keys().empty()) {
+		out.set_translation(track->GetTranslation(anim_time) * binding.root_scale);
+	}
+	else {
+		out.set_translation(bind_joint.translation());
+	}
+}
+
+void sample(
+	const Clip &clip, const ClipBinding &binding, float time, const gef::SkeletonPose &bind_pose,
+	gef::SkeletonPose &out_pose, const Int32 *joints, size_t joint_count
+) {
+	float anim_time = time + clip.anim_data.start_time();
+	const gef::Vec<gef::JointPose> &bind_local = bind_pose.local_pose();
+	gef::Vec<gef::JointPose> &out_local = out_pose.local_pose();
+
+	if (joints) {
+		for (size_t i = 0; i < joint_count; ++i) {
+			sampleJoint(binding, joints[i], anim_time, bind_local[joints[i]], out_local[joints[i]]);
+		}
+	}
+	else {
+		for (size_t i = 0; i < binding.joint_tracks.size(); ++i) {
+			sampleJoint(binding, i, anim_time, bind_local[i], out_local[i]);
+		}
+		out_pose.CalculateGlobalPose();
+	}
+}
+
+void sampleLocal(const Clip &clip, const ClipBinding &binding, float time, const gef::JointPose *bind_pose, gef::JointPose *out) {
+	float anim_time = time + clip.anim_data.start_time();
+
+	for (size_t i = 0; i < binding.joint_tracks.size(); ++i) {
+		sampleJoint(binding, i, anim_time, bind_pose[i], out[i]);
+	}
+}
+
+void applyAdditive(const Clip &clip, float time, float weight, gef::SkeletonPose &pose) {
+	float anim_time = time + clip.anim_data.start_time();
+	gef::Vec<gef::JointPose> &local_pose = pose.local_pose();
+
+	for (const AdditiveTrack &track : clip.additive_tracks) {
+		gef::JointPose &joint = local_pose[track.joint];
+
+		if (!track.node->rotation_keys().empty()) {
+			gef::Quaternion delta = track.node->GetRotation(anim_time);
+			if (weight < 1.f) {
+				delta = gef::Quaternion::lerp(gef::Quaternion::kIdentity, delta, weight).Norm();
+			}
+			joint.set_rotation(delta * joint.rotation());
+		}
+
+		if (!track.node->translation_keys().empty()) {
+			joint.set_translation(joint.translation() + track.node->GetTranslation(anim_time) * weight);
+		}
+	}
+}
+
+// == CLIP REF ======================================
+
+ClipRef::ClipRef(Clip *clip)
+	: clip(clip)
+{
+	if (clip) {
+		clip->ref_count++;
+	}
+}
+
+ClipRef::ClipRef(const ClipRef &other)
+	: ClipRef(other.clip)
+{
+}
+
+ClipRef::ClipRef(ClipRef &&other) {
+	std::swap(clip, other.clip);
+}
+
+ClipRef::~ClipRef() {
+	release();
+}
+
+ClipRef &ClipRef::operator=(const ClipRef &other) {
+	if (clip != other.clip) {
+		release();
+		clip = other.clip;
+		if (clip) {
+			clip->ref_count++;
+		}
+	}
+	return *this;
+}
+
+ClipRef &ClipRef::operator=(ClipRef &&other) {
+	std::swap(clip, other.clip);
+	return *this;
+}
+
+void ClipRef::release() {
+	if (!clip) {
+		return;
+	}
+	if (--clip->ref_count == 0) {
+		getClipLibrary().remove(clip);
+	}
+	clip = nullptr;
+}
+
+const ClipBinding *ClipRef::bind(const gef::Skeleton &skeleton, const RetargetMap *retarget) const {
+	return clip ? clip->bind(skeleton, retarget) : nullptr;
+}
+
+// == CLIP LIBRARY ==================================
+
+ClipRef ClipLibrary::find(const char *path, const char *clip_name, AdditiveMode additive, bool root_motion, const gef::Skeleton *skeleton) {
+	// additive clips never have root motion, see add
+	root_motion = root_motion && additive == AdditiveMode::None;
+
+	uint32_t skeleton_hash = 0;
+	if (additive != AdditiveMode::None || root_motion) {
+		if (!skeleton) {
+			return ClipRef();
+		}
+		skeleton_hash = hashSkeleton(*skeleton);
+	}
+
+	for (gef::ptr<Clip> &clip : clips) {
+		if (clip->additive != additive || clip->has_root_motion != root_motion || clip->path != path) {
+			continue;
+		}
+		if (clip->skeleton_hash != skeleton_hash) {
+			continue;
+		}
+		if (clip_name ? clip->clip_name == clip_name : clip->is_first) {
+			return ClipRef(clip.get());
+		}
+	}
+	return ClipRef();
+}
+
+ClipRef ClipLibrary::add(
+	const char *path, gef::Animation &&anim, const gef::StringIdTable &strings,
+	AdditiveMode additive, const gef::SkeletonPose *bind_pose, bool root_motion
+) {
+	std::string clip_name;
+	const_cast<gef::StringIdTable &>(strings).Find(anim.name_id(), clip_name);
+
+	if (root_motion && additive != AdditiveMode::None) {
+		warn("%s: additive clips can't have root motion, loading it in place", path);
+		root_motion = false;
+	}
+
+	const gef::Skeleton *skeleton = bind_pose ? bind_pose->skeleton() : nullptr;
+	if (ClipRef existing = find(path, clip_name.c_str(), additive, root_motion, skeleton)) {
+		return existing;
+	}
+
+	PushAllocInfo("ClipLibrary");
+
+	gef::ptr<Clip> clip = gef::ptr<Clip>::make();
+	clip->anim_data = std::move(anim);
+	clip->duration = clip->anim_data.duration();
+	clip->path = path;
+	clip->clip_name = std::move(clip_name);
+	// scene files only ever have one clip
+	clip->is_first = true;
+
+	if (additive != AdditiveMode::None) {
+		assert(bind_pose && "additive clips need a bind pose");
+		makeAdditive(*clip, additive, *bind_pose);
+	}
+
+	if (root_motion) {
+		assert(bind_pose && "root motion clips need a bind pose");
+		extractRootMotion(*clip, *bind_pose->skeleton());
+	}
+
+	if (clip->additive != AdditiveMode::None || clip->has_root_motion) {
+		clip->skeleton_hash = hashSkeleton(*skeleton);
+	}
+
+	clips.emplace_back(std::move(clip));
+	PopAllocInfo();
+
+	return ClipRef(clips.back().get());
+}
+
+void ClipLibrary::cleanup() {
+	for (const gef::ptr<Clip> &clip : clips) {
+		if (clip->ref_count > 0) {
+			warn("clip %s is still referenced %d times", clip->path.c_str(), clip->ref_count);
+		}
+	}
+	// the library is static, free the memory now instead of after the allocator is gone
+	clips.destroy();
+}
+
+size_t ClipLibrary::getMemoryUsage() const {
+	size_t bytes = 0;
+	for (const gef::ptr<Clip> &clip : clips) {
+		bytes += clip->getMemoryUsage();
+	}
+	return bytes;
+}
+
+void ClipLibrary::debugDraw() {
+	size_t total = getMemoryUsage();
+	ImGui::Text("Clips: %zu, total: %zuKB", clips.size(), total / 1024);
+
+	if (ImGui::BeginTable("Clips", 5, ImGuiTableFlags_Resizable | ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+		ImGui::TableSetupColumn("Path");
+		ImGui::TableSetupColumn("Clip");
+		ImGui::TableSetupColumn("Refs");
+		ImGui::TableSetupColumn("Bindings");
+		ImGui::TableSetupColumn("Size");
+		ImGui::TableHeadersRow();
+
+		for (const gef::ptr<Clip> &clip : clips) {
+			ImGui::TableNextColumn();
+			ImGui::Text(
+				"%s%s%s", clip->path.c_str(), 
+				clip->additive != AdditiveMode::None ? " (additive)" : "",
+				clip->has_root_motion ? " (root motion)" : ""
+			);
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", clip->clip_name.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%d", clip->ref_count);
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu", clip->bindings.size());
+			ImGui::TableNextColumn();
+			ImGui::Text("%zuKB", clip->getMemoryUsage() / 1024);
+		}
+
+		ImGui::EndTable();
+	}
+}
+
+void ClipLibrary::remove(Clip *clip) {
+	for (size_t i = 0; i < clips.size(); ++i) {
+		if (clips[i].get() == clip) {
+			clips.erase(i);
+			return;
+		}
+	}
+}
+
+ClipLibrary &getClipLibrary() {
+	static ClipLibrary library;
+	return library;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <mutex>
+
+#include <system/vec.h>
+#include <system/ptr.h>
+#include <animation/animation.h>
+#include <animation/skeleton.h>
+
+#include "root_motion.h"
+#include "retarget.h"
+
+// how the tracks of an additive clip are converted to deltas at load time
+enum class AdditiveMode : uint8_t {
+	None,       // regular clip
+	FirstFrame, // deltas against the first key of each track
+	BindPose,   // deltas against the skeleton's bind pose
+	Count
+};
+
+// joint that is actually moved by an additive clip, the node only
+// has the delta tracks that weren't constant zero
+struct AdditiveTrack {
+	Int32 joint;
+	const gef::TransformAnimNode *node;
+};
+
+// track of every joint of a skeleton, nullptr if the joint is not animated
+struct ClipBinding {
+	uint32_t skeleton_hash = 0;
+	gef::Vec<const gef::TransformAnimNode *> joint_tracks;
+
+	// == retargeting, empty when the skeleton is the one the clip was made for ==
+	// copied out of the map so the binding doesn't depend on who built it
+	gef::Vec<RetargetJoint> corrections;
+	Int32 root_joint = -1;
+	float root_scale = 1.f;
+};
+
+// fnv-1a over the joint names, same joints in the same order means same binding
+uint32_t hashSkeleton(const gef::Skeleton &skeleton);
+
+// animation data loaded from a scene file, it's shared by everything that loads
+// the same file so it must never be changed after it's been added to the library
+struct Clip {
+	// finds (or builds) the tracks of every joint in <skeleton>. with <retarget> the
+	// tracks are the ones of the source joints and they are corrected when sampled.
+	// safe to call from any thread, a binding is never moved or removed once it's built
+	const ClipBinding *bind(const gef::Skeleton &skeleton, const RetargetMap *retarget = nullptr);
+	size_t getMemoryUsage() const;
+
+	gef::Animation anim_data;
+	float duration = 0.f;
+	AdditiveMode additive = AdditiveMode::None;
+	bool has_root_motion = false;
+	gef::Vec<AdditiveTrack> additive_tracks;
+	// baked out of the root track at load, empty if the clip was loaded in place
+	RootMotionCurve root_motion;
+	// one for every different skeleton that has used this clip
+	gef::Vec<gef::ptr<ClipBinding>> bindings;
+	mutable std::mutex bind_mtx;
+
+	// == key ==
+	std::string path;
+	std::string clip_name;
+	bool is_first = false; // first clip in the file, which is the one loaded when no name is given
+	// skeleton the additive tracks and root motion were baked against, 0 for a regular clip
+	uint32_t skeleton_hash = 0;
+
+	int ref_count = 0;
+};
+
+// time of one instance of a clip. everything that plays a clip (tree nodes, characters)
+// keeps its own, so the same clip can be played at different times at once
+struct ClipPlayback {
+	// returns true when a clip that doesn't loop has finished
+	bool advance(const Clip &clip, float delta_time, float speed = 1.f, bool looping = true);
+	// moves the time without advancing it, <has_wrapped> if it went past the end of the clip
+	void setTime(float new_time, bool has_wrapped = false);
+	// range (0, 1)
+	float getNormalizedTime(const Clip &clip) const;
+
+	float time = 0.f;
+	// == what happened in the last update, used to fire the events ==
+	float prev_time = 0.f;
+	bool wrapped = false;
+	uint32_t event_cursor = 0;
+};
+
+// == stateless sampling ==
+// these only read the clip, so the same clip can be sampled at different times
+// and from different threads at once. <time> is in seconds from the start of the clip
+
+// samples <clip> into the local pose of <out_pose> and updates its global pose, joints
+// without a track are set to <bind_pose>. if <joints> is not null only those joints are
+// sampled and the global pose is left alone
+void sample(
+	const Clip &clip, float time, const gef::SkeletonPose &bind_pose, gef::SkeletonPose &out_pose,
+	const Int32 *joints = nullptr, size_t joint_count = 0
+);
+// same as above but through <binding>, which is needed to play retargeted clips
+void sample(
+	const Clip &clip, const ClipBinding &binding, float time, const gef::SkeletonPose &bind_pose,
+	gef::SkeletonPose &out_pose, const Int32 *joints = nullptr, size_t joint_count = 0
+);
+// samples the joints of <binding> into <out>, one local pose per joint
+void sampleLocal(const Clip &clip, const ClipBinding &binding, float time, const gef::JointPose *bind_pose, gef::JointPose *out);
+// adds the delta tracks of an additive <clip> on top of the local pose of <pose>, <weight> range (0, 1)
+void applyAdditive(const Clip &clip, float time, float weight, gef::SkeletonPose &pose);
+
+// shared reference to a clip in the library, when the last one goes away
+// the clip is removed. only copy them around on the main thread
+class ClipRef {
+public:
+	ClipRef() = default;
+	ClipRef(Clip *clip);
+	ClipRef(const ClipRef &other);
+	ClipRef(ClipRef &&other);
+	~ClipRef();
+
+	ClipRef &operator=(const ClipRef &other);
+	ClipRef &operator=(ClipRef &&other);
+
+	void release();
+
+	const Clip *get() const { return clip; }
+	const Clip *operator->() const { return clip; }
+	const Clip &operator*() const { return *clip; }
+	operator bool() const { return clip != nullptr; }
+
+	// bindings are derived data, they can be added to a shared clip from any thread
+	const ClipBinding *bind(const gef::Skeleton &skeleton, const RetargetMap *retarget = nullptr) const;
+
+private:
+	Clip *clip = nullptr;
+};
+
+// process wide library of clips, keyed by path, clip name, additive mode and root motion.
+// additive and root motion clips are baked against a skeleton, so that's part of their key too.
+// loading the same file twice hands out the same clip
+class ClipLibrary {
+public:
+	// <clip_name> can be null, in which case the first clip of the file is used. <skeleton> is
+	// the one an additive or root motion clip would be baked against, without it a baked clip
+	// isn't found
+	ClipRef find(
+		const char *path, const char *clip_name = nullptr, AdditiveMode additive = AdditiveMode::None,
+		bool root_motion = false, const gef::Skeleton *skeleton = nullptr
+	);
+	// adds the clip, <bind_pose> is needed for additive and root motion clips. if the
+	// same clip was already added, that one is returned instead
+	ClipRef add(
+		const char *path, gef::Animation &&anim, const gef::StringIdTable &strings,
+		AdditiveMode additive = AdditiveMode::None, const gef::SkeletonPose *bind_pose = nullptr,
+		bool root_motion = false
+	);
+
+	void cleanup();
+
+	size_t getClipCount() const { return clips.size(); }
+	size_t getMemoryUsage() const;
+
+	void debugDraw();
+
+private:
+	friend class ClipRef;
+	void remove(Clip *clip);
+
+	gef::Vec<gef::ptr<Clip>> clips;
+};
+
+ClipLibrary &getClipLibrary();
@@ -40,7 +40,27 @@ void CourseworkApp::Init() {
 	SetupCamera();
 	SetupLights();
 
-	animik.init(platform_, renderer_3d_, input_manager_, "xbot/xbot.scn");
+	jobs.init();
+	loader.init(platform_, &jobs);
+	anim3d.setAsyncLoader(&loader);
+	animcrowd.setAsyncLoader(&loader);
+
+	static const ClipRequest crowd_clips[] = {
+		{ "xbot/xbot@idle.scn",         "idle" },
+		{ "xbot/xbot@running.scn",      "running" },
+		{ "xbot/xbot@left_strafe.scn",  "left strafe" },
+		{ "xbot/xbot@right_strafe.scn", "right strafe" },
+		{ "xbot/xbot@dancing.scn",      "dancing" },
+	};
+	constexpr int crowd_clip_count = sizeof(crowd_clips) / sizeof(*crowd_clips);
+
+	// the crowd is set up last, start loading its files now so they load
+	// in the background while the other systems are set up. they're only for the
+	// crowd, the 3d system loads its own copy of the character
+	loader.prefetch("xbot/xbot.scn", &animcrowd);
+	for (const ClipRequest &clip : crowd_clips) {
+		loader.prefetch(clip.filename, &animcrowd);
+	}
 
 	anim3d.init(platform_, renderer_3d_, "xbot/xbot.scn");
 
@@ -53,12 +73,15 @@ void CourseworkApp::Init() {
 		}
 	}
 	if (!loaded_default) {
-		anim3d.loadAnimation("xbot/xbot@running.scn", "running");
-		anim3d.loadAnimation("xbot/xbot@left_strafe.scn", "left strafe");
-		anim3d.loadAnimation("xbot/xbot@right_strafe.scn", "right strafe");
-		anim3d.loadAnimation("xbot/xbot@idle.scn", "idle");
-		anim3d.loadAnimation("xbot/xbot@jump.scn", "jump");
-		anim3d.loadAnimation("xbot/xbot@dancing.scn", "dancing");
+		static const ClipRequest clips[] = {
+			{ "xbot/xbot@running.scn",      "running",      AdditiveMode::None, true },
+			{ "xbot/xbot@left_strafe.scn",  "left strafe",  AdditiveMode::None, true },
+			{ "xbot/xbot@right_strafe.scn", "right strafe", AdditiveMode::None, true },
+			{ "xbot/xbot@idle.scn",         "idle" },
+			{ "xbot/xbot@jump.scn",         "jump" },
+			{ "xbot/xbot@dancing.scn",      "dancing" },
+		};
+		anim3d.loadAnimations(clips, sizeof(clips) / sizeof(*clips));
 		BlendTree &tree = anim3d.getBlendTree();
 		ClipNode *clip = tree.arena.make<ClipNode>(tree);
 		clip->clip = anim3d.getAnimation(0);
@@ -66,6 +89,17 @@ void CourseworkApp::Init() {
 		tree.exit_node = clip;
 	}
 
+	// the ik system puts its node on top of the blend tree of the 3d one
+	animik.init(platform_, renderer_3d_, input_manager_, &anim3d);
+	animik.setJobSystem(&jobs);
+
+	animcrowd.init(platform_, renderer_3d_, "xbot/xbot.scn");
+	animcrowd.setJobSystem(&jobs);
+	animcrowd.loadAnimations(crowd_clips, crowd_clip_count);
+	// the clips the 3d system had already put in the library
+	loader.dropPrefetches(&animcrowd);
+	animcrowd.spawn(100);
+
 	animske2d.init(&batch, platform_);
 	animske2d.loadFromDragonBones("dragon/Dragon_tex.json", "dragon/Dragon_ske.json");
 	animske2d.setAnimation(0);
@@ -75,6 +109,8 @@ void CourseworkApp::Init() {
 	frame2d_editor.init(&animsprite, platform_);
 	ske2d_editor.init(&animske2d, &batch);
 	anim3d_editor.init(&anim3d, platform_);
+	// the editor keeps pointers to the nodes of the tree, it has to follow the ik node
+	animik.setTreeChangedCallback([](void *editor) { ((Anim3DEditor *)editor)->generate(); }, &anim3d_editor);
 
 	anim3d_editor.generate();
 
@@ -94,9 +130,9 @@ void CourseworkApp::Init() {
 	tran.set_scale({ 0.01f, 0.01f, 0.01f });
 	anim3d.setTransform(tran);
 
-	tran = animik.getTransform();
+	tran = animcrowd.getTransform();
 	tran.set_scale({ 0.01f, 0.01f, 0.01f });
-	animik.setTransform(tran);
+	animcrowd.setTransform(tran);
 
 	cur_system = &animsprite;
 
@@ -108,6 +144,7 @@ void CourseworkApp::CleanUp() {
 
 	CleanUpFont();
 
+	animcrowd.cleanup();
 	animik.cleanup();
 	anim3d.cleanup();
 	animske2d.cleanup();
@@ -119,6 +156,10 @@ void CourseworkApp::CleanUp() {
 
 	batch.cleanup();
 
+	loader.cleanup();
+	jobs.cleanup();
+	getClipLibrary().cleanup();
+
 	g_alloc->destroy(input_manager_);
 	input_manager_ = NULL;
 
@@ -200,17 +241,19 @@ void CourseworkApp::Render() {
 
 	static gef::Vector4 cur_pos = cur_system->getTransform().translation();
 
-	const char *anim_types[] = { "Sprite 2D", "Skeleton 2D", "Skeleton 3D", "Inverse Kinematics"};
+	const char *anim_types[] = { "Sprite 2D", "Skeleton 2D", "Skeleton 3D", "Inverse Kinematics", "Crowd" };
 	int cur_type = (int)cur_system->getType() - 1;
 	if (ImGui::ListBox("Type", &cur_type, anim_types, (int)AnimSystemType::Count - 1)) {
 		frame2d_editor.close();
 		ske2d_editor.close();
 		anim3d_editor.close();
+		cur_system->deactivate();
 		switch ((AnimSystemType)(cur_type + 1)) {
 		case AnimSystemType::Sprite2D:   cur_system = &animsprite; break;
 		case AnimSystemType::Skeleton2D: cur_system = &animske2d;  break;
 		case AnimSystemType::Skeleton3D: cur_system = &anim3d;     break;
 		case AnimSystemType::InverseKinematics: cur_system = &animik; break;
+		case AnimSystemType::Crowd: cur_system = &animcrowd; break;
 		}
 		cur_pos = cur_system->getTransform().translation();
 	}
@@ -303,6 +346,19 @@ void CourseworkApp::Render() {
 		ImGui::End();
 	}
 
+	static bool show_clips = false;
+
+	if (ImGui::IsKeyPressed(ImGuiKey_F2)) {
+		show_clips = !show_clips;
+	}
+
+	if (show_clips) {
+		if (ImGui::Begin("Clip library", &show_clips)) {
+			getClipLibrary().debugDraw();
+		}
+		ImGui::End();
+	}
+
 	frame2d_editor.draw();
 	anim3d_editor.draw();
 
@@ -7,18 +7,21 @@
 #include <maths/vector2.h>
 #include <maths/vector4.h>
 #include <maths/matrix44.h>
+#include <system/job_system.h>
 
 #include "anim_system.h"
 #include "anim_system_sprite.h"
 #include "anim_system_ske2d.h"
 #include "anim_system_3d.h"
 #include "anim_system_ik.h"
+#include "anim_system_crowd.h"
 
 #include "frame2d_editor.h"
 #include "ske2d_editor.h"
 #include "anim3d_editor.h"
 
 #include "batch2d.h"
+#include "async_loader.h"
 #include "blend_tree.h"
 
 // FRAMEWORK FORWARD DECLARATIONS
@@ -62,11 +65,15 @@ private:
 	float near_plane_;
 	float far_plane_;
 
+	gef::JobSystem jobs;
+	AsyncLoader loader;
+
 	AnimSystem *cur_system = nullptr;
 	AnimSystemSprite animsprite;
 	AnimSystemSke2D animske2d;
 	AnimSystem3D anim3d;
 	AnimSystemIK animik;
+	AnimSystemCrowd animcrowd;
 
 	Frame2DEditor frame2d_editor;
 	Ske2DEditor ske2d_editor;
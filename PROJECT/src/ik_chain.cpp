@@ -0,0 +1,597 @@
+#include "ik_chain.h"
+
+#include <math.h>
+
+#include <maths/math_utils.h>
+#include <animation/joint.h>
+
+#include "utils.h"
+
+static const char *solver_names[] = {
+	"Auto", "CCD", "FABRIK", "Two bone"
+};
+
+static_assert((sizeof(solver_names) / sizeof(*solver_names)) == (int)IKSolver::Count);
+
+const char *getIKSolverName(IKSolver solver) {
+	return (uint8_t)solver < (uint8_t)IKSolver::Count ? solver_names[(uint8_t)solver] : "Unknown";
+}
+
+static const char *limit_names[] = {
+	"None", "Hinge", "Cone"
+};
+
+static_assert((sizeof(limit_names) / sizeof(*limit_names)) == (int)IKLimit::Count);
+
+const char *getIKLimitName(IKLimit limit) {
+	return (uint8_t)limit < (uint8_t)IKLimit::Count ? limit_names[(uint8_t)limit] : "Unknown";
+}
+
+static gef::Quaternion inverse(const gef::Quaternion &rotation) {
+	gef::Quaternion out;
+	out.Conjugate(rotation);
+	return out;
+}
+
+// shortest rotation that turns <from> towards <to>, without going through an angle.
+// identity if one of them is zero or they point in opposite directions
+static gef::Quaternion rotationBetween(const gef::Vector4 &from, const gef::Vector4 &to) {
+	float lengths = sqrtf(from.LengthSqr() * to.LengthSqr());
+	float w = lengths + from.DotProduct(to);
+	if (w <= lengths * 1e-6f) {
+		return gef::Quaternion::kIdentity;
+	}
+	gef::Vector4 axis = from.CrossProduct(to);
+	return gef::Quaternion(axis.x(), axis.y(), axis.z(), w).Norm();
+}
+
+// the part of <rotation> around <axis>, the rest is the swing: rotation = twist * swing
+static gef::Quaternion getTwist(const gef::Quaternion &rotation, const gef::Vector4 &axis) {
+	float along = rotation.x * axis.x() + rotation.y * axis.y() + rotation.z * axis.z();
+	float length = sqrtf(along * along + rotation.w * rotation.w);
+	if (length < 1e-6f) {
+		// half a turn of swing, there's no twist to speak of
+		return gef::Quaternion::kIdentity;
+	}
+	return gef::Quaternion(axis.x() * along, axis.y() * along, axis.z() * along, rotation.w) / length;
+}
+
+// signed angle of a rotation around <axis>, the short way round
+static float getAngleAround(const gef::Quaternion &rotation, const gef::Vector4 &axis) {
+	float along = rotation.x * axis.x() + rotation.y * axis.y() + rotation.z * axis.z();
+	float angle = 2.f * atan2f(along, rotation.w);
+	if (angle > gef::pi)       angle -= 2.f * gef::pi;
+	else if (angle < -gef::pi) angle += 2.f * gef::pi;
+	return angle;
+}
+
+// model space rotation of <joint>, from the local rotations of it and its parents
+static gef::Quaternion getGlobalRotation(const gef::SkeletonPose &pose, Int32 joint) {
+	const gef::Skeleton *skeleton = pose.skeleton();
+	const auto &local_pose = pose.local_pose();
+
+	gef::Quaternion rotation = gef::Quaternion::kIdentity;
+	for (; joint >= 0; joint = skeleton->joint(joint).parent) {
+		rotation = rotation * local_pose[joint].rotation();
+	}
+	return rotation.Norm();
+}
+
+bool IKChain::init(const gef::Skeleton &skeleton, const int *chain, size_t count) {
+	clear();
+
+	if (count < 2) {
+		return false;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		if (chain[i] < 0 || chain[i] >= skeleton.joint_count()) {
+			err("ik chain: joint %d isn't in the skeleton", chain[i]);
+			return false;
+		}
+		if (i == 0) {
+			continue;
+		}
+		Int32 parent = skeleton.joint(chain[i]).parent;
+		while (parent >= 0 && parent != chain[i - 1]) {
+			parent = skeleton.joint(parent).parent;
+		}
+		if (parent < 0) {
+			err("ik chain: joint %d isn't below joint %d", chain[i], chain[i - 1]);
+			return false;
+		}
+	}
+
+	joints.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		joints.push_back(chain[i]);
+	}
+	positions.resize(count, gef::Vector4::kZero);
+	start_positions.resize(count, gef::Vector4::kZero);
+	lengths.resize(count - 1, 0.f);
+	deltas.resize(count, gef::Quaternion::kIdentity);
+	parent_rotations.resize(count, gef::Quaternion::kIdentity);
+	start_rotations.resize(count, gef::Quaternion::kIdentity);
+	warm_deltas.resize(count, gef::Quaternion::kIdentity);
+
+	// the limits are relative to the bind pose, the skeleton only has it as inverse matrices
+	gef::SkeletonPose bind_pose;
+	bind_pose.CreateBindPose(&skeleton);
+	const auto &bind_global = bind_pose.global_pose();
+
+	limits.resize(count, JointLimit{ gef::Vector4::kZero, 0.f, 0.f, 0.f, IKLimit::None });
+	bind_rotations.resize(count, gef::Quaternion::kIdentity);
+	rest_rotations.resize(count, gef::Quaternion::kIdentity);
+	bind_bones.resize(count, gef::Vector4::kZero);
+	for (size_t i = 0; i < count; ++i) {
+		bind_rotations[i] = getGlobalRotation(bind_pose, joints[i]);
+		rest_rotations[i] = bind_pose.local_pose()[joints[i]].rotation().Norm();
+		if (i + 1 < count) {
+			gef::Vector4 bone = bind_global[joints[i + 1]].GetTranslation() - bind_global[joints[i]].GetTranslation();
+			bind_bones[i] = gef::Quaternion::Rotate(inverse(bind_rotations[i]), bone);
+			if (bind_bones[i].LengthSqr() > 1e-12f) {
+				bind_bones[i].Normalise();
+			}
+		}
+	}
+	return true;
+}
+
+void IKChain::clear() {
+	joints.clear();
+	positions.clear();
+	start_positions.clear();
+	lengths.clear();
+	deltas.clear();
+	parent_rotations.clear();
+	start_rotations.clear();
+	warm_deltas.clear();
+	limits.clear();
+	bind_rotations.clear();
+	rest_rotations.clear();
+	bind_bones.clear();
+	limit_count = 0;
+	has_warm_start = false;
+	length = 0.f;
+	has_pole = false;
+}
+
+void IKChain::begin(const gef::SkeletonPose &pose, bool warm_start) {
+	const gef::Skeleton *skeleton = pose.skeleton();
+	const auto &global_pose = pose.global_pose();
+
+	length = 0.f;
+	for (size_t i = 0; i < joints.size(); ++i) {
+		positions[i] = global_pose[joints[i]].GetTranslation();
+		start_positions[i] = positions[i];
+		deltas[i] = gef::Quaternion::kIdentity;
+		parent_rotations[i] = getGlobalRotation(pose, skeleton->joint(joints[i]).parent);
+		start_rotations[i] = (pose.local_pose()[joints[i]].rotation() * parent_rotations[i]).Norm();
+		if (i > 0) {
+			lengths[i - 1] = (positions[i] - positions[i - 1]).Length();
+			length += lengths[i - 1];
+		}
+	}
+
+	if (!warm_start || !has_warm_start) {
+		return;
+	}
+
+	// the bone after each joint is turned by the delta of the joint, which already has the ones before it
+	for (size_t i = 0; i < joints.size(); ++i) {
+		deltas[i] = warm_deltas[i];
+		if (i > 0) {
+			positions[i] = positions[i - 1] + gef::Quaternion::Rotate(deltas[i - 1], start_positions[i] - start_positions[i - 1]);
+		}
+	}
+}
+
+void IKChain::apply(gef::SkeletonPose &pose, float weight) const {
+	auto &local_pose = pose.local_pose();
+
+	// the new global rotation is the old one followed by the delta, the same for the parent, so
+	//   local = parent * delta * inverse(parent delta) * inverse(parent) after the old local
+	for (size_t i = 0; i < joints.size(); ++i) {
+		const gef::Quaternion &parent = parent_rotations[i];
+		gef::Quaternion parent_delta = i > 0 ? deltas[i - 1].Norm() : gef::Quaternion::kIdentity;
+		gef::Quaternion change = parent * deltas[i].Norm() * inverse(parent_delta) * inverse(parent);
+
+		gef::JointPose &local = local_pose[joints[i]];
+		gef::Quaternion solved = (local.rotation() * change).Norm();
+		local.set_rotation(weight >= 1.f ? solved : gef::Quaternion::slerp(local.rotation(), solved, weight));
+	}
+
+	pose.CalculateGlobalPoseSubtree(joints[0]);
+}
+
+IKResult IKChain::solveCCD(const gef::Vector4 &target, int max_iterations, float epsilon, double deadline_us) {
+	IKResult result;
+	const int count = (int)joints.size();
+	if (count < 2) {
+		return result;
+	}
+
+	const bool limit_steps = limit_count > 0 && limit_every_step;
+	float distance = (target - positions[count - 1]).Length();
+	float distance_delta = distance;
+
+	// with limits it can go back and forth around the closest pose it can get to, so it
+	// stops as soon as an iteration doesn't get closer by more than epsilon
+	while (distance > epsilon && distance_delta > epsilon && result.iterations < max_iterations) {
+		for (int i = count - 2; i >= 0; --i) {
+			const gef::Vector4 &pivot = positions[i];
+			gef::Quaternion rotation = rotationBetween(positions[count - 1] - pivot, target - pivot);
+
+			// only the joints after this one move, and only around it
+			for (int j = i + 1; j < count; ++j) {
+				positions[j] = pivot + gef::Quaternion::Rotate(rotation, positions[j] - pivot);
+			}
+			for (int j = i; j < count; ++j) {
+				deltas[j] = deltas[j] * rotation;
+			}
+
+			if (limit_steps) {
+				applyLimit(i);
+			}
+		}
+
+		float new_distance = (target - positions[count - 1]).Length();
+		distance_delta = distance - new_distance;
+		distance = new_distance;
+		result.iterations++;
+
+		if (deadline_us > 0.0 && timeNowUs() >= deadline_us) {
+			result.out_of_time = true;
+			break;
+		}
+	}
+
+	result.distance = distance;
+	result.reached = distance <= epsilon;
+	result.converged = result.reached || distance_delta <= epsilon;
+	if (limit_count > 0 && !limit_every_step) {
+		clampResult(target, epsilon, result);
+	}
+	return result;
+}
+
+IKResult IKChain::solveFABRIK(const gef::Vector4 &target, int max_iterations, float epsilon, double deadline_us) {
+	IKResult result;
+	const int count = (int)joints.size();
+	if (count < 2) {
+		return result;
+	}
+
+	const gef::Vector4 root = positions[0];
+
+	// puts <joint> on the line to <from>, one bone length away from it
+	auto place = [this](int joint, int from, float bone_length) {
+		gef::Vector4 dir = positions[joint] - positions[from];
+		float dir_length = dir.Length();
+		if (dir_length > 1e-6f) {
+			positions[joint] = positions[from] + dir * (bone_length / dir_length);
+		}
+	};
+
+	float distance = (target - positions[count - 1]).Length();
+
+	if ((target - root).Length() >= length) {
+		// out of reach, the best it can do is point straight at it
+		for (int i = 1; i < count; ++i) {
+			positions[i] = target;
+			place(i, i - 1, lengths[i - 1]);
+		}
+		distance = (target - positions[count - 1]).Length();
+		result.iterations = 1;
+		result.converged = true;
+	}
+	else {
+		float distance_delta = distance;
+		while (distance > epsilon && distance_delta > epsilon && result.iterations < max_iterations) {
+			// backward, from the end effector on the target to the root
+			positions[count - 1] = target;
+			for (int i = count - 2; i >= 0; --i) {
+				place(i, i + 1, lengths[i]);
+			}
+
+			// forward, from the root back where it was to the end effector
+			positions[0] = root;
+			for (int i = 1; i < count; ++i) {
+				place(i, i - 1, lengths[i - 1]);
+			}
+
+			float new_distance = (target - positions[count - 1]).Length();
+			distance_delta = distance - new_distance;
+			distance = new_distance;
+			result.iterations++;
+
+			if (deadline_us > 0.0 && timeNowUs() >= deadline_us) {
+				result.out_of_time = true;
+				break;
+			}
+		}
+		result.converged = distance <= epsilon || distance_delta <= epsilon;
+	}
+
+	result.distance = distance;
+	result.reached = distance <= epsilon;
+	findRotations(0);
+	// the positions can't be kept inside the limits pass by pass, the passes fight the
+	// limits and crawl along them, so the limits are only applied to the result
+	if (limit_count > 0) {
+		clampResult(target, epsilon, result);
+	}
+	return result;
+}
+
+IKResult IKChain::solveTwoBone(const gef::Vector4 &target, float epsilon) {
+	IKResult result;
+	if (joints.size() != 3) {
+		return result;
+	}
+
+	const gef::Vector4 root = positions[0];
+	const float upper = lengths[0];
+	const float lower = lengths[1];
+
+	gef::Vector4 to_target = target - root;
+	float target_distance = to_target.Length();
+	gef::Vector4 dir = target_distance > 1e-6f ? to_target / target_distance : (positions[2] - root).Normalised();
+
+	// a hinge in the middle joint only bends one way round its axis: the lower bone turns
+	// towards axis x upper, so upper x lower points along the axis. it's in model space in
+	// the pose the solve started from
+	const JointLimit &hinge = limits[1];
+	const bool has_hinge = hinge.type == IKLimit::Hinge;
+	gef::Vector4 hinge_axis = gef::Vector4::kZero;
+	if (has_hinge) {
+		hinge_axis = gef::Quaternion::Rotate(start_rotations[1], hinge.axis);
+		if (hinge.min_angle + hinge.max_angle < 0.f) {
+			hinge_axis = -hinge_axis;
+		}
+	}
+
+	// the plane the chain bends in goes through the root, the target and the pole.
+	// without a pole a hinge picks the plane it's in once the chain turns to the target,
+	// so the root twists as little as it can, otherwise the middle joint stays on the
+	// side it already is
+	gef::Vector4 bend = gef::Vector4::kZero;
+	if (has_hinge && !has_pole) {
+		gef::Vector4 axis = gef::Quaternion::Rotate(rotationBetween(start_positions[2] - start_positions[0], dir), hinge_axis);
+		bend = dir.CrossProduct(axis - dir * axis.DotProduct(dir));
+	}
+	else {
+		gef::Vector4 pole = (has_pole ? pole_position : positions[1]) - root;
+		bend = pole - dir * pole.DotProduct(dir);
+	}
+	if (bend.LengthSqr() < 1e-8f) {
+		// the pole is on the line to the target, any side will do
+		bend = dir.CrossProduct(fabsf(dir.y()) < 0.9f ? gef::Vector4(0.f, 1.f, 0.f) : gef::Vector4(1.f, 0.f, 0.f));
+	}
+	bend.Normalise();
+
+	// law of cosines for the angle at the root, the distance is clamped so the triangle exists
+	float d = gef::clamp(target_distance, fabsf(upper - lower) + 1e-4f, upper + lower - 1e-4f);
+	float cos_root = gef::clamp((upper * upper + d * d - lower * lower) / (2.f * upper * d), -1.f, 1.f);
+	float sin_root = sqrtf(1.f - cos_root * cos_root);
+
+	positions[1] = root + dir * (upper * cos_root) + bend * (upper * sin_root);
+	positions[2] = root + dir * d;
+
+	// the root turns the upper bone and then twists it around itself so the bend
+	// planes match, that leaves only a hinge rotation for the middle joint
+	gef::Vector4 old_upper = start_positions[1] - start_positions[0];
+	gef::Vector4 old_lower = start_positions[2] - start_positions[1];
+	gef::Vector4 new_upper = positions[1] - positions[0];
+	gef::Vector4 new_lower = positions[2] - positions[1];
+
+	gef::Quaternion swing = rotationBetween(old_upper, new_upper);
+	// with a hinge it's the axis that has to end up on the normal of the new plane, so the
+	// middle joint only turns around it. a straight chain has no bend plane of its own
+	gef::Vector4 old_normal = gef::Quaternion::Rotate(swing, has_hinge ? hinge_axis : old_upper.CrossProduct(old_lower));
+	gef::Vector4 new_normal = new_upper.CrossProduct(new_lower);
+	// only the part across the upper bone, the twist can't move the bone itself
+	float upper_sqr = new_upper.LengthSqr();
+	if (upper_sqr > 1e-12f) {
+		old_normal -= new_upper * (old_normal.DotProduct(new_upper) / upper_sqr);
+	}
+	bool has_planes = old_normal.LengthSqr() > 1e-12f && new_normal.LengthSqr() > 1e-12f;
+	deltas[0] = has_planes ? swing * rotationBetween(old_normal, new_normal) : swing;
+	findRotations(1);
+
+	result.distance = (target - positions[2]).Length();
+	result.reached = result.distance <= epsilon;
+	result.converged = true;
+	// whatever is left outside the limits is clamped
+	if (limit_count > 0) {
+		clampResult(target, epsilon, result);
+	}
+	return result;
+}
+
+IKResult IKChain::solve(const gef::Vector4 &target, int max_iterations, float epsilon, double deadline_us) {
+	IKResult result;
+	// fabrik can only clamp its result, so limits that have to hold all the way are
+	// solved the way auto does it
+	IKSolver used = solver;
+	if (used == IKSolver::FABRIK && limit_count > 0 && limit_every_step) {
+		used = IKSolver::Auto;
+	}
+
+	switch (used) {
+	case IKSolver::Auto:
+		if (joints.size() == 3) {
+			result = solveTwoBone(target, epsilon);
+			// the limits of the root can still clamp it, ccd carries on from there
+			if (!result.converged) {
+				result = solveCCD(target, max_iterations, epsilon, deadline_us);
+			}
+			break;
+		}
+		result = solveCCD(target, max_iterations, epsilon, deadline_us);
+		break;
+	case IKSolver::TwoBone:
+		if (joints.size() == 3) {
+			result = solveTwoBone(target, epsilon);
+			break;
+		}
+		result = solveCCD(target, max_iterations, epsilon, deadline_us);
+		break;
+	case IKSolver::FABRIK:
+		result = solveFABRIK(target, max_iterations, epsilon, deadline_us);
+		break;
+	default:
+		result = solveCCD(target, max_iterations, epsilon, deadline_us);
+		break;
+	}
+
+	for (size_t i = 0; i < deltas.size(); ++i) {
+		warm_deltas[i] = deltas[i].Norm();
+	}
+	has_warm_start = true;
+	return result;
+}
+
+void IKChain::randomPose(uint32_t &state) {
+	const int count = (int)joints.size();
+	for (int i = 0; i + 1 < count; ++i) {
+		gef::Vector4 axis(randFloat(state, -1.f, 1.f), randFloat(state, -1.f, 1.f), randFloat(state, -1.f, 1.f));
+		if (axis.LengthSqr() < 1e-6f) {
+			continue;
+		}
+		gef::Quaternion rotation(axis.Normalised(), randFloat(state, 0.f, gef::pi));
+
+		const gef::Vector4 pivot = positions[i];
+		for (int j = i + 1; j < count; ++j) {
+			positions[j] = pivot + gef::Quaternion::Rotate(rotation, positions[j] - pivot);
+		}
+		for (int j = i; j < count; ++j) {
+			deltas[j] = deltas[j] * rotation;
+		}
+		applyLimit(i);
+	}
+}
+
+void IKChain::setPole(const gef::Vector4 &position) {
+	pole_position = position;
+	has_pole = true;
+}
+
+void IKChain::setLimit(int index, const IKJointLimit &limit) {
+	if (index < 0 || index + 1 >= (int)joints.size()) {
+		return;
+	}
+
+	JointLimit &joint_limit = limits[index];
+	limit_count -= joint_limit.type != IKLimit::None;
+
+	joint_limit.type = limit.type;
+	joint_limit.min_angle = gef::min(limit.min_angle, limit.max_angle);
+	joint_limit.max_angle = gef::max(limit.min_angle, limit.max_angle);
+	joint_limit.twist = fabsf(limit.twist);
+	joint_limit.axis = bind_bones[index];
+
+	if (limit.type == IKLimit::Hinge) {
+		joint_limit.axis = gef::Quaternion::Rotate(inverse(bind_rotations[index]), limit.axis);
+		if (joint_limit.axis.LengthSqr() < 1e-12f) {
+			warn("ik chain: the hinge of joint %d has no axis", joints[index]);
+			joint_limit.type = IKLimit::None;
+		}
+		else {
+			joint_limit.axis.Normalise();
+		}
+	}
+
+	limit_count += joint_limit.type != IKLimit::None;
+}
+
+void IKChain::clearLimits() {
+	for (JointLimit &limit : limits) {
+		limit.type = IKLimit::None;
+	}
+	limit_count = 0;
+}
+
+void IKChain::applyLimit(int index) {
+	const JointLimit &limit = limits[index];
+	if (limit.type == IKLimit::None) {
+		return;
+	}
+
+	gef::Quaternion parent_delta = index > 0 ? deltas[index - 1] : gef::Quaternion::kIdentity;
+	gef::Quaternion parent = parent_rotations[index] * parent_delta;
+	gef::Quaternion rotation = start_rotations[index] * deltas[index];
+	// what the solver turned the joint to, relative to the bind pose in the space of the joint
+	gef::Quaternion offset = (rotation * inverse(parent) * inverse(rest_rotations[index])).Norm();
+	gef::Quaternion limited;
+
+	if (limit.type == IKLimit::Hinge) {
+		// only the part around the axis is kept
+		float angle = getAngleAround(getTwist(offset, limit.axis), limit.axis);
+		limited = gef::Quaternion(limit.axis, gef::clamp(angle, limit.min_angle, limit.max_angle));
+	}
+	else {
+		gef::Quaternion twist = getTwist(offset, limit.axis);
+		gef::Quaternion swing = inverse(twist) * offset;
+		float twist_angle = getAngleAround(twist, limit.axis);
+		float swing_angle = 2.f * acosf(gef::min(fabsf(swing.w), 1.f));
+		if (fabsf(twist_angle) <= limit.twist && swing_angle <= limit.max_angle) {
+			return;
+		}
+
+		twist = gef::Quaternion(limit.axis, gef::clamp(twist_angle, -limit.twist, limit.twist));
+		if (swing_angle > limit.max_angle) {
+			gef::Vector4 swing_axis(swing.x, swing.y, swing.z);
+			if (swing.w < 0.f) {
+				swing_axis = -swing_axis;
+			}
+			swing = gef::Quaternion(swing_axis.Normalised(), limit.max_angle);
+		}
+		limited = twist * swing;
+	}
+
+	// the model space rotation that takes the joint from where it is to inside the limit
+	gef::Quaternion correction = (inverse(rotation) * limited * rest_rotations[index] * parent).Norm();
+	if (fabsf(correction.w) >= 1.f - 1e-7f) {
+		return;
+	}
+
+	const int count = (int)joints.size();
+	const gef::Vector4 pivot = positions[index];
+	for (int j = index + 1; j < count; ++j) {
+		positions[j] = pivot + gef::Quaternion::Rotate(correction, positions[j] - pivot);
+	}
+	for (int j = index; j < count; ++j) {
+		deltas[j] = deltas[j] * correction;
+	}
+}
+
+void IKChain::clampResult(const gef::Vector4 &target, float epsilon, IKResult &result) {
+	const gef::Vector4 solved = positions.back();
+	applyLimits();
+
+	// if the clamp moved the end effector the solver stopped somewhere the chain can't go
+	result.distance = (target - positions.back()).Length();
+	result.reached = result.distance <= epsilon;
+	result.converged = result.converged && (positions.back() - solved).LengthSqr() <= epsilon * epsilon;
+}
+
+void IKChain::applyLimits() {
+	for (int i = 0; i + 1 < (int)joints.size(); ++i) {
+		applyLimit(i);
+	}
+}
+
+void IKChain::findRotations(int first) {
+	const int count = (int)joints.size();
+
+	// every joint turns its bone from where the joints before it left it to the new position
+	gef::Quaternion parent_delta = first > 0 ? deltas[first - 1] : gef::Quaternion::kIdentity;
+	for (int i = first; i < count - 1; ++i) {
+		gef::Vector4 before = gef::Quaternion::Rotate(parent_delta, start_positions[i + 1] - start_positions[i]);
+		gef::Vector4 after = positions[i + 1] - positions[i];
+		deltas[i] = parent_delta * rotationBetween(before, after);
+		parent_delta = deltas[i];
+	}
+	deltas[count - 1] = parent_delta;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <system/vec.h>
+#include <maths/vector4.h>
+#include <maths/quaternion.h>
+#include <animation/skeleton.h>
+
+enum class IKSolver : uint8_t {
+	Auto,    // two bone for chains of three joints, ccd for the rest or when the limits clamp two bone
+	CCD,     // rotates one joint at a time towards the target
+	FABRIK,  // moves the joint positions back and forth, rotations are found at the end. with
+	         // limits that hold every step it's solved like auto, fabrik can only clamp
+	TwoBone, // law of cosines, only for chains of three joints
+	Count
+};
+
+const char *getIKSolverName(IKSolver solver);
+
+enum class IKLimit : uint8_t {
+	None,
+	Hinge, // only turns around one axis, between two angles
+	Cone,  // the bone stays in a cone and can only twist around itself so much
+	Count
+};
+
+const char *getIKLimitName(IKLimit limit);
+
+// how far a joint can turn away from its rotation in the bind pose
+struct IKJointLimit {
+	IKLimit type = IKLimit::None;
+	// hinge axis, in model space in the bind pose. the cone is always around the bone
+	gef::Vector4 axis = gef::Vector4(1.f, 0.f, 0.f);
+	// radians. hinge: range of the angle around the axis. cone: max_angle is half the cone
+	float min_angle = 0.f;
+	float max_angle = 0.f;
+	// cone only, radians either way
+	float twist = 0.f;
+};
+
+struct IKResult {
+	int iterations = 0;
+	float distance = 0.f; // from the end effector to the target when the solver stopped
+	bool reached = false;
+	// it reached the target or stopped getting closer, more iterations wouldn't help
+	bool converged = false;
+	// it stopped at the deadline, the next solve can carry on from here with a warm start
+	bool out_of_time = false;
+	// the target didn't move since the last solve, its solution was used again
+	bool skipped = false;
+};
+
+// one chain of joints, from the root to the end effector. the solvers only work on
+// the arrays of the chain, in model space, and never touch the matrices of the pose
+class IKChain {
+public:
+	// <joints> go from the root to the end effector, every joint has to be
+	// below the previous one. returns false if they aren't
+	bool init(const gef::Skeleton &skeleton, const int *joints, size_t count);
+	void clear();
+
+	// limit of the joint at <index> in the chain. the end effector has none, its
+	// rotation doesn't move the chain. ccd keeps to them after every step unless
+	// limit_every_step is off, fabrik only clamps its result. two bone bends around
+	// a hinge in the middle joint and clamps the rest of its result
+	void setLimit(int index, const IKJointLimit &limit);
+	void clearLimits();
+	bool hasLimits() const { return limit_count > 0; }
+
+	// copies the positions of the chain out of the global pose, which has to be up to date.
+	// with <warm_start> the rotations of the last solve are put back on top of the pose,
+	// so the solver starts from where it got to instead of from the pose
+	void begin(const gef::SkeletonPose &pose, bool warm_start = false);
+	// writes the local rotations of the chain joints, blended by <weight> with the ones
+	// in the pose, and updates the global pose of the subtree of the root of the chain.
+	// on a depth first skeleton the rest of the pose isn't touched, so chains with
+	// separate subtrees can be applied at the same time
+	void apply(gef::SkeletonPose &pose, float weight = 1.f) const;
+
+	// <deadline_us> is a time from timeNowUs, the iterative solvers stop after the
+	// iteration that goes past it. 0 means no deadline
+
+	// cyclic coordinate descent, <target> is in model space. every step rotates one joint
+	// so the end effector points at the target and moves the joints after it with it
+	IKResult solveCCD(const gef::Vector4 &target, int max_iterations, float epsilon, double deadline_us = 0.0);
+	// forward and backward reaching, it only moves the positions keeping the bone
+	// lengths and then finds the rotation of every joint once, root first. the limits
+	// are applied to the result, solve() uses two bone or ccd when they have to hold
+	IKResult solveFABRIK(const gef::Vector4 &target, int max_iterations, float epsilon, double deadline_us = 0.0);
+	// closed form for chains of three joints, no iterations. the middle joint bends
+	// towards the pole if there is one, otherwise around its hinge if it has one or on
+	// the side it's already on. it hasn't converged if the limits moved the end effector
+	IKResult solveTwoBone(const gef::Vector4 &target, float epsilon);
+	// with the solver of the chain, the result is kept for the next warm start
+	IKResult solve(const gef::Vector4 &target, int max_iterations, float epsilon, double deadline_us = 0.0);
+	// turns every joint of the chain by a random rotation from <state> and clamps it to its
+	// limit, so the end effector is somewhere the chain can reach. begin has to be called first
+	void randomPose(uint32_t &state);
+	bool hasWarmStart() const { return has_warm_start; }
+	void resetWarmStart() { has_warm_start = false; }
+
+	// model space position the middle joint of a two bone chain bends towards
+	void setPole(const gef::Vector4 &position);
+	void clearPole() { has_pole = false; }
+	bool hasPole() const { return has_pole; }
+	const gef::Vector4 &getPole() const { return pole_position; }
+
+	IKSolver solver = IKSolver::Auto;
+	// off, ccd solves without the limits and only clamps the result, like fabrik always
+	// does. it's cheaper but the clamp can leave the end effector far from the target
+	bool limit_every_step = true;
+
+	const gef::Vec<Int32> &getJoints() const { return joints; }
+	Int32 getRoot() const { return joints[0]; }
+	const gef::Vector4 &getEndEffector() const { return positions.back(); }
+	// sum of the bone lengths, how far from the root the chain can reach
+	float getLength() const { return length; }
+	size_t size() const { return joints.size(); }
+	bool empty() const { return joints.empty(); }
+
+private:
+	// the rotations of the joints from <first> on, from the positions the solver left them in
+	void findRotations(int first);
+	// turns the joint at <index> back inside its limit, with the joints after it
+	void applyLimit(int index);
+	void applyLimits();
+	// clamps a result that didn't keep to the limits and updates <result> for it
+	void clampResult(const gef::Vector4 &target, float epsilon, IKResult &result);
+
+	// a limit in the space of the joint in the bind pose, the axis is the hinge or the bone
+	struct JointLimit {
+		gef::Vector4 axis;
+		float min_angle;
+		float max_angle;
+		float twist;
+		IKLimit type;
+	};
+
+	gef::Vec<Int32> joints;
+	gef::Vec<gef::Vector4> positions;
+	// where the joints were when begin was called, fabrik rotates from these
+	gef::Vec<gef::Vector4> start_positions;
+	// from each joint to the next one
+	gef::Vec<float> lengths;
+	// rotation the solver added to each joint in model space, it includes
+	// the ones added to the joints before it
+	gef::Vec<gef::Quaternion> deltas;
+	// model space rotation of the parent of each joint when begin was called
+	gef::Vec<gef::Quaternion> parent_rotations;
+	// model space rotation of each joint when begin was called
+	gef::Vec<gef::Quaternion> start_rotations;
+	// deltas of the last solve
+	gef::Vec<gef::Quaternion> warm_deltas;
+	// == bind pose, for the limits ==
+	gef::Vec<JointLimit> limits;
+	gef::Vec<gef::Quaternion> bind_rotations; // model space
+	gef::Vec<gef::Quaternion> rest_rotations; // local
+	gef::Vec<gef::Vector4> bind_bones;        // to the next joint, in the space of the joint
+	int limit_count = 0;
+	bool has_warm_start = false;
+	float length = 0.f;
+	gef::Vector4 pole_position = gef::Vector4::kZero;
+	bool has_pole = false;
+};
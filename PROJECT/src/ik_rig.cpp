@@ -0,0 +1,304 @@
+#include "ik_rig.h"
+
+#include <algorithm>
+
+#include "utils.h"
+
+int IKRig::addChain(const char *name, const gef::Vec<std::string> &joint_names) {
+	IKRigChain chain;
+	chain.name = name;
+	chain.joint_names = joint_names;
+	chains.push_back(chain);
+	return (int)chains.size() - 1;
+}
+
+void IKRig::removeChain(int index) {
+	chains.erase((size_t)index);
+	order.clear();
+	independent_count = 0;
+}
+
+void IKRig::clear() {
+	chains.clear();
+	order.clear();
+	independent_count = 0;
+	can_use_jobs = true;
+}
+
+bool IKRig::build(const gef::Skeleton &skeleton, const std::unordered_map<std::string, int> &joint_map) {
+	order.clear();
+	independent_count = 0;
+	can_use_jobs = true;
+	frame_stats = Stats();
+	total_stats = Stats();
+
+	bool all_found = true;
+	gef::Vec<int> joints;
+
+	for (int i = 0; i < (int)chains.size(); ++i) {
+		IKRigChain &rig_chain = chains[i];
+		rig_chain.chain.clear();
+		rig_chain.depends_on = -1;
+		rig_chain.result = IKResult();
+
+		joints.clear();
+		for (const std::string &joint_name : rig_chain.joint_names) {
+			auto it = joint_map.find(joint_name);
+			if (it == joint_map.end()) {
+				warn("ik rig: chain %s has joint %s that isn't in the skeleton", rig_chain.name.c_str(), joint_name.c_str());
+				break;
+			}
+			joints.push_back(it->second);
+		}
+
+		if (joints.size() != rig_chain.joint_names.size() || !rig_chain.chain.init(skeleton, joints.data(), joints.size())) {
+			all_found = false;
+			continue;
+		}
+
+		int limit_count = gef::min((int)rig_chain.limits.size(), (int)joints.size());
+		for (int j = 0; j < limit_count; ++j) {
+			rig_chain.chain.setLimit(j, rig_chain.limits[j]);
+		}
+		order.push_back(i);
+	}
+
+	// parents always have a lower index than their children, so sorting by the root
+	// puts every chain after the ones above it
+	std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+		return chains[a].chain.getRoot() < chains[b].chain.getRoot();
+	});
+
+	// last chain found so far with its root on each joint
+	gef::Vec<int> chain_at_joint;
+	chain_at_joint.resize(skeleton.joint_count(), -1);
+	gef::Vec<int> dependent_count;
+	dependent_count.resize(chains.size(), 0);
+
+	for (int index : order) {
+		IKRigChain &rig_chain = chains[index];
+		Int32 joint = rig_chain.chain.getRoot();
+
+		int depends_on = chain_at_joint[joint];
+		for (Int32 parent = skeleton.joint(joint).parent; depends_on < 0 && parent >= 0; parent = skeleton.joint(parent).parent) {
+			depends_on = chain_at_joint[parent];
+		}
+
+		rig_chain.depends_on = depends_on;
+		chain_at_joint[joint] = index;
+
+		if (depends_on < 0) {
+			independent_count++;
+		}
+		else if (++dependent_count[depends_on] > (int)gef::Job::max_continuations) {
+			can_use_jobs = false;
+		}
+	}
+
+	if (!can_use_jobs) {
+		warn("ik rig: a chain has more than %u chains below it, solving on one thread", gef::Job::max_continuations);
+	}
+
+	// the chains only stay out of each other's way if every subtree is a separate range of joints
+	if (!skeleton.depth_first()) {
+		warn("ik rig: the skeleton isn't stored depth first, solving on one thread");
+		can_use_jobs = false;
+	}
+
+	return all_found;
+}
+
+void IKRig::setTarget(int index, const gef::Vector4 &target) {
+	chains[index].target = target;
+	chains[index].has_target = true;
+}
+
+void IKRig::solve(gef::SkeletonPose &pose, int max_iterations, float epsilon, gef::JobSystem *jobs) {
+	solve_pose = &pose;
+	solve_max_iterations = max_iterations;
+	solve_epsilon = epsilon;
+	solve_deadline_us = time_budget_us > 0.f ? timeNowUs() + time_budget_us : 0.0;
+
+	if (!jobs || !can_use_jobs || order.size() < 2) {
+		for (int index : order) {
+			solveChain(index);
+		}
+	}
+	else {
+		solveJobs(*jobs);
+	}
+	solve_pose = nullptr;
+
+	frame_stats = Stats();
+	for (int index : order) {
+		const IKRigChain &rig_chain = chains[index];
+		if (!rig_chain.enabled || !rig_chain.has_target) {
+			continue;
+		}
+		const IKResult &result = rig_chain.result;
+		frame_stats.solved += !result.skipped;
+		frame_stats.skipped += result.skipped;
+		frame_stats.out_of_time += result.out_of_time;
+		frame_stats.iterations += result.skipped ? 0 : result.iterations;
+	}
+
+	total_stats.solved += frame_stats.solved;
+	total_stats.skipped += frame_stats.skipped;
+	total_stats.out_of_time += frame_stats.out_of_time;
+	total_stats.iterations += frame_stats.iterations;
+}
+
+void IKRig::solveJobs(gef::JobSystem &jobs) {
+	// a job per chain, even for the ones that are skipped, so the dependencies stay the same
+	gef::Vec<gef::Job *> chain_jobs;
+	chain_jobs.resize(chains.size(), nullptr);
+
+	gef::Job *root = jobs.create(nullptr, nullptr);
+	for (int index : order) {
+		chain_jobs[index] = jobs.create(solveJob, this, (uint32_t)index, (uint32_t)index + 1, root);
+		int depends_on = chains[index].depends_on;
+		if (depends_on >= 0) {
+			jobs.addDependency(chain_jobs[index], chain_jobs[depends_on]);
+		}
+	}
+	for (int index : order) {
+		jobs.run(chain_jobs[index]);
+	}
+
+	jobs.run(root);
+	jobs.wait(root);
+}
+
+void IKRig::solveChain(int index) {
+	IKRigChain &rig_chain = chains[index];
+	float chain_weight = rig_chain.weight * weight;
+	if (!rig_chain.enabled || !rig_chain.has_target || chain_weight <= 0.f) {
+		return;
+	}
+
+	IKChain &chain = rig_chain.chain;
+	chain.solver = rig_chain.solver;
+	if (rig_chain.has_pole) chain.setPole(rig_chain.pole);
+	else                    chain.clearPole();
+
+	bool warm = warm_start && chain.hasWarmStart();
+	chain.begin(*solve_pose, warm);
+
+	// the pose under the chain can change too (a chain above it or the animation), so
+	// the last solution also has to still end up about as close as it did
+	bool target_moved = (rig_chain.target - rig_chain.solved_target).Length() > early_out_distance;
+	bool pose_moved = (rig_chain.target - chain.getEndEffector()).Length() > rig_chain.result.distance + early_out_distance;
+
+	if (warm && !target_moved && !pose_moved && rig_chain.result.converged) {
+		rig_chain.result.skipped = true;
+	}
+	else {
+		rig_chain.result = chain.solve(rig_chain.target, solve_max_iterations, solve_epsilon, solve_deadline_us);
+		rig_chain.solved_target = rig_chain.target;
+	}
+	chain.apply(*solve_pose, gef::min(chain_weight, 1.f));
+}
+
+void IKRig::solveJob(void *user_data, uint32_t begin, uint32_t end) {
+	IKRig *rig = (IKRig *)user_data;
+	for (uint32_t i = begin; i < end; ++i) {
+		rig->solveChain((int)i);
+	}
+}
+
+void IKRig::save(FILE *fp) const {
+	if (!fp) return;
+
+	fileWrite((uint8_t)chains.size(), fp);
+	for (const IKRigChain &chain : chains) {
+		fileWrite((uint8_t)chain.name.size(), fp);
+		fileWrite(chain.name, fp);
+		fileWrite((uint8_t)chain.joint_names.size(), fp);
+		for (const std::string &joint_name : chain.joint_names) {
+			fileWrite((uint8_t)joint_name.size(), fp);
+			fileWrite(joint_name, fp);
+		}
+		fileWrite(chain.solver, fp);
+		fileWrite(chain.weight, fp);
+		fileWrite(chain.enabled, fp);
+		fileWrite(chain.has_target, fp);
+		fileWrite(chain.target, fp);
+		fileWrite(chain.has_pole, fp);
+		fileWrite(chain.pole, fp);
+		fileWrite((uint8_t)chain.limits.size(), fp);
+		for (const IKJointLimit &limit : chain.limits) {
+			fileWrite(limit.type, fp);
+			fileWrite(limit.axis, fp);
+			fileWrite(limit.min_angle, fp);
+			fileWrite(limit.max_angle, fp);
+			fileWrite(limit.twist, fp);
+		}
+	}
+}
+
+bool IKRig::read(FILE *fp, uint8_t version) {
+	clear();
+	if (!fp) return false;
+
+	uint8_t chain_count = 0;
+	if (!fileRead(chain_count, fp)) {
+		return false;
+	}
+
+	chains.resize(chain_count, IKRigChain());
+	for (IKRigChain &chain : chains) {
+		uint8_t name_len = 0;
+		uint8_t joint_count = 0;
+
+		fileRead(name_len, fp);
+		chain.name.resize(name_len);
+		fileRead(chain.name, fp);
+
+		fileRead(joint_count, fp);
+		chain.joint_names.resize(joint_count, std::string());
+		for (std::string &joint_name : chain.joint_names) {
+			uint8_t joint_name_len = 0;
+			fileRead(joint_name_len, fp);
+			joint_name.resize(joint_name_len);
+			fileRead(joint_name, fp);
+		}
+
+		fileRead(chain.solver, fp);
+		fileRead(chain.weight, fp);
+		fileRead(chain.enabled, fp);
+		fileRead(chain.has_target, fp);
+		fileRead(chain.target, fp);
+		fileRead(chain.has_pole, fp);
+		if (!fileRead(chain.pole, fp)) {
+			clear();
+			return false;
+		}
+
+		if ((uint8_t)chain.solver >= (uint8_t)IKSolver::Count) {
+			chain.solver = IKSolver::Auto;
+		}
+
+		if (version < 2) {
+			continue;
+		}
+
+		uint8_t limit_count = 0;
+		fileRead(limit_count, fp);
+		chain.limits.resize(limit_count, IKJointLimit());
+		for (IKJointLimit &limit : chain.limits) {
+			fileRead(limit.type, fp);
+			fileRead(limit.axis, fp);
+			fileRead(limit.min_angle, fp);
+			fileRead(limit.max_angle, fp);
+			if (!fileRead(limit.twist, fp)) {
+				clear();
+				return false;
+			}
+			if ((uint8_t)limit.type >= (uint8_t)IKLimit::Count) {
+				limit.type = IKLimit::None;
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+
+#include <system/vec.h>
+#include <system/job_system.h>
+#include <maths/vector4.h>
+#include <animation/skeleton.h>
+
+#include "ik_chain.h"
+
+// one chain of the rig. the joints are kept by name so the rig can be saved
+// and used with any skeleton that has them
+struct IKRigChain {
+	std::string name;
+	gef::Vec<std::string> joint_names; // from the root to the end effector
+	IKSolver solver = IKSolver::Auto;
+	float weight = 1.f;
+	bool enabled = true;
+	// model space, the chain isn't solved until it has one
+	gef::Vector4 target = gef::Vector4::kZero;
+	bool has_target = false;
+	gef::Vector4 pole = gef::Vector4::kZero;
+	bool has_pole = false;
+	// one for each joint, or empty for a chain without limits
+	gef::Vec<IKJointLimit> limits;
+
+	// == filled by build ==
+	IKChain chain;
+	// closest chain that moves the root of this one, it's solved first
+	int depends_on = -1;
+	IKResult result;
+	// target of the last solve, used for the early out
+	gef::Vector4 solved_target = gef::Vector4::kZero;
+};
+
+// a set of chains solved on the same pose. chains that don't move each other (two hands
+// and two feet) are independent and can be solved at the same time on the job system,
+// a chain below another one (a hand below the spine) waits for it
+class IKRig {
+public:
+	// returns the index of the new chain, build has to be called again before solving
+	int addChain(const char *name, const gef::Vec<std::string> &joint_names);
+	void removeChain(int index);
+	void clear();
+
+	// finds the joints of every chain with <joint_map> and the order they have to be
+	// solved in. chains with joints that aren't in the map are left empty and skipped
+	bool build(const gef::Skeleton &skeleton, const std::unordered_map<std::string, int> &joint_map);
+
+	void setTarget(int index, const gef::Vector4 &target);
+
+	// solves every enabled chain with a target on top of <pose>, which should be the pose
+	// without ik. with <jobs> every chain is a job that depends on the job of the chain above it
+	void solve(gef::SkeletonPose &pose, int max_iterations, float epsilon, gef::JobSystem *jobs = nullptr);
+
+	// multiplies the weight of every chain
+	float weight = 1.f;
+	// every chain starts from the solution of the last solve
+	bool warm_start = true;
+	// a converged chain whose target moved less than this isn't solved again, the last
+	// solution is applied as it is. only with warm start
+	float early_out_distance = 0.01f;
+	// microseconds for all the chains, once it runs out the chains stop after their
+	// current iteration and carry on in the next solve. 0 means no budget
+	float time_budget_us = 0.f;
+
+	struct Stats {
+		int solved = 0;
+		int skipped = 0;
+		int out_of_time = 0;
+		int iterations = 0;
+	};
+	// of the last solve
+	const Stats &getFrameStats() const { return frame_stats; }
+	// since the rig was built or the stats were reset
+	const Stats &getTotalStats() const { return total_stats; }
+	void resetStats() { total_stats = Stats(); }
+
+	// version 2 added the joint limits
+	static constexpr uint8_t format_ver = 2;
+
+	void save(FILE *fp) const;
+	// <version> is the one the rig was saved with
+	bool read(FILE *fp, uint8_t version = format_ver);
+
+	IKRigChain &getChain(int index) { return chains[index]; }
+	const IKRigChain &getChain(int index) const { return chains[index]; }
+	int getChainCount() const { return (int)chains.size(); }
+	// number of chains that can be solved at the same time at the start of the solve
+	int getIndependentCount() const { return independent_count; }
+
+private:
+	void solveJobs(gef::JobSystem &jobs);
+	void solveChain(int index);
+	static void solveJob(void *user_data, uint32_t begin, uint32_t end);
+
+	gef::Vec<IKRigChain> chains;
+	// parents before children, solving in this order respects every dependency
+	gef::Vec<int> order;
+	int independent_count = 0;
+	// false if a chain has more chains below it than a job can have continuations
+	bool can_use_jobs = true;
+
+	Stats frame_stats;
+	Stats total_stats;
+
+	// == only valid while solving ==
+	gef::SkeletonPose *solve_pose = nullptr;
+	int solve_max_iterations = 0;
+	float solve_epsilon = 0.f;
+	double solve_deadline_us = 0.0;
+};
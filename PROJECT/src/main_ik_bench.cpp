@@ -0,0 +1,362 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <platform/linux_null/system/platform_linux_null.h>
+#include <graphics/renderer_3d.h>
+#include <graphics/skinned_mesh_instance.h>
+#include <animation/joint.h>
+#include <maths/math_utils.h>
+#include <system/allocator.h>
+#include <system/string_id.h>
+
+#include "anim_system_3d.h"
+#include "anim_system_ik.h"
+#include "clip_library.h"
+#include "ik_rig.h"
+#include "utils.h"
+
+// solves every chain of the ik rig for the same targets with each solver, from the bind
+// pose every time, and writes how close and how fast they got to a csv file.
+// it has to be started from the media folder, like the windows build. xbot is in git lfs,
+// if it wasn't pulled a made up skeleton with the same joint names is used instead.
+// usage: ik_bench <csv file> [targets per set]
+
+// the same as the ik system, model space is in centimetres
+static constexpr int max_iterations = 200;
+static constexpr float epsilon = 0.01f;
+
+// == SKELETON ==
+
+struct BenchSkeleton {
+	const char *name = nullptr;
+	const gef::Skeleton *skeleton = nullptr;
+	gef::SkeletonPose bind_pose;
+	gef::Matrix44 model_to_world;
+	IKRig rig;
+};
+
+// stands in for xbot: same proportions and joint names, facing +z with the arms along x,
+// so the preset rig of the ik system fits it
+struct FallbackJoint {
+	const char *name;
+	int parent;
+	float x, y, z;
+};
+
+static const FallbackJoint fallback_joints[] = {
+	{ "Hips",         -1,    0.f, 100.f, 0.f },
+	{ "Spine",         0,    0.f, 115.f, 0.f },
+	{ "Spine1",        1,    0.f, 125.f, 0.f },
+	{ "Spine2",        2,    0.f, 135.f, 0.f },
+	{ "Neck",          3,    0.f, 155.f, 0.f },
+	{ "LeftArm",       3,   15.f, 150.f, 0.f },
+	{ "LeftForeArm",   5,   43.f, 150.f, 0.f },
+	{ "LeftHand",      6,   70.f, 150.f, 0.f },
+	{ "RightArm",      3,  -15.f, 150.f, 0.f },
+	{ "RightForeArm",  8,  -43.f, 150.f, 0.f },
+	{ "RightHand",     9,  -70.f, 150.f, 0.f },
+	{ "LeftUpLeg",     0,   10.f,  95.f, 0.f },
+	{ "LeftLeg",      11,   10.f,  52.f, 2.f },
+	{ "LeftFoot",     12,   10.f,   8.f, 0.f },
+	{ "RightUpLeg",    0,  -10.f,  95.f, 0.f },
+	{ "RightLeg",     14,  -10.f,  52.f, 2.f },
+	{ "RightFoot",    15,  -10.f,   8.f, 0.f },
+};
+
+static void makeFallbackSkeleton(gef::Skeleton &skeleton, std::unordered_map<std::string, int> &joint_map) {
+	for (const FallbackJoint &fallback : fallback_joints) {
+		gef::Joint joint;
+		joint.name_id = gef::GetStringId(fallback.name);
+		joint.parent = fallback.parent;
+		// no rotations in the bind pose, only where the joint is
+		joint.inv_bind_pose.SetIdentity();
+		joint.inv_bind_pose.SetTranslation(gef::Vector4(-fallback.x, -fallback.y, -fallback.z));
+		joint_map[fallback.name] = skeleton.joint_count();
+		skeleton.AddJoint(joint);
+	}
+}
+
+// == TARGETS ==
+
+struct Camera {
+	gef::Matrix44 view;
+	gef::Matrix44 projection;
+	gef::Vector4 eye;
+	gef::Vector2 screen_size;
+};
+
+static gef::Vector2 worldToScreen(const Camera &camera, const gef::Vector4 &point) {
+	gef::Vector4 clip = gef::Vector4(point.x(), point.y(), point.z(), 1.f).TransformW(camera.view * camera.projection);
+	gef::Vector2 half_sz = camera.screen_size / 2.f;
+	return {
+		half_sz.x + half_sz.x * clip.x() / clip.w(),
+		half_sz.y - half_sz.y * clip.y() / clip.w(),
+	};
+}
+
+// model space targets for <chain>. reachable ones are where the end effector is in random
+// poses inside the limits of the chain. unreachable ones are picked on the screen around the
+// root, on planes facing the camera, past the length of the chain
+static void makeTargets(const BenchSkeleton &bench, const Camera &camera, IKChain chain, int count, gef::Vec<gef::Vector4> &reachable, gef::Vec<gef::Vector4> &unreachable) {
+	reachable.clear();
+	unreachable.clear();
+
+	uint32_t state = 0x2545f491u;
+	for (int i = 0; i < count; ++i) {
+		chain.begin(bench.bind_pose);
+		chain.randomPose(state);
+		reachable.push_back(chain.getEndEffector());
+	}
+
+	// the length of the chain is measured from the pose
+	chain.begin(bench.bind_pose);
+
+	gef::Matrix44 world_to_model;
+	world_to_model.Inverse(bench.model_to_world);
+
+	gef::Vector4 root = bench.bind_pose.global_pose()[chain.getRoot()].GetTranslation();
+	gef::Vector4 world_root = root.Transform(bench.model_to_world);
+	gef::Vector4 normal = (camera.eye - world_root).Normalised();
+	// the length of the chain in world space, the model can be scaled
+	gef::Vector4 world_tip = (root + gef::Vector4(chain.getLength(), 0.f, 0.f)).Transform(bench.model_to_world);
+	float world_length = (world_tip - world_root).Length();
+
+	// twice the length of the chain around the root on the screen, the ones it can reach are skipped
+	gef::Vector2 centre = worldToScreen(camera, world_root);
+	gef::Vector4 side = normal.CrossProduct(gef::Vector4(0.f, 1.f, 0.f)).Normalised();
+	float radius = (worldToScreen(camera, world_root + side * world_length * 2.f) - centre).Length();
+
+	for (int tries = 0; tries < count * 100 && (int)unreachable.size() < count; ++tries) {
+		gef::Vector2 screen_pos = centre + gef::Vector2(randFloat(state, -radius, radius), randFloat(state, -radius, radius));
+		gef::Vector4 plane_point = world_root + normal * randFloat(state, -0.5f, 0.5f) * world_length;
+
+		gef::Vector4 start, direction, hit;
+		getScreenPosRay(screen_pos, camera.projection, camera.view, start, direction, camera.screen_size);
+		if (!rayPlaneIntersect(start, direction, plane_point, normal, hit)) {
+			continue;
+		}
+
+		gef::Vector4 target = hit.Transform(world_to_model);
+		if ((target - root).Length() >= chain.getLength() * 1.1f) {
+			unreachable.push_back(target);
+		}
+	}
+}
+
+// == SOLVING ==
+
+struct BenchResult {
+	std::string chain;
+	const char *solver;
+	const char *limits; // no, every step or only clamping the result
+	const char *set;
+	int solves = 0;
+	int reached = 0;
+	// the error is within epsilon of the best the chain could do without limits: none
+	// inside its length, the distance past it for the unreachable ones
+	int converged = 0;
+	int invalid = 0; // the pose came out with nans
+	double error = 0.0;
+	float max_error = 0.f;
+	double iterations = 0.0;
+	int max_iterations = 0;
+	double solve_us = 0.0;
+};
+
+static void runSet(const BenchSkeleton &bench, IKChain chain, const gef::Vec<gef::Vector4> &targets, BenchResult &result) {
+	gef::SkeletonPose pose = bench.bind_pose;
+	Int32 end_effector = chain.getJoints().back();
+	gef::Vector4 root = bench.bind_pose.global_pose()[chain.getRoot()].GetTranslation();
+
+	for (const gef::Vector4 &target : targets) {
+		pose = bench.bind_pose;
+
+		double start = timeNowUs();
+		chain.begin(pose);
+		IKResult solve = chain.solve(target, max_iterations, epsilon);
+		chain.apply(pose);
+		result.solve_us += timeNowUs() - start;
+
+		// the error of the pose, not what the solver thinks it is
+		float error = (target - pose.global_pose()[end_effector].GetTranslation()).Length();
+		if (!isfinite(error)) {
+			result.invalid++;
+			continue;
+		}
+
+		result.solves++;
+		// what the solvers report as converged only means they stopped getting closer
+		float best_error = gef::max((target - root).Length() - chain.getLength(), 0.f);
+		result.reached += solve.reached;
+		result.converged += error <= best_error + epsilon;
+		result.error += error;
+		result.max_error = gef::max(result.max_error, error);
+		result.iterations += solve.iterations;
+		result.max_iterations = gef::max(result.max_iterations, solve.iterations);
+	}
+}
+
+static void runBenchmark(const BenchSkeleton &bench, const Camera &camera, int targets, gef::Vec<BenchResult> &results) {
+	struct Row {
+		IKSolver solver;
+		bool limits;
+		bool every_step;
+	};
+	// two bone always clamps its result, the others are also run without the limits
+	// and clamped once at the end to compare with keeping to them on the way
+	const Row rows[] = {
+		{ IKSolver::CCD,     false, false },
+		{ IKSolver::FABRIK,  false, false },
+		{ IKSolver::TwoBone, false, false },
+		{ IKSolver::CCD,     true,  false },
+		{ IKSolver::FABRIK,  true,  false },
+		{ IKSolver::CCD,     true,  true },
+		{ IKSolver::FABRIK,  true,  true },
+		{ IKSolver::TwoBone, true,  true },
+	};
+
+	gef::Vec<gef::Vector4> reachable, unreachable;
+
+	for (int i = 0; i < bench.rig.getChainCount(); ++i) {
+		const IKRigChain &rig_chain = bench.rig.getChain(i);
+		if (rig_chain.chain.empty()) {
+			continue;
+		}
+
+		makeTargets(bench, camera, rig_chain.chain, targets, reachable, unreachable);
+
+		for (const Row &row : rows) {
+			// two bone falls back to ccd for longer chains, that's already measured
+			if (row.solver == IKSolver::TwoBone && rig_chain.chain.size() != 3) {
+				continue;
+			}
+			if (row.limits && !rig_chain.chain.hasLimits()) {
+				continue;
+			}
+
+			IKChain chain = rig_chain.chain;
+			chain.solver = row.solver;
+			chain.limit_every_step = row.every_step;
+			if (!row.limits) {
+				chain.clearLimits();
+			}
+
+			for (int set = 0; set < 2; ++set) {
+				BenchResult result;
+				result.chain = rig_chain.name;
+				result.solver = getIKSolverName(row.solver);
+				result.limits = !row.limits ? "no" : row.every_step ? "yes" : "clamp";
+				result.set = set == 0 ? "reachable" : "unreachable";
+				runSet(bench, chain, set == 0 ? reachable : unreachable, result);
+				results.push_back(result);
+			}
+		}
+	}
+}
+
+static bool writeCSV(const char *filename, const char *skeleton_name, const gef::Vec<BenchResult> &results) {
+	CFile fp(filename, "wb");
+	if (!fp) {
+		return false;
+	}
+
+	fprintf(fp, "skeleton,chain,solver,limits,targets,solves,reached,converged,invalid,mean_error,max_error,mean_iterations,max_iterations,us_per_solve\n");
+	for (const BenchResult &r : results) {
+		double per_solve = r.solves > 0 ? 1.0 / r.solves : 0.0;
+		double per_target = r.solves + r.invalid > 0 ? 1.0 / (r.solves + r.invalid) : 0.0;
+		fprintf(
+			fp, "%s,%s,%s,%s,%s,%d,%d,%d,%d,%f,%f,%f,%d,%f\n",
+			skeleton_name, r.chain.c_str(), r.solver, r.limits, r.set,
+			r.solves, r.reached, r.converged, r.invalid,
+			r.error * per_solve, r.max_error, r.iterations * per_solve, r.max_iterations,
+			r.solve_us * per_target
+		);
+	}
+	return true;
+}
+
+int main(int argc, char **argv) {
+	// no default for the csv, it's started from the media folder and would be left there
+	const char *csv_file = argc > 1 ? argv[1] : nullptr;
+	int targets = argc > 2 ? atoi(argv[2]) : 256;
+	if (!csv_file || targets <= 0) {
+		fprintf(stderr, "usage: %s <csv file> [targets per set]\n", argv[0]);
+		return 1;
+	}
+
+	gef::PlatformLinuxNull platform(960, 544);
+	gef::Renderer3D *renderer = gef::Renderer3D::Create(platform);
+
+	// the same camera as the app
+	Camera camera;
+	camera.eye = gef::Vector4(-1.f, 1.f, 4.f);
+	camera.view.LookAt(camera.eye, gef::Vector4(0.f, 1.f, 0.f), gef::Vector4(0.f, 1.f, 0.f));
+	camera.projection = platform.PerspectiveProjectionFov(gef::DegToRad(45.f), (float)platform.width() / (float)platform.height(), 0.01f, 1000.f);
+	camera.screen_size = platform.size();
+
+	gef::Matrix44 model_to_world;
+	model_to_world.Scale(gef::Vector4(0.01f, 0.01f, 0.01f));
+
+	BenchSkeleton bench;
+	bench.model_to_world = model_to_world;
+
+	AnimSystem3D anim3d;
+	anim3d.init(platform, renderer, "xbot/xbot.scn");
+	gef::Skeleton fallback_skeleton;
+
+	if (gef::SkinnedMeshInstance *skinned_mesh = anim3d.getSkinnedMesh()) {
+		bench.name = "xbot";
+		bench.bind_pose = skinned_mesh->bind_pose();
+		bench.skeleton = bench.bind_pose.skeleton();
+		AnimSystemIK::buildPresetRig(bench.rig, *bench.skeleton, anim3d.getJointMap());
+	}
+	else {
+		fprintf(stderr, "couldn't load xbot/xbot.scn, using a made up skeleton\n");
+		std::unordered_map<std::string, int> joint_map;
+		makeFallbackSkeleton(fallback_skeleton, joint_map);
+		bench.name = "fallback";
+		bench.skeleton = &fallback_skeleton;
+		bench.bind_pose.CreateBindPose(&fallback_skeleton);
+		AnimSystemIK::buildPresetRig(bench.rig, fallback_skeleton, joint_map);
+	}
+
+	// the first run only warms up the caches
+	gef::Vec<BenchResult> results;
+	runBenchmark(bench, camera, targets, results);
+	results.clear();
+	runBenchmark(bench, camera, targets, results);
+
+	printf("%s skeleton, %d targets per set, epsilon %.3f\n", bench.name, targets, epsilon);
+	printf("%-10s %-8s %-6s %-11s %9s %9s %10s %10s %8s\n", "chain", "solver", "limits", "set", "reached", "converged", "mean error", "iterations", "us/solve");
+	int invalid = 0;
+	for (const BenchResult &r : results) {
+		double per_solve = r.solves > 0 ? 1.0 / r.solves : 0.0;
+		double per_target = r.solves + r.invalid > 0 ? 1.0 / (r.solves + r.invalid) : 0.0;
+		printf(
+			"%-10s %-8s %-6s %-11s %8.1f%% %8.1f%% %10.3f %10.2f %8.2f\n",
+			r.chain.c_str(), r.solver, r.limits, r.set,
+			r.reached * per_solve * 100.0, r.converged * per_solve * 100.0,
+			r.error * per_solve, r.iterations * per_solve, r.solve_us * per_target
+		);
+		invalid += r.invalid;
+	}
+
+	bool written = writeCSV(csv_file, bench.name, results);
+	if (written) {
+		printf("written to %s\n", csv_file);
+	}
+	else {
+		fprintf(stderr, "couldn't write %s\n", csv_file);
+	}
+	if (invalid > 0) {
+		fprintf(stderr, "%d solves came out with nans\n", invalid);
+	}
+
+	bench.rig.clear();
+	anim3d.cleanup();
+	getClipLibrary().cleanup();
+	g_alloc->destroy(renderer);
+
+	return written && invalid == 0 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <platform/linux_null/system/platform_linux_null.h>
+#include <platform/linux_null/graphics/renderer_3d_null.h>
+#include <graphics/renderer_3d.h>
+#include <system/allocator.h>
+
+#include "anim_system_3d.h"
+#include "anim_system_ske2d.h"
+#include "anim_system_sprite.h"
+#include "batch2d.h"
+#include "clip_library.h"
+#include "utils.h"
+
+// runs the animation systems without a window and prints how long they took.
+// it has to be started from the media folder, like the windows build.
+// usage: anim_headless [frames]
+
+struct SystemTimings {
+	const char *name;
+	bool ran = false;
+	double update_us = 0.0;
+	double draw_us = 0.0;
+	size_t draw_count = 0; // draw calls for 3d, vertices for 2d
+};
+
+static void run3D(AnimSystem3D &system, gef::Renderer3DNull &renderer, gef::PlatformLinuxNull &platform, int frames, SystemTimings &timings) {
+	for (int i = 0; i < frames; ++i) {
+		platform.Update();
+
+		double start = timeNowUs();
+		system.update(platform.GetFrameTime());
+		double mid = timeNowUs();
+		renderer.Begin();
+		system.draw();
+		renderer.End();
+		double end = timeNowUs();
+
+		timings.update_us += mid - start;
+		timings.draw_us += end - mid;
+		timings.draw_count += renderer.draw_calls();
+	}
+	timings.ran = true;
+}
+
+static void run2D(AnimSystem &system, Batch2D &batch, gef::PlatformLinuxNull &platform, int frames, SystemTimings &timings) {
+	for (int i = 0; i < frames; ++i) {
+		platform.Update();
+
+		double start = timeNowUs();
+		system.update(platform.GetFrameTime());
+		double mid = timeNowUs();
+		batch.begin();
+		system.draw();
+		batch.end();
+		double end = timeNowUs();
+
+		timings.update_us += mid - start;
+		timings.draw_us += end - mid;
+		timings.draw_count += batch.getDrawnVertexCount();
+	}
+	timings.ran = true;
+}
+
+int main(int argc, char **argv) {
+	int frames = argc > 1 ? atoi(argv[1]) : 600;
+	if (frames <= 0) {
+		fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+		return 1;
+	}
+
+	gef::PlatformLinuxNull platform(960, 544);
+	gef::Renderer3DNull *renderer = (gef::Renderer3DNull *)gef::Renderer3D::Create(platform);
+	renderer->set_projection_matrix(platform.PerspectiveProjectionFov(gef::DegToRad(45.f), (float)platform.width() / (float)platform.height(), 0.01f, 1000.f));
+
+	gef::Matrix44 view_matrix;
+	view_matrix.LookAt(gef::Vector4(-1.f, 1.f, 4.f), gef::Vector4(0.f, 1.f, 0.f), gef::Vector4(0.f, 1.f, 0.f));
+	renderer->set_view_matrix(view_matrix);
+
+	Batch2D batch;
+	batch.init(platform);
+
+	AnimSystem3D anim3d;
+	anim3d.init(platform, renderer, "xbot/xbot.scn");
+	// the scenes are in git lfs, if they weren't pulled there is nothing to animate
+	bool has_3d = anim3d.getSkinnedMesh() != nullptr;
+	if (has_3d) {
+		CFile default_file = "animations/default.blend3d";
+		if (default_file && anim3d.checkFormatVersion(default_file)) {
+			anim3d.read(default_file);
+		}
+		gef::Transform tran = anim3d.getTransform();
+		tran.set_scale({ 0.01f, 0.01f, 0.01f });
+		anim3d.setTransform(tran);
+	}
+	else {
+		fprintf(stderr, "couldn't load xbot/xbot.scn, skipping the 3d system\n");
+	}
+
+	AnimSystemSke2D animske2d;
+	animske2d.init(&batch, platform);
+	animske2d.loadFromDragonBones("dragon/Dragon_tex.json", "dragon/Dragon_ske.json");
+	animske2d.setAnimation(0);
+
+	AnimSystemSprite animsprite;
+	animsprite.init(&batch, platform);
+
+	SystemTimings timings[] = { { "Skeleton 3D" }, { "Skeleton 2D" }, { "Sprite 2D" } };
+	if (has_3d) {
+		run3D(anim3d, *renderer, platform, frames, timings[0]);
+	}
+	run2D(animske2d, batch, platform, frames, timings[1]);
+	run2D(animsprite, batch, platform, frames, timings[2]);
+
+	printf("%d frames\n", frames);
+	printf("%-12s %12s %12s %12s\n", "system", "update (us)", "draw (us)", "draws/verts");
+	for (const SystemTimings &t : timings) {
+		if (!t.ran) {
+			printf("%-12s %12s\n", t.name, "skipped");
+			continue;
+		}
+		printf("%-12s %12.2f %12.2f %12zu\n", t.name, t.update_us / frames, t.draw_us / frames, t.draw_count / frames);
+	}
+
+	animsprite.cleanup();
+	animske2d.cleanup();
+	anim3d.cleanup();
+	batch.cleanup();
+	getClipLibrary().cleanup();
+	g_alloc->destroy(renderer);
+
+	return 0;
+}
@@ -0,0 +1,714 @@
+#include "motion_matching.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include <graphics/skinned_mesh_instance.h>
+#include <maths/math_utils.h>
+#include <system/allocator.h>
+#include <external/ImGui/imgui.h>
+
+#include "anim_system_3d.h"
+#include "utils.h"
+
+static const char *feature_group_names[] = {
+	"Foot positions", "Foot velocities", "Hip velocity", "Trajectory positions", "Trajectory directions"
+};
+
+static_assert((sizeof(feature_group_names) / sizeof(*feature_group_names)) == (int)FeatureGroup::Count);
+
+const char *getFeatureGroupName(FeatureGroup group) {
+	return (uint8_t)group < (uint8_t)FeatureGroup::Count ? feature_group_names[(uint8_t)group] : "Unknown";
+}
+
+// == FEATURE EXTRACTION ============================
+
+// samples one clip for the database. the poses have the root motion baked out, so
+// everything is moved back to the space of the clip before being compared
+struct ClipSampler {
+	// moves a point of the pose at <time> to the space of the clip
+	RootMotionKey addRootMotion(float time, RootMotionKey point) const {
+		if (clip.root_motion.empty()) {
+			return point;
+		}
+		RootMotionKey key = clip.root_motion.sample(time);
+		RootMotionKey out;
+		rotateY(point.x, point.z, key.yaw, out.x, out.z);
+		out.x += key.x;
+		out.z += key.z;
+		out.yaw = point.yaw + key.yaw;
+		return out;
+	}
+
+	// where the character is at <time> and where it's facing, the hips projected on the ground
+	RootMotionKey getRoot(float time) const {
+		gef::Matrix44 hips = gef::SkeletonPose::GetGlobalJointTransformFromAnim(
+			&clip.anim_data, bind_pose, time + clip.anim_data.start_time(), joints.hips
+		);
+		const gef::Vector4 &forward = hips.GetRow(2);
+		gef::Vector4 pos = hips.GetTranslation();
+		return addRootMotion(time, { pos.x(), pos.z(), atan2f(forward.x(), forward.z()) });
+	}
+
+	// movement of the character from <from> to <to>, looping clips keep going after the end
+	RootMotion getTrajectory(float from, float to) const {
+		if (!looping || to <= clip.duration) {
+			return RootMotion::between(getRoot(from), getRoot(gef::min(to, clip.duration)));
+		}
+		RootMotion to_end = RootMotion::between(getRoot(from), getRoot(clip.duration));
+		return RootMotion::combine(to_end, getTrajectory(0.f, to - clip.duration));
+	}
+
+	// position of <joint> in the space of the clip
+	gef::Vector4 getJoint(const gef::SkeletonPose &pose, float time, Int32 joint) const {
+		gef::Vector4 pos = pose.global_pose()[joint].GetTranslation();
+		RootMotionKey moved = addRootMotion(time, { pos.x(), pos.z(), 0.f });
+		return gef::Vector4(moved.x, pos.y(), moved.z);
+	}
+
+	void computeFeatures(float time, gef::SkeletonPose &pose, gef::SkeletonPose &next_pose, float stride, float *out) const {
+		// velocities look forward, apart from the end of the clip where they look back
+		float next_time = time + stride <= clip.duration ? time + stride : time - stride;
+		float inv_dt = 1.f / (next_time - time);
+
+		anim.sample(time, bind_pose, pose);
+		anim.sample(next_time, bind_pose, next_pose);
+
+		RootMotionKey root = getRoot(time);
+
+		// from the space of the clip to the space of the character
+		auto toLocal = [&root](const gef::Vector4 &v, bool is_point, float *dst) {
+			float x = is_point ? v.x() - root.x : v.x();
+			float z = is_point ? v.z() - root.z : v.z();
+			rotateY(x, z, -root.yaw, dst[0], dst[2]);
+			dst[1] = v.y();
+		};
+
+		const Int32 pose_joints[] = { joints.left_foot, joints.right_foot, joints.hips };
+		float *foot_positions = out;
+		float *foot_velocities = out + 6;
+		float *hip_velocity = out + 12;
+
+		for (int i = 0; i < 3; ++i) {
+			gef::Vector4 pos = getJoint(pose, time, pose_joints[i]);
+			gef::Vector4 next_pos = getJoint(next_pose, next_time, pose_joints[i]);
+			gef::Vector4 velocity = (next_pos - pos) * inv_dt;
+
+			if (i < 2) {
+				toLocal(pos, true, foot_positions + i * 3);
+				toLocal(velocity, false, foot_velocities + i * 3);
+			}
+			else {
+				toLocal(velocity, false, hip_velocity);
+			}
+		}
+
+		float *trajectory_positions = out + trajectory_offset;
+		float *trajectory_directions = trajectory_positions + trajectory_point_count * 2;
+		for (int i = 0; i < trajectory_point_count; ++i) {
+			RootMotion future = getTrajectory(time, time + trajectory_times[i]);
+			trajectory_positions[i * 2 + 0] = future.x;
+			trajectory_positions[i * 2 + 1] = future.z;
+			trajectory_directions[i * 2 + 0] = sinf(future.yaw);
+			trajectory_directions[i * 2 + 1] = cosf(future.yaw);
+		}
+	}
+
+	const Animation3D &anim;
+	const Clip &clip;
+	const gef::SkeletonPose &bind_pose;
+	const MotionJoints &joints;
+	bool looping;
+};
+
+// == MOTION DATABASE ===============================
+
+void MotionDatabase::build(const gef::Vec<const Animation3D *> &clips, const gef::SkeletonPose &bind_pose, const MotionJoints &joints, float frame_stride) {
+	clear();
+
+	if (frame_stride <= 0.f || joints.hips < 0 || joints.left_foot < 0 || joints.right_foot < 0) {
+		warn("can't build the motion database, stride or joints are not valid");
+		return;
+	}
+
+	PushAllocInfo("MotionDatabase");
+
+	stride = frame_stride;
+	gef::Vec<float> raw;
+	gef::Vec<MotionFrame> frame_list;
+	gef::SkeletonPose pose = bind_pose;
+	gef::SkeletonPose next_pose = bind_pose;
+	constexpr float horizon = trajectory_times[trajectory_point_count - 1];
+
+	for (size_t c = 0; c < clips.size(); ++c) {
+		const Animation3D *anim = clips[c];
+		ClipRange range = { (uint32_t)frame_list.size(), 0 };
+
+		if (anim && !anim->isAdditive() && anim->clip->duration > stride) {
+			ClipSampler sampler = { *anim, *anim->clip, bind_pose, joints, anim->looping };
+			// clips that don't loop have no future after the end, so their last second isn't used
+			float last_time = anim->looping ? anim->clip->duration : anim->clip->duration - horizon;
+
+			for (uint32_t f = 0; (float)f * stride < last_time; ++f) {
+				float time = (float)f * stride;
+				size_t first = raw.size();
+				raw.resize(first + feature_count, 0.f);
+				sampler.computeFeatures(time, pose, next_pose, stride, &raw[first]);
+				frame_list.push_back({ (uint16_t)c, time });
+				range.count++;
+			}
+		}
+
+		clip_ranges.push_back(range);
+	}
+
+	finish(std::move(raw), std::move(frame_list));
+	info("motion database: %u frames from %zu clips, %zu nodes, %zuKB", getFrameCount(), clips.size(), nodes.size(), getMemoryUsage() / 1024);
+
+	PopAllocInfo();
+}
+
+void MotionDatabase::build(gef::Vec<float> &&raw_features, gef::Vec<MotionFrame> &&frame_list) {
+	clear();
+	stride = 1.f;
+	clip_ranges.push_back({ 0, (uint32_t)frame_list.size() });
+	finish(std::move(raw_features), std::move(frame_list));
+}
+
+void MotionDatabase::clear() {
+	features.destroy();
+	frames.destroy();
+	nodes.destroy();
+	rows.destroy();
+	clip_ranges.destroy();
+	stride = 0.f;
+}
+
+void MotionDatabase::normalize(const float *raw, float *out) const {
+	for (int f = 0; f < feature_count; ++f) {
+		out[f] = (raw[f] - means[f]) * scales[f];
+	}
+}
+
+uint32_t MotionDatabase::search(const float *query, float &best_cost) const {
+	if (nodes.empty()) {
+		return invalid_frame;
+	}
+
+	// distance from the query to the cell of the current node, one offset per dimension
+	float offsets[feature_count] = {};
+	uint32_t best = invalid_frame;
+	searchNode(0, query, offsets, 0.f, best, best_cost);
+	return best;
+}
+
+uint32_t MotionDatabase::searchBruteForce(const float *query, float &best_cost) const {
+	KdNode everything;
+	everything.begin = 0;
+	everything.end = getFrameCount();
+
+	uint32_t best = invalid_frame;
+	scanLeaf(everything, query, best, best_cost);
+	return best;
+}
+
+float MotionDatabase::getCost(const float *query, uint32_t row) const {
+	const float *row_features = getFeatures(row);
+	float cost = 0.f;
+	for (int f = 0; f < feature_count; ++f) {
+		float diff = query[f] - row_features[f];
+		cost += diff * diff;
+	}
+	return cost;
+}
+
+uint32_t MotionDatabase::findRow(int clip, float time) const {
+	if (clip < 0 || clip >= (int)clip_ranges.size() || !clip_ranges[clip].count) {
+		return invalid_frame;
+	}
+
+	const ClipRange &range = clip_ranges[clip];
+	uint32_t frame = (uint32_t)gef::max(time / stride + 0.5f, 0.f);
+	return rows[range.first + gef::min(frame, range.count - 1)];
+}
+
+size_t MotionDatabase::getMemoryUsage() const {
+	return
+		features.capacity() * sizeof(float) +
+		frames.capacity() * sizeof(MotionFrame) +
+		nodes.capacity() * sizeof(KdNode) +
+		rows.capacity() * sizeof(uint32_t) +
+		clip_ranges.capacity() * sizeof(ClipRange);
+}
+
+void MotionDatabase::finish(gef::Vec<float> &&raw, gef::Vec<MotionFrame> &&frame_list) {
+	frames = std::move(frame_list);
+	if (frames.empty()) {
+		return;
+	}
+
+	computeNormalization(raw);
+	for (size_t row = 0; row < frames.size(); ++row) {
+		float *row_features = &raw[row * feature_count];
+		normalize(row_features, row_features);
+	}
+
+	buildTree(std::move(raw));
+}
+
+void MotionDatabase::computeNormalization(const gef::Vec<float> &raw) {
+	size_t count = raw.size() / feature_count;
+	double sums[feature_count] = {};
+	double sums_sq[feature_count] = {};
+
+	for (size_t row = 0; row < count; ++row) {
+		const float *row_features = &raw[row * feature_count];
+		for (int f = 0; f < feature_count; ++f) {
+			sums[f] += row_features[f];
+			sums_sq[f] += (double)row_features[f] * row_features[f];
+		}
+	}
+
+	// every feature in a group is scaled by the same amount, otherwise a feature that barely
+	// moves (like the height of the feet) would be as important as the whole trajectory
+	int first = 0;
+	for (int g = 0; g < (int)FeatureGroup::Count; ++g) {
+		double variance = 0.0;
+		for (int f = first; f < first + feature_group_sizes[g]; ++f) {
+			means[f] = (float)(sums[f] / count);
+			variance += sums_sq[f] / count - (double)means[f] * means[f];
+		}
+
+		float deviation = (float)sqrt(gef::max(variance / feature_group_sizes[g], 0.0));
+		float scale = weights[g] / gef::max(deviation, 1e-5f);
+		for (int f = first; f < first + feature_group_sizes[g]; ++f) {
+			scales[f] = scale;
+		}
+
+		first += feature_group_sizes[g];
+	}
+}
+
+void MotionDatabase::buildTree(gef::Vec<float> &&normalized) {
+	uint32_t count = getFrameCount();
+
+	gef::Vec<uint32_t> order;
+	order.resize(count, 0);
+	for (uint32_t i = 0; i < count; ++i) {
+		order[i] = i;
+	}
+
+	nodes.reserve(2 * (count / leaf_size) + 1);
+	buildNode(normalized.data(), order.data(), 0, count);
+
+	// store the rows in the order of the tree, so that scanning a leaf is a linear walk
+	gef::Vec<MotionFrame> sorted_frames;
+	sorted_frames.reserve(count);
+	features.resize((size_t)count * feature_count, 0.f);
+	rows.resize(count, 0);
+
+	for (uint32_t row = 0; row < count; ++row) {
+		uint32_t source = order[row];
+		memcpy(&features[(size_t)row * feature_count], &normalized[(size_t)source * feature_count], sizeof(float) * feature_count);
+		sorted_frames.push_back(frames[source]);
+		rows[source] = row;
+	}
+
+	frames = std::move(sorted_frames);
+}
+
+uint32_t MotionDatabase::buildNode(const float *data, uint32_t *order, uint32_t begin, uint32_t end) {
+	uint32_t index = (uint32_t)nodes.size();
+	nodes.push_back(KdNode());
+
+	KdNode node;
+	node.begin = begin;
+	node.end = end;
+
+	if (end - begin <= leaf_size) {
+		nodes[index] = node;
+		return index;
+	}
+
+	// split the dimension that is the most spread out, on the median so the tree stays balanced
+	float best_spread = 0.f;
+	for (int f = 0; f < feature_count; ++f) {
+		float lo = FLT_MAX;
+		float hi = -FLT_MAX;
+		for (uint32_t i = begin; i < end; ++i) {
+			float value = data[(size_t)order[i] * feature_count + f];
+			lo = gef::min(lo, value);
+			hi = gef::max(hi, value);
+		}
+		if ((hi - lo) > best_spread) {
+			best_spread = hi - lo;
+			node.dim = (uint32_t)f;
+		}
+	}
+
+	// every row is the same, nothing to split
+	if (node.dim == KdNode::leaf) {
+		nodes[index] = node;
+		return index;
+	}
+
+	uint32_t mid = begin + (end - begin) / 2;
+	uint32_t dim = node.dim;
+	std::nth_element(order + begin, order + mid, order + end, [data, dim](uint32_t a, uint32_t b) {
+		return data[(size_t)a * feature_count + dim] < data[(size_t)b * feature_count + dim];
+	});
+	node.split = data[(size_t)order[mid] * feature_count + dim];
+
+	buildNode(data, order, begin, mid);
+	node.right = buildNode(data, order, mid, end);
+	nodes[index] = node;
+
+	return index;
+}
+
+void MotionDatabase::searchNode(uint32_t node_index, const float *query, float *offsets, float min_dist, uint32_t &best, float &best_cost) const {
+	const KdNode &node = nodes[node_index];
+
+	if (node.dim == KdNode::leaf) {
+		scanLeaf(node, query, best, best_cost);
+		return;
+	}
+
+	float diff = query[node.dim] - node.split;
+	uint32_t near_child = diff < 0.f ? node_index + 1 : node.right;
+	uint32_t far_child = diff < 0.f ? node.right : node_index + 1;
+
+	searchNode(near_child, query, offsets, min_dist, best, best_cost);
+
+	// only the offset along this dimension changes when going to the other side, so the
+	// lower bound of the distance can be updated without going through every dimension
+	float old_offset = offsets[node.dim];
+	float far_dist = min_dist - old_offset * old_offset + diff * diff;
+	if (far_dist < best_cost) {
+		offsets[node.dim] = diff;
+		searchNode(far_child, query, offsets, far_dist, best, best_cost);
+		offsets[node.dim] = old_offset;
+	}
+}
+
+void MotionDatabase::scanLeaf(const KdNode &node, const float *query, uint32_t &best, float &best_cost) const {
+	for (uint32_t row = node.begin; row < node.end; ++row) {
+		const float *row_features = getFeatures(row);
+		float cost = 0.f;
+		for (int f = 0; f < feature_count && cost < best_cost; ++f) {
+			float diff = query[f] - row_features[f];
+			cost += diff * diff;
+		}
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = row;
+		}
+	}
+}
+
+// == MOTION MATCHER ================================
+
+void MotionMatcher::init(AnimSystem3D *anim_system) {
+	system = anim_system;
+	cur_clip = prev_clip = INVALID_ID;
+	blend_alpha = 1.f;
+	frames_until_search = 0;
+
+	if (gef::SkinnedMeshInstance *mesh = system->getSkinnedMesh()) {
+		cur_pose = mesh->bind_pose();
+		prev_pose = mesh->bind_pose();
+	}
+}
+
+void MotionMatcher::cleanup() {
+	database.clear();
+	benchmark_results.destroy();
+	cur_clip = prev_clip = INVALID_ID;
+}
+
+void MotionMatcher::build() {
+	gef::SkinnedMeshInstance *mesh = system ? system->getSkinnedMesh() : nullptr;
+	if (!mesh) {
+		warn("the motion matcher needs a skeleton");
+		return;
+	}
+
+	joints.hips = system->getJointId(joint_names[0]);
+	joints.left_foot = system->getJointId(joint_names[1]);
+	joints.right_foot = system->getJointId(joint_names[2]);
+
+	gef::Vec<const Animation3D *> clips;
+	for (int id = 0; const Animation3D *anim = system->getAnimation(id); ++id) {
+		clips.push_back(anim);
+	}
+
+	double start = timeNowUs();
+	database.build(clips, mesh->bind_pose(), joints, stride);
+	build_ms = (float)(timeNowUs() - start) / 1000.f;
+
+	cur_clip = prev_clip = INVALID_ID;
+	blend_alpha = 1.f;
+	frames_until_search = 0;
+}
+
+RootMotion MotionMatcher::update(float delta_time, gef::SkeletonPose &out_pose) {
+	if (database.empty()) {
+		return RootMotion();
+	}
+
+	if (--frames_until_search <= 0 || cur_clip == INVALID_ID) {
+		search();
+		frames_until_search = search_interval;
+	}
+
+	Animation3D *anim = system->getAnimation(cur_clip);
+	if (!anim) {
+		return RootMotion();
+	}
+
+	const gef::SkeletonPose &bind_pose = system->getSkinnedMesh()->bind_pose();
+
+	anim->advance(playback, delta_time);
+	anim->events.emit(playback, system->getEvents(), (int16_t)cur_clip);
+	RootMotion motion = anim->clip->root_motion.extract(playback);
+
+	Animation3D *prev = blend_alpha < 1.f ? system->getAnimation(prev_clip) : nullptr;
+	if (!prev) {
+		anim->sample(playback.time, bind_pose, out_pose);
+		return motion;
+	}
+
+	prev->advance(prev_playback, delta_time);
+	RootMotion prev_motion = prev->clip->root_motion.extract(prev_playback);
+
+	anim->sample(playback.time, bind_pose, cur_pose);
+	prev->sample(prev_playback.time, bind_pose, prev_pose);
+
+	blend_alpha = blend_time > 0.f ? gef::min(blend_alpha + delta_time / blend_time, 1.f) : 1.f;
+	out_pose.Linear2PoseBlend(prev_pose, cur_pose, blend_alpha);
+
+	return RootMotion::lerp(prev_motion, motion, blend_alpha);
+}
+
+void MotionMatcher::search() {
+	uint32_t cur_row = database.findRow(cur_clip, playback.time);
+
+	float query[feature_count];
+	buildQuery(cur_row, query);
+
+	// anything that isn't better than just carrying on isn't worth it
+	float best_cost = cur_row != MotionDatabase::invalid_frame ? database.getCost(query, cur_row) : FLT_MAX;
+
+	double start = timeNowUs();
+	uint32_t best = database.search(query, best_cost);
+	last_search_us = (float)(timeNowUs() - start);
+	last_cost = best_cost;
+	search_count++;
+
+	if (best == MotionDatabase::invalid_frame) {
+		return;
+	}
+
+	// jumping a bit further along the same clip isn't worth a blend
+	const MotionFrame &frame = database.getFrame(best);
+	if (frame.clip == cur_clip && fabsf(frame.time - playback.time) < blend_time) {
+		return;
+	}
+
+	startClip(best);
+}
+
+void MotionMatcher::buildQuery(uint32_t row, float *query) const {
+	// the pose is the one of the current frame, the trajectory is the one we want
+	float raw[feature_count] = {};
+	float *positions = raw + trajectory_offset;
+	float *directions = positions + trajectory_point_count * 2;
+
+	for (int i = 0; i < trajectory_point_count; ++i) {
+		float time = trajectory_times[i];
+		float angle = desired_turn * time;
+
+		// walking on a circle with the desired speed and turn rate, forward is +z
+		if (fabsf(desired_turn) > 1e-4f) {
+			float radius = desired_speed / desired_turn;
+			positions[i * 2 + 0] = radius * (1.f - cosf(angle));
+			positions[i * 2 + 1] = radius * sinf(angle);
+		}
+		else {
+			positions[i * 2 + 0] = 0.f;
+			positions[i * 2 + 1] = desired_speed * time;
+		}
+
+		directions[i * 2 + 0] = sinf(angle);
+		directions[i * 2 + 1] = cosf(angle);
+	}
+
+	database.normalize(raw, query);
+
+	if (row != MotionDatabase::invalid_frame) {
+		memcpy(query, database.getFeatures(row), sizeof(float) * trajectory_offset);
+	}
+}
+
+void MotionMatcher::startClip(uint32_t row) {
+	const MotionFrame &frame = database.getFrame(row);
+
+	if (cur_clip != INVALID_ID) {
+		prev_clip = cur_clip;
+		prev_playback = playback;
+		blend_alpha = 0.f;
+	}
+
+	cur_clip = frame.clip;
+	playback = ClipPlayback();
+	playback.setTime(frame.time);
+	playback.event_cursor = UINT32_MAX;
+	switch_count++;
+}
+
+void MotionMatcher::debugDraw() {
+	ImGui::PushID(this);
+
+	if (ImGui::TreeNode("Database")) {
+		ImGui::InputText("Hips", joint_names[0], sizeof(joint_names[0]));
+		ImGui::InputText("Left foot", joint_names[1], sizeof(joint_names[1]));
+		ImGui::InputText("Right foot", joint_names[2], sizeof(joint_names[2]));
+		ImGui::DragFloat("Stride", &stride, 0.001f, 1.f / 120.f, 0.5f, "%.3f s");
+
+		for (int g = 0; g < (int)FeatureGroup::Count; ++g) {
+			ImGui::DragFloat(getFeatureGroupName((FeatureGroup)g), &database.weights[g], 0.01f, 0.f, 10.f);
+		}
+		imHelper("The weights are applied when the database is built");
+
+		if (ImGui::Button("Build")) {
+			build();
+		}
+
+		ImGui::Text(
+			"%u frames, %zu nodes, %zuKB, built in %.2fms",
+			database.getFrameCount(), database.getNodeCount(), database.getMemoryUsage() / 1024, build_ms
+		);
+
+		ImGui::TreePop();
+	}
+
+	ImGui::DragFloat("Desired speed", &desired_speed, 0.01f, 0.f, 10.f);
+	ImGui::DragFloat("Desired turn", &desired_turn, 0.01f, -gef::pi, gef::pi);
+	ImGui::SliderInt("Search every", &search_interval, 1, 60, "%d frames");
+	ImGui::DragFloat("Blend time", &blend_time, 0.01f, 0.f, 1.f);
+
+	Animation3D *anim = system ? system->getAnimation(cur_clip) : nullptr;
+	ImGui::Text("Playing: %s at %.2f", anim ? anim->name : "nothing", playback.time);
+	ImGui::Text("Last search: %.2fus, cost %.3f", last_search_us, last_cost);
+	ImGui::Text("Searches: %d, switches: %d", search_count, switch_count);
+
+	ImGui::Separator();
+	ImGui::DragInt("Benchmark queries", &benchmark_queries, 1.f, 1, 10000);
+	if (ImGui::Button("Query benchmark")) {
+		runBenchmark(benchmark_queries);
+	}
+	imHelper("Builds databases of 10k to 1M frames out of this one and compares the kd-tree with a brute force search");
+
+	if (!benchmark_results.empty() && ImGui::BeginTable("benchmark", 5, ImGuiTableFlags_Borders)) {
+		ImGui::TableSetupColumn("frames");
+		ImGui::TableSetupColumn("build ms");
+		ImGui::TableSetupColumn("kd-tree us");
+		ImGui::TableSetupColumn("brute force us");
+		ImGui::TableSetupColumn("memory");
+		ImGui::TableHeadersRow();
+
+		for (const BenchmarkResult &result : benchmark_results) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%u", result.frames);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", result.build_ms);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", result.kd_query_us);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", result.brute_query_us);
+			ImGui::TableNextColumn(); ImGui::Text("%zuKB", result.memory / 1024);
+		}
+
+		ImGui::EndTable();
+	}
+
+	ImGui::PopID();
+}
+
+void MotionMatcher::runBenchmark(int queries) {
+	if (database.empty() || queries <= 0) {
+		warn("the query benchmark needs a motion database");
+		return;
+	}
+
+	static constexpr uint32_t sizes[] = { 10000, 100000, 1000000 };
+	// the brute force search is slow enough on the big databases that it gets fewer queries
+	static constexpr int max_brute_queries = 50;
+	// the fake frames are real frames moved around a bit, so they're spread like real data
+	static constexpr float jitter = 0.1f;
+
+	uint32_t state = 0x9e3779b9u;
+	uint32_t source_count = database.getFrameCount();
+	int brute_queries = gef::min(queries, max_brute_queries);
+
+	gef::Vec<float> query_features;
+	query_features.resize((size_t)queries * feature_count, 0.f);
+
+	benchmark_results.clear();
+	for (uint32_t size : sizes) {
+		PushAllocInfo("MotionBenchmark");
+
+		gef::Vec<float> raw;
+		gef::Vec<MotionFrame> frame_list;
+		raw.resize((size_t)size * feature_count, 0.f);
+		frame_list.resize(size, MotionFrame{ 0, 0.f });
+
+		for (uint32_t row = 0; row < size; ++row) {
+			const float *source = database.getFeatures(randNext(state) % source_count);
+			for (int f = 0; f < feature_count; ++f) {
+				raw[(size_t)row * feature_count + f] = source[f] + randFloat(state, -jitter, jitter);
+			}
+		}
+
+		MotionDatabase bench;
+		double start = timeNowUs();
+		bench.build(std::move(raw), std::move(frame_list));
+		float build_ms = (float)(timeNowUs() - start) / 1000.f;
+
+		for (int q = 0; q < queries; ++q) {
+			const float *source = bench.getFeatures(randNext(state) % size);
+			for (int f = 0; f < feature_count; ++f) {
+				query_features[(size_t)q * feature_count + f] = source[f] + randFloat(state, -jitter, jitter);
+			}
+		}
+
+		gef::Vec<float> kd_costs;
+		kd_costs.resize(queries, 0.f);
+
+		start = timeNowUs();
+		for (int q = 0; q < queries; ++q) {
+			float cost = FLT_MAX;
+			bench.search(&query_features[(size_t)q * feature_count], cost);
+			kd_costs[q] = cost;
+		}
+		float kd_us = (float)(timeNowUs() - start) / (float)queries;
+
+		int mismatches = 0;
+		start = timeNowUs();
+		for (int q = 0; q < brute_queries; ++q) {
+			float cost = FLT_MAX;
+			bench.searchBruteForce(&query_features[(size_t)q * feature_count], cost);
+			mismatches += cost != kd_costs[q];
+		}
+		float brute_us = (float)(timeNowUs() - start) / (float)brute_queries;
+
+		if (mismatches) {
+			err("motion benchmark: the kd-tree missed the nearest frame %d times", mismatches);
+		}
+
+		benchmark_results.push_back({ size, build_ms, kd_us, brute_us, bench.getMemoryUsage() });
+		info("motion benchmark: %u frames, build %.2fms, kd-tree %.2fus, brute force %.2fus, %zuKB", size, build_ms, kd_us, brute_us, bench.getMemoryUsage() / 1024);
+
+		bench.clear();
+		PopAllocInfo();
+	}
+}
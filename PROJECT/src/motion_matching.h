@@ -0,0 +1,185 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <system/vec.h>
+#include <animation/skeleton.h>
+
+#include "clip_library.h"
+#include "root_motion.h"
+
+struct Animation3D;
+class AnimSystem3D;
+
+// groups of features, each group is normalized on its own so that they all count the same
+// before the weights. everything is in the space of the character at that frame
+enum class FeatureGroup : uint8_t {
+	FootPositions,      // left and right foot, xyz
+	FootVelocities,     // left and right foot, xyz
+	HipVelocity,        // xyz
+	TrajectoryPositions,  // where the character will be, xz for every trajectory point
+	TrajectoryDirections, // where it will be facing, xz for every trajectory point
+	Count
+};
+
+// seconds in the future of each trajectory point
+static constexpr int trajectory_point_count = 3;
+static constexpr float trajectory_times[trajectory_point_count] = { 1.f / 3.f, 2.f / 3.f, 1.f };
+
+static constexpr int feature_group_sizes[(int)FeatureGroup::Count] = { 6, 6, 3, trajectory_point_count * 2, trajectory_point_count * 2 };
+static constexpr int feature_count = 6 + 6 + 3 + trajectory_point_count * 4;
+// offset in the feature vector of the first trajectory feature
+static constexpr int trajectory_offset = 6 + 6 + 3;
+
+const char *getFeatureGroupName(FeatureGroup group);
+
+// joints the pose features are taken from
+struct MotionJoints {
+	Int32 hips = -1;
+	Int32 left_foot = -1;
+	Int32 right_foot = -1;
+};
+
+// frame of a clip that was put in the database
+struct MotionFrame {
+	uint16_t clip;
+	float time;
+};
+
+// feature vectors of every frame of every clip, normalized and kept in a kd-tree.
+// the rows are stored in the order of the leaves of the tree, so a leaf is a contiguous block
+class MotionDatabase {
+public:
+	static constexpr uint32_t invalid_frame = UINT32_MAX;
+	// most rows in a leaf, it's scanned linearly
+	static constexpr uint32_t leaf_size = 16;
+
+	// samples every clip that isn't additive every <stride> seconds
+	void build(const gef::Vec<const Animation3D *> &clips, const gef::SkeletonPose &bind_pose, const MotionJoints &joints, float stride);
+	// builds the database from features that were already calculated, <raw_features> is
+	// feature_count floats per frame. used by the benchmark
+	void build(gef::Vec<float> &&raw_features, gef::Vec<MotionFrame> &&frame_list);
+	void clear();
+
+	// converts raw features into the space that is searched, <raw> and <out> can be the same
+	void normalize(const float *raw, float *out) const;
+
+	// row closest to <query>, which must be normalized. only rows cheaper than <best_cost> are
+	// considered so passing the cost of the current frame skips most of the tree.
+	// returns invalid_frame if nothing was cheaper
+	uint32_t search(const float *query, float &best_cost) const;
+	// same as search but it goes through every row, for testing and comparing
+	uint32_t searchBruteForce(const float *query, float &best_cost) const;
+	float getCost(const float *query, uint32_t row) const;
+
+	// row of <clip> closest to <time>, invalid_frame if the clip isn't in the database
+	uint32_t findRow(int clip, float time) const;
+	const float *getFeatures(uint32_t row) const { return &features[(size_t)row * feature_count]; }
+	const MotionFrame &getFrame(uint32_t row) const { return frames[row]; }
+
+	uint32_t getFrameCount() const { return (uint32_t)frames.size(); }
+	size_t getNodeCount() const { return nodes.size(); }
+	size_t getMemoryUsage() const;
+	float getStride() const { return stride; }
+	bool empty() const { return frames.empty(); }
+
+	float weights[(int)FeatureGroup::Count] = { 0.75f, 1.f, 1.f, 1.f, 1.5f };
+
+private:
+	struct KdNode {
+		// leaves don't split, they have a range of rows instead
+		static constexpr uint32_t leaf = UINT32_MAX;
+
+		uint32_t dim = leaf;
+		float split = 0.f;
+		uint32_t begin = 0;
+		uint32_t end = 0;
+		// the left child is always the next node
+		uint32_t right = 0;
+	};
+
+	// first row of each clip in the order they were added, before the tree reordered them
+	struct ClipRange {
+		uint32_t first;
+		uint32_t count;
+	};
+
+	void finish(gef::Vec<float> &&raw, gef::Vec<MotionFrame> &&frame_list);
+	void computeNormalization(const gef::Vec<float> &raw);
+	void buildTree(gef::Vec<float> &&normalized);
+	uint32_t buildNode(const float *data, uint32_t *order, uint32_t begin, uint32_t end);
+	void searchNode(uint32_t node_index, const float *query, float *offsets, float min_dist, uint32_t &best, float &best_cost) const;
+	void scanLeaf(const KdNode &node, const float *query, uint32_t &best, float &best_cost) const;
+
+	gef::Vec<float> features;
+	gef::Vec<MotionFrame> frames;
+	gef::Vec<KdNode> nodes;
+	// row of every frame, in the order they were added
+	gef::Vec<uint32_t> rows;
+	gef::Vec<ClipRange> clip_ranges;
+	float means[feature_count] = {};
+	float scales[feature_count] = {};
+	float stride = 0.f;
+};
+
+// plays the database: every few frames it looks for the frame that best continues the current
+// pose while following the desired trajectory, and crossfades to it
+class MotionMatcher {
+public:
+	void init(AnimSystem3D *anim_system);
+	void cleanup();
+	// rebuilds the database out of every clip of the system
+	void build();
+	// returns how much the character moved
+	RootMotion update(float delta_time, gef::SkeletonPose &out_pose);
+
+	void debugDraw();
+
+	struct BenchmarkResult {
+		uint32_t frames;
+		float build_ms;
+		float kd_query_us;
+		float brute_query_us;
+		size_t memory;
+	};
+	// builds databases of 10k to 1M frames out of the real one and times the queries
+	void runBenchmark(int queries);
+	const gef::Vec<BenchmarkResult> &getBenchmarkResults() const { return benchmark_results; }
+
+	// the trajectory the character should follow, in its own space
+	float desired_speed = 0.f; // units per second
+	float desired_turn = 0.f;  // radians per second
+	int search_interval = 10;  // frames between searches
+	float blend_time = 0.2f;
+
+private:
+	void search();
+	void buildQuery(uint32_t row, float *query) const;
+	void startClip(uint32_t row);
+
+	AnimSystem3D *system = nullptr;
+	MotionDatabase database;
+	MotionJoints joints;
+	char joint_names[3][24] = { "Hips", "LeftFoot", "RightFoot" };
+	float stride = 1.f / 30.f;
+	float build_ms = 0.f;
+
+	int cur_clip = -1;
+	ClipPlayback playback;
+	// the clip it's blending from, if any
+	int prev_clip = -1;
+	ClipPlayback prev_playback;
+	float blend_alpha = 1.f;
+	gef::SkeletonPose cur_pose;
+	gef::SkeletonPose prev_pose;
+	int frames_until_search = 0;
+
+	// == stats ==
+	float last_search_us = 0.f;
+	float last_cost = 0.f;
+	int search_count = 0;
+	int switch_count = 0;
+
+	int benchmark_queries = 200;
+	gef::Vec<BenchmarkResult> benchmark_results;
+};
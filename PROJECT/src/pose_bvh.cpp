@@ -0,0 +1,204 @@
+#include "pose_bvh.h"
+
+#include <math.h>
+#include <algorithm>
+
+#include <maths/math_utils.h>
+
+#include "skinned_bounds.h"
+
+static constexpr int max_leaf_items = 2;
+// the tree is split in the middle, so this is enough for more joints than a skeleton has
+static constexpr int max_depth = 64;
+
+// slab test, <t_enter> is where the ray goes into the box and <axis> the side it goes through
+static bool rayBox(const gef::Aabb &box, const float start[3], const float inv_dir[3], float max_t, float &t_enter, int &axis) {
+	const gef::Vector4 &min_vtx = box.min_vtx();
+	const gef::Vector4 &max_vtx = box.max_vtx();
+	const float box_min[3] = { min_vtx.x(), min_vtx.y(), min_vtx.z() };
+	const float box_max[3] = { max_vtx.x(), max_vtx.y(), max_vtx.z() };
+
+	float t_min = -FLT_MAX;
+	float t_max = max_t;
+	axis = 0;
+	for (int i = 0; i < 3; ++i) {
+		float t0 = (box_min[i] - start[i]) * inv_dir[i];
+		float t1 = (box_max[i] - start[i]) * inv_dir[i];
+		if (t0 > t1) std::swap(t0, t1);
+		if (t0 > t_min) {
+			t_min = t0;
+			axis = i;
+		}
+		t_max = gef::min(t_max, t1);
+		if (t_min > t_max) {
+			return false;
+		}
+	}
+
+	// starting inside the box counts as a hit straight away
+	t_enter = gef::max(t_min, 0.f);
+	return t_max >= 0.f;
+}
+
+static void getInverse(const gef::Vector4 &direction, float inv_dir[3]) {
+	const float dir[3] = { direction.x(), direction.y(), direction.z() };
+	for (int i = 0; i < 3; ++i) {
+		inv_dir[i] = fabsf(dir[i]) > 1e-12f ? 1.f / dir[i] : (dir[i] < 0.f ? -FLT_MAX : FLT_MAX);
+	}
+}
+
+void PoseBVH::build(const SkinnedBounds &bounds, const gef::SkeletonPose &pose) {
+	clear();
+	skeleton = pose.skeleton();
+
+	const gef::Vec<gef::Matrix44> &global_pose = pose.global_pose();
+	const gef::Vec<JointBounds> &joints = bounds.getJoints();
+	items.reserve(joints.size());
+	for (const JointBounds &joint : joints) {
+		Item item;
+		item.box = joint.box;
+		item.transform = global_pose[joint.joint];
+		item.inv_transform.Inverse(item.transform);
+		item.model_box = transformAabb(joint.box, item.transform);
+		item.joint = joint.joint;
+
+		const gef::Vector4 &min_vtx = item.model_box.min_vtx();
+		const gef::Vector4 &max_vtx = item.model_box.max_vtx();
+		item.centre[0] = (min_vtx.x() + max_vtx.x()) * 0.5f;
+		item.centre[1] = (min_vtx.y() + max_vtx.y()) * 0.5f;
+		item.centre[2] = (min_vtx.z() + max_vtx.z()) * 0.5f;
+		items.push_back(item);
+	}
+
+	if (items.empty()) {
+		return;
+	}
+
+	nodes.reserve(items.size() * 2);
+	nodes.push_back(Node());
+	split(0, 0, (int)items.size());
+}
+
+void PoseBVH::clear() {
+	items.clear();
+	nodes.clear();
+	skeleton = nullptr;
+	last_test_count = 0;
+}
+
+void PoseBVH::split(int node_index, int begin, int end) {
+	gef::Aabb box;
+	gef::Aabb centres;
+	for (int i = begin; i < end; ++i) {
+		box.Update(items[i].model_box.min_vtx());
+		box.Update(items[i].model_box.max_vtx());
+		centres.Update(gef::Vector4(items[i].centre[0], items[i].centre[1], items[i].centre[2]));
+	}
+	nodes[node_index].box = box;
+
+	if (end - begin <= max_leaf_items) {
+		nodes[node_index].first = begin;
+		nodes[node_index].count = end - begin;
+		return;
+	}
+
+	// half the items on each side of the longest axis of their centres
+	gef::Vector4 size = centres.max_vtx() - centres.min_vtx();
+	int axis = 0;
+	if (size.y() > size.x())                    axis = 1;
+	if (size.z() > gef::max(size.x(), size.y())) axis = 2;
+
+	int mid = begin + (end - begin) / 2;
+	std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end, [axis](const Item &a, const Item &b) {
+		return a.centre[axis] < b.centre[axis];
+	});
+
+	// push_back can move the nodes, so they're only used by index
+	int left = (int)nodes.size();
+	nodes.push_back(Node());
+	nodes.push_back(Node());
+	nodes[node_index].first = left;
+	nodes[node_index].count = 0;
+
+	split(left, begin, mid);
+	split(left + 1, mid, end);
+}
+
+bool PoseBVH::isIgnored(Int32 joint, Int32 ignore_subtree) const {
+	if (ignore_subtree < 0 || !skeleton) {
+		return false;
+	}
+	if (skeleton->depth_first()) {
+		return joint >= ignore_subtree && joint < skeleton->subtree_end(ignore_subtree);
+	}
+	for (Int32 parent = joint; parent >= 0; parent = skeleton->joint(parent).parent) {
+		if (parent == ignore_subtree) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool PoseBVH::raycast(const gef::Vector4 &start, const gef::Vector4 &direction, RayHit &hit, Int32 ignore_subtree) const {
+	hit = RayHit();
+	last_test_count = 0;
+	if (nodes.empty()) {
+		return false;
+	}
+
+	const float ray_start[3] = { start.x(), start.y(), start.z() };
+	float inv_dir[3];
+	getInverse(direction, inv_dir);
+
+	int stack[max_depth];
+	int stack_size = 0;
+	stack[stack_size++] = 0;
+
+	while (stack_size > 0) {
+		const Node &node = nodes[stack[--stack_size]];
+		float t_enter = 0.f;
+		int axis = 0;
+		if (!rayBox(node.box, ray_start, inv_dir, hit.distance, t_enter, axis)) {
+			continue;
+		}
+
+		if (node.count == 0) {
+			if (stack_size + 2 <= max_depth) {
+				stack[stack_size++] = node.first;
+				stack[stack_size++] = node.first + 1;
+			}
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; ++i) {
+			const Item &item = items[i];
+			if (isIgnored(item.joint, ignore_subtree)) {
+				continue;
+			}
+
+			// the ray in the space of the joint, the direction isn't normalised so the
+			// distance along it is the same in both spaces
+			gef::Vector4 local_start = start.Transform(item.inv_transform);
+			gef::Vector4 local_dir = direction.TransformNoTranslation(item.inv_transform);
+			const float local_ray_start[3] = { local_start.x(), local_start.y(), local_start.z() };
+			float local_inv_dir[3];
+			getInverse(local_dir, local_inv_dir);
+			last_test_count++;
+
+			if (!rayBox(item.box, local_ray_start, local_inv_dir, hit.distance, t_enter, axis)) {
+				continue;
+			}
+
+			const float local_dir_axis[3] = { local_dir.x(), local_dir.y(), local_dir.z() };
+			float side = local_dir_axis[axis] > 0.f ? -1.f : 1.f;
+			gef::Vector4 local_normal(axis == 0 ? side : 0.f, axis == 1 ? side : 0.f, axis == 2 ? side : 0.f);
+
+			hit.distance = t_enter;
+			hit.point = start + direction * t_enter;
+			hit.normal = local_normal.TransformNoTranslation(item.transform).Normalised();
+			hit.joint = item.joint;
+		}
+	}
+
+	return hit.joint >= 0;
+}
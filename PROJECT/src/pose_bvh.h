@@ -0,0 +1,61 @@
+#pragma once
+
+#include <float.h>
+
+#include <system/vec.h>
+#include <maths/aabb.h>
+#include <maths/matrix44.h>
+#include <animation/skeleton.h>
+
+class SkinnedBounds;
+
+struct RayHit {
+	float distance = FLT_MAX; // along the ray, in the units of its direction
+	gef::Vector4 point;       // model space
+	gef::Vector4 normal;      // model space, of the side of the box that was hit
+	Int32 joint = -1;
+};
+
+// the boxes of the joints of a skinned mesh moved by a pose, in a bvh so a ray only tests
+// the few boxes it goes near. it's small enough to build again every frame: the boxes are
+// split in half along their longest axis until there are two or less in a node
+class PoseBVH {
+public:
+	void build(const SkinnedBounds &bounds, const gef::SkeletonPose &pose);
+	void clear();
+
+	// closest hit of a model space ray. the box of every joint is tested in the space of the
+	// joint, so it's as tight as the box that was made at load. joints in the subtree of
+	// <ignore_subtree> are skipped, so a chain doesn't pick itself
+	bool raycast(const gef::Vector4 &start, const gef::Vector4 &direction, RayHit &hit, Int32 ignore_subtree = -1) const;
+
+	bool empty() const { return nodes.empty(); }
+	size_t getNodeCount() const { return nodes.size(); }
+	// joint boxes the last raycast tested in the space of their joint
+	int getLastTestCount() const { return last_test_count; }
+
+private:
+	struct Item {
+		gef::Aabb box;       // space of the joint
+		gef::Aabb model_box; // around the box moved by the pose
+		gef::Matrix44 transform;
+		gef::Matrix44 inv_transform; // model space to the space of the joint
+		float centre[3];
+		Int32 joint;
+	};
+
+	// a leaf has items [first, first + count), otherwise its children are first and first + 1
+	struct Node {
+		gef::Aabb box;
+		int first;
+		int count;
+	};
+
+	void split(int node_index, int begin, int end);
+	bool isIgnored(Int32 joint, Int32 ignore_subtree) const;
+
+	gef::Vec<Item> items;
+	gef::Vec<Node> nodes;
+	const gef::Skeleton *skeleton = nullptr;
+	mutable int last_test_count = 0;
+};
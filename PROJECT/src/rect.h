@@ -5,9 +5,15 @@
 
 namespace gef {
     struct Rect {
+        // a Vector2 can't be inside an anonymous struct on gcc, so the position and
+        // size each get their own union. the layout is still x, y, w, h
         union {
-            struct { float x, y, w, h; };
-            struct { gef::Vector2 pos, size; };
+            struct { float x, y; };
+            gef::Vector2 pos;
+        };
+        union {
+            struct { float w, h; };
+            gef::Vector2 size;
         };
         Rect() : x(0), y(0), w(0), h(0) {}
         Rect(float v) : x(v), y(v), w(v), h(v) {}
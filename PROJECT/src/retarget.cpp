@@ -0,0 +1,139 @@
+#include "retarget.h"
+
+#include <ctype.h>
+#include <math.h>
+
+#include <animation/joint.h>
+
+#include "clip_library.h"
+#include "utils.h"
+
+// lowercase and only letters and numbers, so "Left_Arm", "left-arm" and "LeftArm" all match
+static std::string normalizeName(const std::string &name) {
+	std::string out;
+	out.reserve(name.size());
+	for (char c : name) {
+		if (isalnum((unsigned char)c)) {
+			out.push_back((char)tolower((unsigned char)c));
+		}
+	}
+	return out;
+}
+
+static gef::Quaternion inverse(const gef::Quaternion &rotation) {
+	gef::Quaternion out;
+	out.Conjugate(rotation);
+	return out;
+}
+
+// rotation of every joint in model space, the parents always come before their children
+static void getGlobalRotations(const gef::SkeletonPose &bind_pose, gef::Vec<gef::Quaternion> &out) {
+	const auto &joints = bind_pose.skeleton()->joints();
+	const auto &local_pose = bind_pose.local_pose();
+
+	out.clear();
+	out.reserve(joints.size());
+	for (size_t i = 0; i < joints.size(); ++i) {
+		Int32 parent = joints[i].parent;
+		// gef's a * b rotates by a first, so it's the local rotation followed by the parent's
+		out.push_back(parent < 0 ? local_pose[i].rotation() : (local_pose[i].rotation() * out[parent]).Norm());
+	}
+}
+
+// == RETARGET MAP ==================================
+
+void RetargetMap::addAlias(const char *source, const char *target) {
+	aliases.push_back({ source, target });
+}
+
+bool RetargetMap::build(
+	const gef::SkeletonPose &source_bind, const JointNameMap &source_joints,
+	const gef::SkeletonPose &target_bind, const JointNameMap &target_joints
+) {
+	clear();
+
+	const gef::Skeleton *source_skeleton = source_bind.skeleton();
+	const gef::Skeleton *target_skeleton = target_bind.skeleton();
+	assert(source_skeleton && target_skeleton);
+
+	std::unordered_map<std::string, int> source_by_name;
+	for (const auto &[name, index] : source_joints) {
+		source_by_name[normalizeName(name)] = index;
+	}
+
+	gef::Vec<gef::Quaternion> source_global;
+	gef::Vec<gef::Quaternion> target_global;
+	getGlobalRotations(source_bind, source_global);
+	getGlobalRotations(target_bind, target_global);
+
+	const auto &source_list = source_skeleton->joints();
+	const auto &target_list = target_skeleton->joints();
+	joints.resize(target_list.size(), RetargetJoint());
+
+	for (const auto &[name, target] : target_joints) {
+		int source = -1;
+
+		for (const auto &[alias_source, alias_target] : aliases) {
+			if (alias_target != name) {
+				continue;
+			}
+			auto it = source_joints.find(alias_source);
+			if (it != source_joints.end()) {
+				source = it->second;
+				break;
+			}
+		}
+
+		if (source < 0) {
+			auto it = source_by_name.find(normalizeName(name));
+			if (it == source_by_name.end()) {
+				continue;
+			}
+			source = it->second;
+		}
+
+		// with B the model space bind rotations, the local rotation of the source is moved
+		// into the space of the target as pre-parent * local * post-joint:
+		//   pre  = inverse(target parent) after source parent
+		//   post = inverse(source joint) after target joint
+		// so a source joint in bind pose gives exactly the target's bind pose
+		Int32 source_parent = source_list[source].parent;
+		Int32 target_parent = target_list[target].parent;
+		const gef::Quaternion &source_parent_rot = source_parent < 0 ? gef::Quaternion::kIdentity : source_global[source_parent];
+		const gef::Quaternion &target_parent_rot = target_parent < 0 ? gef::Quaternion::kIdentity : target_global[target_parent];
+
+		RetargetJoint &joint = joints[target];
+		joint.source = source;
+		joint.source_name = source_list[source].name_id;
+		joint.pre = (source_parent_rot * inverse(target_parent_rot)).Norm();
+		joint.post = (target_global[target] * inverse(source_global[source])).Norm();
+		mapped_count++;
+	}
+
+	// the root is the first joint, its translation is scaled by the height of the hips
+	if (!joints.empty() && joints[0].source >= 0) {
+		root_joint = 0;
+		float source_height = source_bind.local_pose()[joints[0].source].translation().y();
+		float target_height = target_bind.local_pose()[0].translation().y();
+		root_scale = fabsf(source_height) > 1e-4f ? target_height / source_height : 1.f;
+	}
+
+	hash = 2166136261u;
+	for (const RetargetJoint &joint : joints) {
+		hash ^= joint.source_name;
+		hash *= 16777619u;
+	}
+	hash ^= hashSkeleton(*target_skeleton);
+	hash *= 16777619u;
+
+	info("retarget map: %d of %zu joints matched, root scale %.3f", mapped_count, joints.size(), root_scale);
+	return mapped_count > 0;
+}
+
+void RetargetMap::clear() {
+	joints.clear();
+	mapped_count = 0;
+	hash = 0;
+	root_joint = -1;
+	root_scale = 1.f;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include <system/vec.h>
+#include <system/string_id.h>
+#include <maths/quaternion.h>
+#include <animation/skeleton.h>
+
+// joint name to index, like the ones from SceneLoader::getJointMap
+using JointNameMap = std::unordered_map<std::string, int>;
+
+// how a joint of the target skeleton is driven by the source one
+struct RetargetJoint {
+	Int32 source = -1; // -1 if nothing in the source matched, the joint stays in bind pose
+	gef::StringId source_name = 0; // used to find the track in the clips
+	// the source rotation is corrected for the different bind poses as
+	// post * source * pre (gef order), so it's a single pass over the joints
+	gef::Quaternion pre;
+	gef::Quaternion post;
+};
+
+// precomputed mapping from the joints of the skeleton the clips were exported
+// with to another one. joints are matched by name once, when the map is built
+class RetargetMap {
+public:
+	// joints named <source> are used for the joints named <target>, checked before the name rules
+	void addAlias(const char *source, const char *target);
+	void clearAliases() { aliases.clear(); }
+
+	bool build(
+		const gef::SkeletonPose &source_bind, const JointNameMap &source_joints,
+		const gef::SkeletonPose &target_bind, const JointNameMap &target_joints
+	);
+	void clear();
+
+	// joint of the target skeleton
+	const RetargetJoint &getJoint(Int32 target) const { return joints[target]; }
+	size_t getJointCount() const { return joints.size(); }
+	int getMappedCount() const { return mapped_count; }
+	// different for every pair of skeletons, used to find the clip bindings
+	uint32_t getHash() const { return hash; }
+	bool empty() const { return joints.empty(); }
+
+	// only the root joint keeps its translation, scaled by how much taller the target is
+	Int32 root_joint = -1;
+	float root_scale = 1.f;
+
+private:
+	gef::Vec<RetargetJoint> joints;
+	gef::Vec<std::pair<std::string, std::string>> aliases;
+	int mapped_count = 0;
+	uint32_t hash = 0;
+};
@@ -0,0 +1,146 @@
+#include "root_motion.h"
+
+#include <math.h>
+
+#include <animation/animation.h>
+#include <maths/math_utils.h>
+
+#include "clip_library.h"
+
+void rotateY(float x, float z, float angle, float &out_x, float &out_z) {
+	float c = cosf(angle);
+	float s = sinf(angle);
+	out_x = x * c + z * s;
+	out_z = z * c - x * s;
+}
+
+// angle of the rotation around the y axis, the swing is thrown away
+static float getYaw(const gef::Quaternion &rotation) {
+	float sign = rotation.w < 0.f ? -1.f : 1.f;
+	return 2.f * atan2f(rotation.y * sign, rotation.w * sign);
+}
+
+// == ROOT MOTION ===================================
+
+RootMotion RootMotion::between(const RootMotionKey &from, const RootMotionKey &to) {
+	RootMotion delta;
+	rotateY(to.x - from.x, to.z - from.z, -from.yaw, delta.x, delta.z);
+	delta.yaw = to.yaw - from.yaw;
+	return delta;
+}
+
+RootMotion RootMotion::lerp(const RootMotion &start, const RootMotion &end, float alpha) {
+	RootMotion out;
+	out.x = gef::lerp(start.x, end.x, alpha);
+	out.z = gef::lerp(start.z, end.z, alpha);
+	out.yaw = gef::lerp(start.yaw, end.yaw, alpha);
+	return out;
+}
+
+RootMotion RootMotion::combine(const RootMotion &first, const RootMotion &then) {
+	RootMotion out;
+	rotateY(then.x, then.z, first.yaw, out.x, out.z);
+	out.x += first.x;
+	out.z += first.z;
+	out.yaw = first.yaw + then.yaw;
+	return out;
+}
+
+gef::Matrix44 RootMotion::toMatrix() const {
+	gef::Matrix44 delta;
+	delta.RotationY(yaw);
+	delta.SetTranslation(gef::Vector4(x, 0.f, z));
+	return delta;
+}
+
+// == ROOT MOTION CURVE =============================
+
+void RootMotionCurve::bake(gef::TransformAnimNode &root_track, float start_time, float duration) {
+	keys.clear();
+	rate = 0.f;
+
+	auto &rotation_keys = root_track.rotation_keys();
+	auto &translation_keys = root_track.translation_keys();
+
+	if (duration <= 0.f || (rotation_keys.empty() && translation_keys.empty())) {
+		return;
+	}
+
+	size_t count = (size_t)ceilf(duration * bake_rate) + 1;
+	rate = (float)(count - 1) / duration;
+	keys.reserve(count);
+
+	gef::Vector4 first_pos = translation_keys.empty() ? gef::Vector4::kZero : root_track.GetTranslation(start_time);
+	float first_yaw = rotation_keys.empty() ? 0.f : getYaw(root_track.GetRotation(start_time));
+	float prev_yaw = first_yaw;
+	float unwrapped_yaw = 0.f;
+
+	for (size_t i = 0; i < count; ++i) {
+		float anim_time = start_time + (float)i / rate;
+		RootMotionKey key = { 0.f, 0.f, 0.f };
+
+		if (!translation_keys.empty()) {
+			gef::Vector4 pos = root_track.GetTranslation(anim_time);
+			key.x = pos.x() - first_pos.x();
+			key.z = pos.z() - first_pos.z();
+		}
+
+		if (!rotation_keys.empty()) {
+			// keep it continuous so that lerping between two keys never goes the long way around
+			float yaw = getYaw(root_track.GetRotation(anim_time));
+			unwrapped_yaw += gef::ShortestAngleDiff(yaw, prev_yaw);
+			prev_yaw = yaw;
+			key.yaw = unwrapped_yaw;
+		}
+
+		keys.push_back(key);
+	}
+
+	// now that it's baked take it out of the track, the character stays where it started
+	for (gef::Vector3Key &key : translation_keys) {
+		key.value.set_x(first_pos.x());
+		key.value.set_z(first_pos.z());
+	}
+
+	for (gef::QuaternionKey &key : rotation_keys) {
+		float half_angle = (first_yaw - getYaw(key.value)) * 0.5f;
+		gef::Quaternion unyaw(0.f, sinf(half_angle), 0.f, cosf(half_angle));
+		// gef's a * b rotates by a first, so this is the key followed by the inverse of its yaw
+		key.value = (key.value * unyaw).Norm();
+	}
+}
+
+RootMotionKey RootMotionCurve::sample(float time) const {
+	assert(!keys.empty());
+
+	float index = gef::max(time, 0.f) * rate;
+	size_t first = (size_t)index;
+	if (first >= keys.size() - 1) {
+		return keys.back();
+	}
+
+	const RootMotionKey &a = keys[first];
+	const RootMotionKey &b = keys[first + 1];
+	float alpha = index - (float)first;
+
+	return {
+		gef::lerp(a.x, b.x, alpha),
+		gef::lerp(a.z, b.z, alpha),
+		gef::lerp(a.yaw, b.yaw, alpha),
+	};
+}
+
+RootMotion RootMotionCurve::extract(const ClipPlayback &playback) const {
+	if (keys.empty()) {
+		return RootMotion();
+	}
+
+	if (!playback.wrapped) {
+		return RootMotion::between(sample(playback.prev_time), sample(playback.time));
+	}
+
+	// went past the end, move until the end and then from the start to the new time
+	RootMotion to_end = RootMotion::between(sample(playback.prev_time), keys.back());
+	RootMotion from_start = RootMotion::between(keys[0], sample(playback.time));
+	return RootMotion::combine(to_end, from_start);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <system/vec.h>
+#include <maths/vector4.h>
+#include <maths/matrix44.h>
+
+namespace gef {
+	class TransformAnimNode;
+} // namespace gef
+
+struct ClipPlayback;
+struct RootMotionKey;
+
+// rotates a vector on the ground plane the same way gef::Matrix44::RotationY does
+void rotateY(float x, float z, float angle, float &out_x, float &out_z);
+
+// how much the character moved over an update, in the space of the character
+// at the start of the update. y is left in the root track, so it's only on the ground plane
+struct RootMotion {
+	// <alpha> range (0, 1)
+	static RootMotion lerp(const RootMotion &start, const RootMotion &end, float alpha);
+	// movement from <from> to <to>, in the space of the character at <from>
+	static RootMotion between(const RootMotionKey &from, const RootMotionKey &to);
+	// <first> followed by <then>
+	static RootMotion combine(const RootMotion &first, const RootMotion &then);
+	// matrix that moves the transform of the character, new = delta * old
+	gef::Matrix44 toMatrix() const;
+
+	float x = 0.f;
+	float z = 0.f;
+	float yaw = 0.f;
+};
+
+// trajectory of the root joint on the ground plane, relative to the first frame
+struct RootMotionKey {
+	float x, z, yaw;
+};
+
+// root trajectory baked at a fixed rate so that sampling it is just an index and a lerp
+struct RootMotionCurve {
+	// samples per second, roughly. it's adjusted so the last key lands on the end of the clip
+	static constexpr float bake_rate = 30.f;
+
+	// bakes the ground plane movement and yaw of <root_track> and removes them from
+	// the track, so the clip plays in place. <start_time> and <duration> are the clip's
+	void bake(gef::TransformAnimNode &root_track, float start_time, float duration);
+	// <time> in seconds from the start of the clip
+	RootMotionKey sample(float time) const;
+	// movement over the last update of <playback>, it's only two samples unless the clip wrapped
+	RootMotion extract(const ClipPlayback &playback) const;
+
+	bool empty() const { return keys.empty(); }
+	size_t getMemoryUsage() const { return keys.capacity() * sizeof(RootMotionKey); }
+
+	gef::Vec<RootMotionKey> keys;
+	float rate = 0.f;
+};
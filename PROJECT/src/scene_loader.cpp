@@ -10,6 +10,8 @@
 
 #include <system/allocator.h>
 
+#include "utils.h"
+
 SceneLoader::~SceneLoader() {
 	for (auto &mesh : meshes)
 		g_alloc->destroy(mesh);
@@ -70,13 +72,22 @@ bool SceneLoader::loadScene(std::istream &stream) {
 	stream.read((char *)&animation_count, sizeof(Int32));
 	stream.read((char *)&string_count, sizeof(Int32));
 
+	if (!stream) {
+		err("scene file is too short");
+		return false;
+	}
+
 	// string table
 	for (Int32 string_num = 0; string_num < string_count; ++string_num) {
 		std::string the_string = "";
 
 		char string_character;
 		do {
-			stream.read(&string_character, 1);
+			// a file that isn't a scene (like a git lfs pointer) would read forever
+			if (!stream.read(&string_character, 1)) {
+				err("scene string table is truncated");
+				return false;
+			}
 			if (string_character != 0)
 				the_string.push_back(string_character);
 		} while (string_character != 0);
@@ -121,6 +132,42 @@ bool SceneLoader::loadScene(std::istream &stream) {
 	return success;
 }
 
+int SceneLoader::findTextures() {
+	decoded_textures.clear();
+
+	for (const auto &mat : material_data) {
+		if (mat.diffuse_texture == "") {
+			continue;
+		}
+
+		gef::StringId texture_name_id = gef::GetStringId(mat.diffuse_texture);
+		bool found = false;
+		for (const DecodedTexture &tex : decoded_textures) {
+			if (tex.name_id == texture_name_id) {
+				found = true;
+				break;
+			}
+		}
+
+		if (!found) {
+			DecodedTexture tex;
+			tex.name_id = texture_name_id;
+			tex.filename = &mat.diffuse_texture;
+			decoded_textures.emplace_back(std::move(tex));
+		}
+	}
+
+	return (int)decoded_textures.size();
+}
+
+void SceneLoader::decodeTexture(const gef::Platform &platform, int index) {
+	DecodedTexture &tex = decoded_textures[index];
+	tex.image = gef::ptr<gef::ImageData>::make();
+
+	gef::PNGLoader png_loader;
+	png_loader.Load(tex.filename->c_str(), platform, *tex.image);
+}
+
 void SceneLoader::createMaterials(const gef::Platform &platform) {
 	// go through all the materials and create new textures for them
 	data.materials.reserve(material_data.size());
@@ -138,11 +185,25 @@ void SceneLoader::createMaterials(const gef::Platform &platform) {
 			if (find_result == textures_map.end()) {
 				string_id_table.Add(mat.diffuse_texture);
 
-				gef::ImageData image_data;
-				gef::PNGLoader png_loader;
-				png_loader.Load(mat.diffuse_texture.c_str(), platform, image_data);
-				if (image_data.image() != NULL) {
-					data.textures.emplace_back(gef::Texture::Create(platform, image_data));
+				// use the image if it was already decoded, otherwise load it now
+				gef::ImageData local_image;
+				gef::ImageData *image_data = &local_image;
+				bool decoded = false;
+				for (DecodedTexture &tex : decoded_textures) {
+					if (tex.name_id == texture_name_id && tex.image) {
+						image_data = tex.image.get();
+						decoded = true;
+						break;
+					}
+				}
+
+				if (!decoded) {
+					gef::PNGLoader png_loader;
+					png_loader.Load(mat.diffuse_texture.c_str(), platform, local_image);
+				}
+
+				if (image_data->image() != NULL) {
+					data.textures.emplace_back(gef::Texture::Create(platform, *image_data));
 					gef::Texture *texture = data.textures.back().get();
 
 					textures_map[texture_name_id] = texture;
@@ -157,6 +218,9 @@ void SceneLoader::createMaterials(const gef::Platform &platform) {
 		data.materials.emplace_back(material);
 		materials_map[mat.name_id] = &data.materials.back();
 	}
+
+	// the images have been uploaded, no need to keep them around
+	decoded_textures.clear();
 }
 
 void SceneLoader::createMeshes(gef::Platform &platform) {
@@ -201,6 +265,16 @@ gef::Skeleton SceneLoader::popFirstSkeleton() {
 	return {};
 }
 
+bool SceneLoader::popFirstAnimation(gef::Animation &out) {
+	auto it = animations.begin();
+	if (it == animations.end()) {
+		return false;
+	}
+	out = std::move(it->second);
+	animations.erase(it);
+	return true;
+}
+
 gef::Vec<gef::ptr<gef::Texture>> &&SceneLoader::moveTextures() {
 	return std::move(data.textures);
 }
@@ -208,3 +282,24 @@ gef::Vec<gef::ptr<gef::Texture>> &&SceneLoader::moveTextures() {
 gef::Vec<gef::Material> &&SceneLoader::moveMaterials() {
 	return std::move(data.materials);
 }
+
+std::unordered_map<std::string, int> SceneLoader::getJointMap(const gef::Skeleton &skeleton) {
+	std::unordered_map<std::string, int> joint_map;
+	const auto &joints = skeleton.joints();
+
+	for (size_t i = 0; i < joints.size(); ++i) {
+		std::string joint_name;
+		if (string_id_table.Find(joints[i].name_id, joint_name)) {
+			size_t start = joint_name.find_first_of(':');
+			if (start != std::string::npos) {
+				joint_name = joint_name.substr(++start);
+			}
+			joint_map[joint_name] = (int)i;
+		}
+		else {
+			warn("could not find joint %zu in string table", i);
+		}
+	}
+
+	return joint_map;
+}
@@ -9,12 +9,13 @@
 #include <graphics/mesh_data.h>
 #include <graphics/mesh.h>
 #include <graphics/material.h>
+#include <graphics/texture.h>
+#include <graphics/image_data.h>
 #include <animation/animation.h>
 #include <animation/skeleton.h>
 
 namespace gef {
 	class Platform;
-	class Texture;
 }
 
 struct SceneData {
@@ -29,20 +30,39 @@ public:
 	bool loadScene(const gef::Platform &platform, const char *filename);
 	bool loadScene(std::istream &stream);
 
+	// finds the textures used by the materials and returns how many there are,
+	// they can then be decoded (on any thread) before calling createMaterials
+	int findTextures();
+	// decodes the png of texture <index>, different textures can be decoded at the same time
+	void decodeTexture(const gef::Platform &platform, int index);
+
 	void createMaterials(const gef::Platform &platform);
 	void createMeshes(gef::Platform &platform);
 
 	gef::Mesh *popFirstMesh();
+	// vertex data of the first mesh, it's kept after the meshes are created
+	const gef::MeshData *getFirstMeshData() const { return mesh_data.empty() ? nullptr : &mesh_data[0]; }
 	gef::Skeleton popFirstSkeleton();
+	bool popFirstAnimation(gef::Animation &out);
 
 	gef::Vec<gef::ptr<gef::Texture>> &&moveTextures();
 	gef::Vec<gef::Material> &&moveMaterials();
 
+	// maps every joint name, without the "namespace:" prefix, to its index in <skeleton>
+	std::unordered_map<std::string, int> getJointMap(const gef::Skeleton &skeleton);
+
 	gef::StringIdTable &getStringTable() { return string_id_table; }
 	const gef::StringIdTable &getStringTable() const { return string_id_table; }
 
 private:
+	struct DecodedTexture {
+		gef::StringId name_id = 0;
+		const std::string *filename = nullptr;
+		gef::ptr<gef::ImageData> image;
+	};
+
 	SceneData data;
+	gef::Vec<DecodedTexture> decoded_textures;
 
 	gef::Vec<gef::MeshData> mesh_data;
 	gef::Vec<gef::MaterialData> material_data;
@@ -0,0 +1,89 @@
+#include "skinned_bounds.h"
+
+#include <math.h>
+
+#include <graphics/mesh.h>
+#include <graphics/mesh_data.h>
+#include <animation/joint.h>
+
+#include "utils.h"
+
+gef::Aabb transformAabb(const gef::Aabb &box, const gef::Matrix44 &matrix) {
+	const gef::Vector4 &min_vtx = box.min_vtx();
+	const gef::Vector4 &max_vtx = box.max_vtx();
+	float centre[3] = { (min_vtx.x() + max_vtx.x()) * 0.5f, (min_vtx.y() + max_vtx.y()) * 0.5f, (min_vtx.z() + max_vtx.z()) * 0.5f };
+	float extent[3] = { (max_vtx.x() - min_vtx.x()) * 0.5f, (max_vtx.y() - min_vtx.y()) * 0.5f, (max_vtx.z() - min_vtx.z()) * 0.5f };
+
+	// row vectors, so every output axis is a column of the matrix
+	float out_centre[3];
+	float out_extent[3];
+	for (int col = 0; col < 3; ++col) {
+		out_centre[col] = matrix.m(3, col);
+		out_extent[col] = 0.f;
+		for (int row = 0; row < 3; ++row) {
+			out_centre[col] += centre[row] * matrix.m(row, col);
+			out_extent[col] += extent[row] * fabsf(matrix.m(row, col));
+		}
+	}
+
+	return gef::Aabb(
+		gef::Vector4(out_centre[0] - out_extent[0], out_centre[1] - out_extent[1], out_centre[2] - out_extent[2]),
+		gef::Vector4(out_centre[0] + out_extent[0], out_centre[1] + out_extent[1], out_centre[2] + out_extent[2])
+	);
+}
+
+// == SKINNED BOUNDS ================================
+
+bool SkinnedBounds::build(const gef::MeshData &mesh_data, const gef::Skeleton &skeleton) {
+	joints.clear();
+
+	const gef::VertexData &vertex_data = mesh_data.vertex_data;
+	if (vertex_data.vertex_byte_size != sizeof(gef::Mesh::SkinnedVertex)) {
+		warn("mesh isn't skinned, it can't have joint bounds");
+		return false;
+	}
+
+	const auto &skeleton_joints = skeleton.joints();
+	gef::Vec<gef::Aabb> boxes;
+	boxes.resize(skeleton_joints.size(), gef::Aabb());
+	gef::Vec<bool> has_vertices;
+	has_vertices.resize(skeleton_joints.size(), false);
+
+	const gef::Mesh::SkinnedVertex *vertices = (const gef::Mesh::SkinnedVertex *)vertex_data.vertices;
+	for (Int32 v = 0; v < vertex_data.num_vertices; ++v) {
+		const gef::Mesh::SkinnedVertex &vertex = vertices[v];
+		gef::Vector4 position(vertex.px, vertex.py, vertex.pz);
+
+		for (int i = 0; i < 4; ++i) {
+			UInt8 joint = vertex.bone_indices[i];
+			if (vertex.bone_weights[i] < min_weight || joint >= skeleton_joints.size()) {
+				continue;
+			}
+			// same space the bone matrices start from, so the pose moves it like the vertex
+			boxes[joint].Update(position.Transform(skeleton_joints[joint].inv_bind_pose));
+			has_vertices[joint] = true;
+		}
+	}
+
+	for (size_t i = 0; i < boxes.size(); ++i) {
+		if (has_vertices[i]) {
+			joints.push_back({ (Int32)i, boxes[i] });
+		}
+	}
+
+	info("joint bounds: %zu of %zu joints have vertices", joints.size(), skeleton_joints.size());
+	return !joints.empty();
+}
+
+gef::Aabb SkinnedBounds::calculate(const gef::SkeletonPose &pose) const {
+	const gef::Vec<gef::Matrix44> &global_pose = pose.global_pose();
+	gef::Aabb bounds;
+
+	for (const JointBounds &joint : joints) {
+		gef::Aabb box = transformAabb(joint.box, global_pose[joint.joint]);
+		bounds.Update(box.min_vtx());
+		bounds.Update(box.max_vtx());
+	}
+
+	return bounds;
+}
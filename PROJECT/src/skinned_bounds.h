@@ -0,0 +1,43 @@
+#pragma once
+
+#include <system/vec.h>
+#include <maths/aabb.h>
+#include <maths/matrix44.h>
+#include <animation/skeleton.h>
+
+namespace gef {
+	struct MeshData;
+}
+
+// transforms <box> by <matrix> and returns the axis aligned box around it. it goes
+// through the centre and the extents instead of the 8 corners like gef::Aabb::Transform
+gef::Aabb transformAabb(const gef::Aabb &box, const gef::Matrix44 &matrix);
+
+// box of the vertices skinned to one joint, in the space of the joint in the bind pose
+struct JointBounds {
+	Int32 joint;
+	gef::Aabb box;
+};
+
+// bounds of a skinned mesh that follow the pose instead of the static aabb of the mesh.
+// every vertex goes in the box of each joint that moves it, once at load
+class SkinnedBounds {
+public:
+	// vertices weighted less than this to a joint don't grow its box
+	static constexpr float min_weight = 0.1f;
+
+	// returns false if <mesh_data> isn't skinned
+	bool build(const gef::MeshData &mesh_data, const gef::Skeleton &skeleton);
+	void clear() { joints.clear(); }
+
+	// box around <pose> in model space, made of the joint boxes moved by the global pose
+	gef::Aabb calculate(const gef::SkeletonPose &pose) const;
+
+	const gef::Vec<JointBounds> &getJoints() const { return joints; }
+	size_t getJointCount() const { return joints.size(); }
+	bool empty() const { return joints.empty(); }
+
+private:
+	// only the joints that have vertices
+	gef::Vec<JointBounds> joints;
+};
@@ -2,6 +2,7 @@
 
 #include <math.h>
 #include <string.h>
+#include <chrono>
 
 #include <assets/png_loader.h>
 #include <graphics/image_data.h>
@@ -21,7 +22,9 @@
 #include <external/ImGui/imgui.h>
 #include <external/ImGui/imgui_internal.h>
 
+#ifndef GEF_HEADLESS
 #include <external/portable-file-dialogs/portable-file-dialogs.h>
+#endif
 
 #include "scene_loader.h"
 #include "anim_system.h"
@@ -37,8 +40,13 @@ CFile::~CFile() {
 }
 
 bool CFile::open(const char *filename, const char *mode) {
+#ifdef _WIN32
 	errno_t error = fopen_s(&fp, filename, mode);
 	return error == 0;
+#else
+	fp = fopen(filename, mode);
+	return fp != nullptr;
+#endif
 }
 
 bool CFile::close() {
@@ -162,7 +170,8 @@ bool imInputText(const char *label, std::string &str) {
 
 int imSaveAndRead(AnimSystem *system, const char *desc, const char *filetype, std::string *name) {
 	int result = ResultNone;
-	
+
+#ifndef GEF_HEADLESS
 	if (ImGui::Button("Save", { 100, 30 })) {
 		std::string destination = pfd::save_file::save_file(
 			"Save file",
@@ -213,6 +222,7 @@ int imSaveAndRead(AnimSystem *system, const char *desc, const char *filetype, st
 			}
 		}
 	}
+#endif
 
 	return result;
 }
@@ -230,7 +240,14 @@ gef::ptr<gef::Texture> loadPng(const char *png_filename, gef::Platform &platform
 	if (image_data.image())
 		return gef::Texture::Create(platform, image_data, allocator);
 
+#ifdef GEF_HEADLESS
+	// nothing is ever shown, so the servers don't need the images. a placeholder
+	// keeps the systems that read the texture size working
+	warn("couldn't load %s, using a placeholder texture", png_filename);
+	return gef::Texture::CreateCheckerTexture(16, 1, platform, allocator);
+#else
 	return nullptr;
+#endif
 }
 
 gef::ptr<gef::Mesh> loadMesh(const char *filename, gef::Platform &platform) {
@@ -275,8 +292,12 @@ void traceLogVaList(LogLevel level, const char *fmt, va_list args) {
 	strCopyInto(buffer, beg);
 	vsnprintf(buffer + offset, sizeof(buffer) - offset, fmt, args);
 
+#ifdef _WIN32
 	OutputDebugStringA(buffer);
 	OutputDebugStringA("\n");
+#else
+	fprintf(stderr, "%s\n", buffer);
+#endif
 
 	if (level == LogLevel::Fatal) {
 		abort();
@@ -399,6 +420,92 @@ gef::Matrix44 mat4FromPosRotScale(
 	return scale_mat * o;
 }
 
+// -- picking helpers --
+
+// http://antongerdelan.net/opengl/raycasting.html
+// https://forum.libcinder.org/topic/picking-ray-from-mouse-coords
+void getScreenPosRay(
+	const gef::Vector2 &screen_position, 
+	const gef::Matrix44 &projection, 
+	const gef::Matrix44 &view, 
+	gef::Vector4 &start_point, 
+	gef::Vector4 &direction, 
+	const gef::Vector2 &screen_sz
+) {
+	gef::Matrix44 projectionInverse;
+	projectionInverse.Inverse(view * projection);
+	getScreenPosRay(screen_position, projectionInverse, start_point, direction, screen_sz);
+}
+
+void getScreenPosRay(
+	const gef::Vector2 &screen_position, 
+	const gef::Matrix44 &projectionInverse, 
+	gef::Vector4 &start_point, 
+	gef::Vector4 &direction, 
+	const gef::Vector2 &screen_sz
+) {
+	gef::Vector2 half_sz = screen_sz / 2.f;
+
+	gef::Vector2 ndc = {
+		(screen_position.x - half_sz.x) / half_sz.x,
+		(half_sz.y - screen_position.y) / half_sz.y
+	};
+
+	gef::Vector4 nearPoint, farPoint;
+
+	constexpr float ndc_z_min = 0.0001f;
+	nearPoint = gef::Vector4(ndc.x, ndc.y, ndc_z_min, 1.0f).TransformW(projectionInverse);
+	farPoint = gef::Vector4(ndc.x, ndc.y, 1.0f, 1.0f).TransformW(projectionInverse);
+
+	nearPoint /= nearPoint.w();
+	farPoint /= farPoint.w();
+
+	start_point = gef::Vector4(nearPoint.x(), nearPoint.y(), nearPoint.z());
+	direction = farPoint - nearPoint;
+	direction.Normalise();
+}
+
+// modified and fixed from https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-plane-and-ray-disk-intersection
+bool rayPlaneIntersect(
+	const gef::Vector4 &start_point, 
+	const gef::Vector4 &direction, 
+	const gef::Vector4 &point_on_plane, 
+	const gef::Vector4 &plane_normal, 
+	gef::Vector4 &hitpoint
+) {
+	gef::Vector4 p0, l0, n, l;
+	l0 = start_point;
+	l = direction;
+	p0 = point_on_plane;
+	n = plane_normal;
+	float t = 0.0f;
+
+	// assuming vectors are all normalized
+	float denom = n.DotProduct(l);
+	if (fabsf(denom) > 1e-6) {
+		gef::Vector4 p0l0 = p0 - l0;
+		t = p0l0.DotProduct(n) / denom;
+
+		if (t >= 0)
+			hitpoint = start_point + direction * t;
+
+		return (t >= 0);
+	}
+
+	return false;
+}
+
+const gef::Matrix44 &InverseViewProjection::get(const gef::Matrix44 &view, const gef::Matrix44 &projection) {
+	// comparing 32 floats is a lot cheaper than a 4x4 inverse
+	if (!is_valid || memcmp(&view, &last_view, sizeof(view)) != 0 || memcmp(&projection, &last_projection, sizeof(projection)) != 0) {
+		last_view = view;
+		last_projection = projection;
+		inverse.Inverse(view * projection);
+		is_valid = true;
+	}
+	return inverse;
+}
+
 // -- useful stuff for tweening
 
 float tweenGetAngleDiff(float start, float end) {
@@ -416,6 +523,26 @@ float angleLerp(float start, float diff, float t) {
 	return start + diff * t;
 }
 
+// -- random helpers --
+
+uint32_t randNext(uint32_t &state) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+float randFloat(uint32_t &state, float from, float to) {
+	return from + (to - from) * ((float)randNext(state) / (float)UINT32_MAX);
+}
+
+// -- timing helpers --
+
+double timeNowUs() {
+	using namespace std::chrono;
+	return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
 // -- string helpers --
 
 gef::ptr<char> strfmt(const char *fmt, ...) {
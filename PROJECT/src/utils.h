@@ -2,6 +2,8 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
 #include <string>
 
 #include <system/ptr.h>
@@ -110,11 +112,44 @@ gef::Matrix33 mat3FromPosRotScale(const gef::Vector2 &pos, float rot, const gef:
 gef::Matrix44 mat4FromPosScale(const gef::Vector4 &pos, const gef::Vector4 &scale);
 gef::Matrix44 mat4FromPosRotScale(const gef::Vector2 &pos, float rot, const gef::Vector2 &scale);
 
+// -- picking helpers --
+
+// world space ray under <screen_position>, in pixels from the top left of a screen of <screen_sz>
+void getScreenPosRay(const gef::Vector2 &screen_position, const gef::Matrix44 &projection, const gef::Matrix44 &view, gef::Vector4 &start_point, gef::Vector4 &direction, const gef::Vector2 &screen_sz);
+// same as above with the inverse of view * projection already worked out
+void getScreenPosRay(const gef::Vector2 &screen_position, const gef::Matrix44 &inv_view_projection, gef::Vector4 &start_point, gef::Vector4 &direction, const gef::Vector2 &screen_sz);
+
+// inverse of view * projection, only worked out again when the camera changes
+struct InverseViewProjection {
+	const gef::Matrix44 &get(const gef::Matrix44 &view, const gef::Matrix44 &projection);
+
+private:
+	gef::Matrix44 last_view;
+	gef::Matrix44 last_projection;
+	gef::Matrix44 inverse;
+	bool is_valid = false;
+};
+// false if the ray is parallel to the plane or the plane is behind it
+bool rayPlaneIntersect(const gef::Vector4 &start_point, const gef::Vector4 &direction, const gef::Vector4 &point_on_plane, const gef::Vector4 &plane_normal, gef::Vector4 &hitpoint);
+
 // -- useful stuff for tweening --
 
 float tweenGetAngleDiff(float start, float end);
 float angleLerp(float start, float diff, float t);
 
+// -- random helpers --
+
+// xorshift, the same <state> always gives the same numbers so benchmarks and crowds can be
+// made again. <state> can't start at 0
+uint32_t randNext(uint32_t &state);
+// between <from> and <to>
+float randFloat(uint32_t &state, float from, float to);
+
+// -- timing helpers --
+
+// monotonic clock in microseconds, only meaningful when comparing two values
+double timeNowUs();
+
 // -- string helpers --
 
 gef::ptr<char> strfmt(const char *fmt, ...);
@@ -123,7 +158,12 @@ gef::ptr<char> strcopy(const char *src);
 bool strEndsWith(const std::string &str, const char *ends);
 template<size_t N>
 void strCopyInto(char (&dst)[N], const char *src) {
+#ifdef _WIN32
 	strncpy_s(dst, src, N - 1);
+#else
+	strncpy(dst, src, N - 1);
+	dst[N - 1] = '\0';
+#endif
 }
 
 // -- linked list helpers --
@@ -367,7 +367,7 @@ namespace gef
 	{
 		if(node)
 		{
-			auto &anim_node_iter=anim_nodes_.find(node->name_id());
+			auto anim_node_iter = anim_nodes_.find(node->name_id());
 			if(anim_node_iter == anim_nodes_.end())
 				anim_nodes_[node->name_id()] = node;
 		}
@@ -123,6 +123,7 @@ namespace gef
 		bool Write(std::ostream& stream) const;
 
 		inline const std::map<StringId, gef::ptr<AnimNode>>& anim_nodes() const { return anim_nodes_; }
+		inline std::map<StringId, gef::ptr<AnimNode>>& anim_nodes() { return const_cast<std::map<StringId, gef::ptr<AnimNode>>&>(static_cast<const Animation&>(*this).anim_nodes()); }
 		inline float duration() const { return duration_; }
 		inline void set_start_time(const float start_time) { start_time_ = start_time; }
 		inline void set_end_time(const float end_time) { end_time_ = end_time; }
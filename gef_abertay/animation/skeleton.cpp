@@ -3,8 +3,35 @@
 
 namespace gef {
 	Int32 Skeleton::AddJoint(const Joint &joint) {
+		Int32 index = (Int32)joints_.size();
 		joints_.push_back(joint);
-		return (Int32)joints_.size() - 1;
+
+		// depth first means the joint before this one is the parent or one of its descendants
+		if (joint.parent >= index || (joint.parent >= 0 && subtree_ends_[joint.parent] != index))
+			depth_first_ = false;
+
+		subtree_ends_.push_back(index + 1);
+		for (Int32 parent = joint.parent; parent >= 0 && parent < index; parent = joints_[parent].parent)
+			subtree_ends_[parent] = index + 1;
+
+		return index;
+	}
+
+	void Skeleton::UpdateSubtreeRanges() {
+		subtree_ends_.clear();
+		depth_first_ = true;
+
+		Int32 count = (Int32)joints_.size();
+		subtree_ends_.reserve(count);
+		for (Int32 index = 0; index < count; ++index) {
+			Int32 parent_index = joints_[index].parent;
+			if (parent_index >= index || (parent_index >= 0 && subtree_ends_[parent_index] != index))
+				depth_first_ = false;
+
+			subtree_ends_.push_back(index + 1);
+			for (Int32 parent = parent_index; parent >= 0 && parent < index; parent = joints_[parent].parent)
+				subtree_ends_[parent] = index + 1;
+		}
 	}
 
 	Int32 Skeleton::FindJointIndex(const StringId joint_name_id) const {
@@ -60,6 +87,28 @@ namespace gef {
 		}
 	}
 
+	void SkeletonPose::CalculateGlobalPoseSubtree(const Int32 joint, const gef::Matrix44 *const pose_transform) {
+		if (!skeleton_)
+			return;
+
+		const gef::Vec<Joint> &joints = skeleton_->joints();
+		// without the ranges the best it can do is everything after the joint,
+		// the parents still come before their children
+		Int32 end = skeleton_->depth_first() ? skeleton_->subtree_end(joint) : (Int32)joints.size();
+
+		for (Int32 jointNum = joint; jointNum < end; jointNum++) {
+			const Joint &current = joints[jointNum];
+			Matrix44 local_pose_matrix = local_pose_[jointNum].GetMatrix();
+			if (current.parent == -1) {
+				global_pose_[jointNum] = local_pose_matrix;
+				if (pose_transform)
+					global_pose_[jointNum] = global_pose_[jointNum] * (*pose_transform);
+			}
+			else
+				global_pose_[jointNum] = local_pose_matrix * global_pose_[current.parent];
+		}
+	}
+
 	void SkeletonPose::CalculateLocalPose(const gef::Vec<Matrix44> &global_pose_matrices) {
 		if (skeleton_) {
 			const gef::Vec<Joint> &joints = skeleton_->joints();
@@ -170,6 +219,49 @@ namespace gef {
 			CalculateGlobalPose();
 	}
 
+	void SkeletonPose::SetPoseFromAnim(const Animation &anim, const SkeletonPose &bind_pose, const float time, const Int32 *joints, size_t joint_count) {
+		assert(local_pose_.size() == bind_pose.local_pose().size());
+
+		for (size_t i = 0; i < joint_count; ++i) {
+			const Int32 joint_index = joints[i];
+			const AnimNode *anim_node = anim.FindNode(skeleton_->joints()[joint_index].name_id);
+			const JointPose &bind_joint = bind_pose.local_pose()[joint_index];
+			JointPose &joint_pose = local_pose_[joint_index];
+
+			if (anim_node && anim_node->type() == AnimNode::kTransform) {
+				const TransformAnimNode *transform_node = static_cast<const TransformAnimNode *>(anim_node);
+
+				// same as the full version, scale is always ignored
+				joint_pose.set_scale(gef::Vector4(1.f, 1.f, 1.f));
+
+				if (transform_node->rotation_keys().size() > 0)
+					joint_pose.set_rotation(transform_node->GetRotation(time));
+				else
+					joint_pose.set_rotation(bind_joint.rotation());
+
+				if (transform_node->translation_keys().size() > 0)
+					joint_pose.set_translation(transform_node->GetTranslation(time));
+				else
+					joint_pose.set_translation(bind_joint.translation());
+			}
+			else {
+				joint_pose = bind_joint;
+			}
+		}
+	}
+
+	void SkeletonPose::Linear2PoseBlend(const SkeletonPose &start_pose, const SkeletonPose &end_pose, const float time, const Int32 *joints, size_t joint_count) {
+		const gef::Vec<JointPose> &start_poses = start_pose.local_pose();
+		const gef::Vec<JointPose> &end_poses = end_pose.local_pose();
+		assert(start_poses.size() == end_poses.size());
+		assert(local_pose_.size() == start_poses.size());
+
+		for (size_t i = 0; i < joint_count; ++i) {
+			const Int32 joint_index = joints[i];
+			local_pose_[joint_index] = Transform::lerp(start_poses[joint_index], end_poses[joint_index], time);
+		}
+	}
+
 	SkeletonPose SkeletonPose::lerp(const SkeletonPose &start, const SkeletonPose &end, float time) {
 		assert(start.skeleton() == end.skeleton());
 		const gef::Vec<JointPose> &start_poses = start.local_pose();
@@ -312,6 +404,7 @@ namespace gef {
 		stream.read((char *)&num_joints, sizeof(Int32));
 		joints_.resize(num_joints);
 		stream.read((char *)&joints_.front(), sizeof(Joint) * num_joints);
+		UpdateSubtreeRanges();
 
 		return true;
 	}
@@ -29,23 +29,42 @@ namespace gef {
 		}
 
 		inline const gef::Vec<Joint> &joints() const { return joints_; }
+		// call UpdateSubtreeRanges after changing the parents through this
 		inline gef::Vec<Joint> &joints() {
 			return const_cast<gef::Vec<Joint>&>(static_cast<const Skeleton &>(*this).joints());
 		}
+
+		// when the joints are stored depth first every joint is followed by all of its
+		// descendants, so the subtree of <index> is [index, subtree_end(index)).
+		// joints pushed through joints() aren't in the ranges until UpdateSubtreeRanges
+		inline Int32 subtree_end(const Int32 index) const { return subtree_ends_[index]; }
+		inline bool depth_first() const { return depth_first_ && subtree_ends_.size() == joints_.size(); }
+		void UpdateSubtreeRanges();
+
 	private:
 		gef::Vec<Joint> joints_;
+		gef::Vec<Int32> subtree_ends_;
+		bool depth_first_ = true;
 	};
 
 	class SkeletonPose {
 	public:
 		SkeletonPose(IAllocator *allocator = g_alloc);
 		void CalculateGlobalPose(const gef::Matrix44 *const pose_transform = NULL);
+		// only <joint> and the joints below it, after their local pose was changed.
+		// the global pose of the parent of <joint> has to be up to date
+		void CalculateGlobalPoseSubtree(const Int32 joint, const gef::Matrix44 *const pose_transform = NULL);
 		void CalculateLocalPose(const gef::Vec<Matrix44> &global_pose);
 		void SetPoseFromAnim(const class Animation &_anim, const SkeletonPose &_bindPose, const float _time, const bool _updateGlobalPose = true);
 	//	void SetLocalJointPoseFromAnim(JointPose& _jointPose, const UInt32 _jointNum, const JointPose& _jointBindPose, const class Anim& _anim, const float _time);
 		static SkeletonPose lerp(const SkeletonPose &start, const SkeletonPose &end, float time);
 		void Linear2PoseBlend(const SkeletonPose &_startPose, const SkeletonPose &_endPose, const float _time);
 
+		// partial versions, they only touch the local pose of the joints in <joints>
+		// and never update the global pose, the caller is in charge of that
+		void SetPoseFromAnim(const class Animation &anim, const SkeletonPose &bind_pose, const float time, const Int32 *joints, size_t joint_count);
+		void Linear2PoseBlend(const SkeletonPose &start_pose, const SkeletonPose &end_pose, const float time, const Int32 *joints, size_t joint_count);
+
 		static gef::Matrix44 GetGlobalJointTransformFromAnim(const class Animation *_anim, const SkeletonPose &_bindPose, float _time, const Int32 joint_index);
 		static gef::Matrix44 GetJointTransformFromAnim(const class Animation &_anim, const SkeletonPose &_bindPose, float _time, const Int32 joint_index);
 
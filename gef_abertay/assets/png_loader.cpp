@@ -96,6 +96,7 @@ namespace gef
                         success = false;
                         png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
                         g_alloc->dealloc(buffer);
+                        buffer = nullptr;
                     }
 
                     if(success)
@@ -107,6 +108,7 @@ namespace gef
                         {
                             success = false;
                             g_alloc->dealloc(buffer);
+                            buffer = nullptr;
                             png_destroy_read_struct(&png_ptr, NULL, NULL);
                         }
                     }
@@ -126,6 +128,7 @@ namespace gef
                         {
                             success = false;
                             g_alloc->dealloc(buffer);
+                            buffer = nullptr;
 
                             /* Free all of the memory associated
                              * with the png_ptr and info_ptr */
@@ -158,6 +161,7 @@ namespace gef
                         {
                             success = false;
                             g_alloc->dealloc(buffer);
+                            buffer = nullptr;
 
                             /* Free all of the memory associated
                              * with the png_ptr and info_ptr */
@@ -183,6 +187,7 @@ namespace gef
                             {
                                 success = false;
                                 g_alloc->dealloc(buffer);
+                                buffer = nullptr;
 
                                 /* Free all of the memory associated
                                  * with the png_ptr and info_ptr */
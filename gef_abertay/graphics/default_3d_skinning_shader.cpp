@@ -155,11 +155,11 @@ namespace gef
 		// need to transpose the bone matrices for the shader
 		if (bone_matrices_variable_index_ != -1)
 		{
-			UInt32 matrix_index = 0;
-			for (gef::Vec<gef::Matrix44>::const_iterator matrix_iter = shader_data.bone_matrices()->begin(); matrix_iter != shader_data.bone_matrices()->end(); ++matrix_iter, ++matrix_index)
-				mesh_data_.bones_matrices[matrix_index].Transpose((*matrix_iter));
+			const Matrix44* bone_matrices = shader_data.bone_matrices();
+			for (UInt32 matrix_index = 0; matrix_index < shader_data.bone_count(); ++matrix_index)
+				mesh_data_.bones_matrices[matrix_index].Transpose(bone_matrices[matrix_index]);
 
-			device_interface_->SetVertexShaderVariable(bone_matrices_variable_index_, (float*)&mesh_data_.bones_matrices[0], (Int32)shader_data.bone_matrices()->size());
+			device_interface_->SetVertexShaderVariable(bone_matrices_variable_index_, (float*)&mesh_data_.bones_matrices[0], (Int32)shader_data.bone_count());
 		}
 
 		device_interface_->SetPixelShaderVariable(ambient_light_colour_variable_index_, (float*)&ambient_light_colour);
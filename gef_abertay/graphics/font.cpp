@@ -80,7 +80,7 @@ bool Font::Load(const char* font_name)
 		config_initialised = ParseFont(font_config_stream, character_set);
 
 		// don't need the font file data any more
-		g_alloc->destroy(font_file_data);
+		g_alloc->dealloc(font_file_data);
 		font_file_data = NULL;
 
 		std::string font_texture_filename(font_name);
@@ -34,6 +34,11 @@ namespace gef
 	}
 
 	void Renderer3D::DrawSkinnedMesh(const MeshInstance& mesh_instance, const gef::Vec<Matrix44>& bone_matrices, bool use_default_shader)
+	{
+		DrawSkinnedMesh(mesh_instance, bone_matrices.data(), (UInt32)bone_matrices.size(), use_default_shader);
+	}
+
+	void Renderer3D::DrawSkinnedMesh(const MeshInstance& mesh_instance, const Matrix44* bone_matrices, UInt32 bone_count, bool use_default_shader)
 	{
 		Shader* previous_shader = shader_;
 		if(use_default_shader)
@@ -49,7 +54,7 @@ namespace gef
 			}
 			default_skinned_mesh_shader_data_.set_ambient_light_colour(default_shader_data_.ambient_light_colour());
 
-			default_skinned_mesh_shader_data_.set_bone_matrices(&bone_matrices);
+			default_skinned_mesh_shader_data_.set_bone_matrices(bone_matrices, bone_count);
 
 			SetShader(&default_skinned_mesh_shader_);
 
@@ -49,6 +49,7 @@ namespace gef
 		virtual void SetFillMode(FillMode fill_mode) = 0;
 		virtual void SetDepthTest(DepthTest depth_test) = 0;
 		void DrawSkinnedMesh(const  MeshInstance& mesh_instance, const gef::Vec<Matrix44>& bone_matrices, bool use_default_shader = true);
+		void DrawSkinnedMesh(const  MeshInstance& mesh_instance, const Matrix44* bone_matrices, UInt32 bone_count, bool use_default_shader = true);
 		void SetShader( Shader* shader);
 		virtual void SetPrimitiveType(gef::PrimitiveType type) = 0;
 		virtual void DrawPrimitive(const IndexBuffer* index_buffer, int num_indices) = 0;
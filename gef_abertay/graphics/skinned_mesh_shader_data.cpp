@@ -4,7 +4,8 @@
 namespace gef
 {
 	SkinnedMeshShaderData::SkinnedMeshShaderData() :
-	bone_matrices_(NULL)
+	bone_matrices_(NULL),
+	bone_count_(0)
 	{
 	}
 }
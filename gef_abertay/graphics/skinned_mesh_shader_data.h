@@ -10,12 +10,15 @@ namespace gef
 	public:
 		SkinnedMeshShaderData();
 
-		const gef::Vec<Matrix44>* const bone_matrices() const { return bone_matrices_; }
+		const Matrix44* bone_matrices() const { return bone_matrices_; }
+		UInt32 bone_count() const { return bone_count_; }
 		
-		void set_bone_matrices(const gef::Vec<Matrix44>* const bone_matrices) { bone_matrices_ = bone_matrices; }
+		void set_bone_matrices(const gef::Vec<Matrix44>* const bone_matrices) { set_bone_matrices(bone_matrices->data(), (UInt32)bone_matrices->size()); }
+		void set_bone_matrices(const Matrix44* bone_matrices, UInt32 bone_count) { bone_matrices_ = bone_matrices; bone_count_ = bone_count; }
 
 	private:
-		const gef::Vec<Matrix44>* bone_matrices_;
+		const Matrix44* bone_matrices_;
+		UInt32 bone_count_;
 	};
 }
 
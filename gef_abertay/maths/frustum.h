@@ -2,6 +2,7 @@
 #define _GEF_MATHS_FRUSTUM_H
 
 #include <maths/plane.h>
+#include <gef.h>
 
 namespace gef
 {
@@ -26,6 +27,30 @@ namespace gef
 		FI_IN,
 		FI_INTERSECTS
 	};
+	/**
+	Spheres stored as a structure of arrays, so the batch tests can load several at a time.
+	*/
+	struct SphereBatch
+	{
+		const float* x;
+		const float* y;
+		const float* z;
+		const float* radius;
+	};
+
+	/**
+	Axis aligned boxes stored as a structure of arrays of centres and half extents.
+	*/
+	struct AabbBatch
+	{
+		const float* centre_x;
+		const float* centre_y;
+		const float* centre_z;
+		const float* extent_x;
+		const float* extent_y;
+		const float* extent_z;
+	};
+
 	class Frustum
 	{
 	public:
@@ -33,6 +58,19 @@ namespace gef
 		FrustumIntersect Intersects(const Aabb& aabb) const;
 		void ExtractPlanesD3D(const Matrix44& viewproj, bool normalise);
 		void ExtractPlanesGL(const Matrix44& viewproj, bool normalise);
+
+		/// @brief Tests a batch of objects, 8 at a time with AVX or 4 with SSE, scalar on other platforms.
+		/// The planes must be normalised for the sphere tests.
+		/// @param[out] visible		1 for every object that is at least partly inside, 0 otherwise. Must hold count values.
+		void Visible(const SphereBatch& spheres, UInt32 count, UInt8* visible) const;
+		void Visible(const AabbBatch& boxes, UInt32 count, UInt8* visible) const;
+		/// @brief Same as Visible but only the indices of the objects that are inside are written.
+		/// @param[out] visible_indices		Must hold count values.
+		/// @return The number of objects inside.
+		UInt32 Cull(const SphereBatch& spheres, UInt32 count, UInt32* visible_indices) const;
+		UInt32 Cull(const AabbBatch& boxes, UInt32 count, UInt32* visible_indices) const;
+
+		inline const Plane& plane(FrustumPlane index) const { return planes_[index]; }
 	protected:
 		Plane planes_[NUM_FRUSTUM_PLANES];
 	};
@@ -0,0 +1,249 @@
+#include <maths/frustum.h>
+#include <math.h>
+
+// the widest kernel the compiler is allowed to use, msvc only defines __AVX__ with /arch:AVX
+#if defined(__AVX__)
+#define GEF_FRUSTUM_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GEF_FRUSTUM_SSE
+#include <emmintrin.h>
+#endif
+
+namespace gef
+{
+	//
+	// Every kernel returns a bit mask with one bit set for every object that is not completely
+	// behind one of the planes. Spheres are out when the distance of the centre is below
+	// -radius, boxes when it's below -(the extents projected on the plane normal), which is
+	// the same as testing the corner furthest along the normal.
+	//
+
+	static inline bool SphereVisible(const Plane* planes, const SphereBatch& spheres, UInt32 i)
+	{
+		for (int p = 0; p < NUM_FRUSTUM_PLANES; ++p)
+		{
+			const Plane& plane = planes[p];
+			float distance = plane.a()*spheres.x[i] + plane.b()*spheres.y[i] + plane.c()*spheres.z[i] + plane.d();
+			if (distance < -spheres.radius[i])
+				return false;
+		}
+		return true;
+	}
+
+	static inline bool AabbVisible(const Plane* planes, const AabbBatch& boxes, UInt32 i)
+	{
+		for (int p = 0; p < NUM_FRUSTUM_PLANES; ++p)
+		{
+			const Plane& plane = planes[p];
+			float distance = plane.a()*boxes.centre_x[i] + plane.b()*boxes.centre_y[i] + plane.c()*boxes.centre_z[i] + plane.d();
+			float radius = fabsf(plane.a())*boxes.extent_x[i] + fabsf(plane.b())*boxes.extent_y[i] + fabsf(plane.c())*boxes.extent_z[i];
+			if (distance < -radius)
+				return false;
+		}
+		return true;
+	}
+
+#if defined(GEF_FRUSTUM_AVX)
+	static const UInt32 kBatchWidth = 8;
+	typedef __m256 BatchFloat;
+
+	static inline BatchFloat BatchSet(float value) { return _mm256_set1_ps(value); }
+
+	// the planes broadcast to every lane, done once per call
+	struct BatchPlanes
+	{
+		BatchFloat a[NUM_FRUSTUM_PLANES], b[NUM_FRUSTUM_PLANES], c[NUM_FRUSTUM_PLANES], d[NUM_FRUSTUM_PLANES];
+		BatchFloat abs_a[NUM_FRUSTUM_PLANES], abs_b[NUM_FRUSTUM_PLANES], abs_c[NUM_FRUSTUM_PLANES];
+	};
+
+	static inline UInt32 SphereMask(const BatchPlanes& planes, const SphereBatch& spheres, UInt32 i)
+	{
+		__m256 x = _mm256_loadu_ps(spheres.x + i);
+		__m256 y = _mm256_loadu_ps(spheres.y + i);
+		__m256 z = _mm256_loadu_ps(spheres.z + i);
+		__m256 neg_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.radius + i));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (int p = 0; p < NUM_FRUSTUM_PLANES; ++p)
+		{
+			__m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(planes.a[p], x), _mm256_mul_ps(planes.b[p], y)),
+				_mm256_add_ps(_mm256_mul_ps(planes.c[p], z), planes.d[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, neg_radius, _CMP_GE_OQ));
+		}
+
+		return (UInt32)_mm256_movemask_ps(inside);
+	}
+
+	static inline UInt32 AabbMask(const BatchPlanes& planes, const AabbBatch& boxes, UInt32 i)
+	{
+		__m256 cx = _mm256_loadu_ps(boxes.centre_x + i);
+		__m256 cy = _mm256_loadu_ps(boxes.centre_y + i);
+		__m256 cz = _mm256_loadu_ps(boxes.centre_z + i);
+		__m256 ex = _mm256_loadu_ps(boxes.extent_x + i);
+		__m256 ey = _mm256_loadu_ps(boxes.extent_y + i);
+		__m256 ez = _mm256_loadu_ps(boxes.extent_z + i);
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (int p = 0; p < NUM_FRUSTUM_PLANES; ++p)
+		{
+			__m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(planes.a[p], cx), _mm256_mul_ps(planes.b[p], cy)),
+				_mm256_add_ps(_mm256_mul_ps(planes.c[p], cz), planes.d[p]));
+			__m256 radius = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(planes.abs_a[p], ex), _mm256_mul_ps(planes.abs_b[p], ey)),
+				_mm256_mul_ps(planes.abs_c[p], ez));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		return (UInt32)_mm256_movemask_ps(inside);
+	}
+#elif defined(GEF_FRUSTUM_SSE)
+	static const UInt32 kBatchWidth = 4;
+	typedef __m128 BatchFloat;
+
+	static inline BatchFloat BatchSet(float value) { return _mm_set1_ps(value); }
+
+	struct BatchPlanes
+	{
+		BatchFloat a[NUM_FRUSTUM_PLANES], b[NUM_FRUSTUM_PLANES], c[NUM_FRUSTUM_PLANES], d[NUM_FRUSTUM_PLANES];
+		BatchFloat abs_a[NUM_FRUSTUM_PLANES], abs_b[NUM_FRUSTUM_PLANES], abs_c[NUM_FRUSTUM_PLANES];
+	};
+
+	static inline UInt32 SphereMask(const BatchPlanes& planes, const SphereBatch& spheres, UInt32 i)
+	{
+		__m128 x = _mm_loadu_ps(spheres.x + i);
+		__m128 y = _mm_loadu_ps(spheres.y + i);
+		__m128 z = _mm_loadu_ps(spheres.z + i);
+		__m128 neg_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.radius + i));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (int p = 0; p < NUM_FRUSTUM_PLANES; ++p)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planes.a[p], x), _mm_mul_ps(planes.b[p], y)),
+				_mm_add_ps(_mm_mul_ps(planes.c[p], z), planes.d[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, neg_radius));
+		}
+
+		return (UInt32)_mm_movemask_ps(inside);
+	}
+
+	static inline UInt32 AabbMask(const BatchPlanes& planes, const AabbBatch& boxes, UInt32 i)
+	{
+		__m128 cx = _mm_loadu_ps(boxes.centre_x + i);
+		__m128 cy = _mm_loadu_ps(boxes.centre_y + i);
+		__m128 cz = _mm_loadu_ps(boxes.centre_z + i);
+		__m128 ex = _mm_loadu_ps(boxes.extent_x + i);
+		__m128 ey = _mm_loadu_ps(boxes.extent_y + i);
+		__m128 ez = _mm_loadu_ps(boxes.extent_z + i);
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (int p = 0; p < NUM_FRUSTUM_PLANES; ++p)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planes.a[p], cx), _mm_mul_ps(planes.b[p], cy)),
+				_mm_add_ps(_mm_mul_ps(planes.c[p], cz), planes.d[p]));
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planes.abs_a[p], ex), _mm_mul_ps(planes.abs_b[p], ey)),
+				_mm_mul_ps(planes.abs_c[p], ez));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		}
+
+		return (UInt32)_mm_movemask_ps(inside);
+	}
+#endif
+
+#if defined(GEF_FRUSTUM_AVX) || defined(GEF_FRUSTUM_SSE)
+	static void LoadBatchPlanes(const Plane* planes, BatchPlanes& out)
+	{
+		for (int p = 0; p < NUM_FRUSTUM_PLANES; ++p)
+		{
+			out.a[p] = BatchSet(planes[p].a());
+			out.b[p] = BatchSet(planes[p].b());
+			out.c[p] = BatchSet(planes[p].c());
+			out.d[p] = BatchSet(planes[p].d());
+			out.abs_a[p] = BatchSet(fabsf(planes[p].a()));
+			out.abs_b[p] = BatchSet(fabsf(planes[p].b()));
+			out.abs_c[p] = BatchSet(fabsf(planes[p].c()));
+		}
+	}
+
+	static inline UInt32 BatchMask(const BatchPlanes& planes, const SphereBatch& spheres, UInt32 i) { return SphereMask(planes, spheres, i); }
+	static inline UInt32 BatchMask(const BatchPlanes& planes, const AabbBatch& boxes, UInt32 i) { return AabbMask(planes, boxes, i); }
+#endif
+
+	static inline bool ObjectVisible(const Plane* planes, const SphereBatch& spheres, UInt32 i) { return SphereVisible(planes, spheres, i); }
+	static inline bool ObjectVisible(const Plane* planes, const AabbBatch& boxes, UInt32 i) { return AabbVisible(planes, boxes, i); }
+
+	template <typename Batch>
+	static void VisibleBatch(const Plane* planes, const Batch& batch, UInt32 count, UInt8* visible)
+	{
+		UInt32 i = 0;
+#if defined(GEF_FRUSTUM_AVX) || defined(GEF_FRUSTUM_SSE)
+		BatchPlanes batch_planes;
+		LoadBatchPlanes(planes, batch_planes);
+
+		for (; i + kBatchWidth <= count; i += kBatchWidth)
+		{
+			UInt32 mask = BatchMask(batch_planes, batch, i);
+			for (UInt32 lane = 0; lane < kBatchWidth; ++lane)
+				visible[i + lane] = (UInt8)((mask >> lane) & 1);
+		}
+#endif
+		// whatever didn't fill a whole batch
+		for (; i < count; ++i)
+			visible[i] = ObjectVisible(planes, batch, i) ? 1 : 0;
+	}
+
+	template <typename Batch>
+	static UInt32 CullBatch(const Plane* planes, const Batch& batch, UInt32 count, UInt32* visible_indices)
+	{
+		UInt32 visible_count = 0;
+		UInt32 i = 0;
+#if defined(GEF_FRUSTUM_AVX) || defined(GEF_FRUSTUM_SSE)
+		BatchPlanes batch_planes;
+		LoadBatchPlanes(planes, batch_planes);
+
+		for (; i + kBatchWidth <= count; i += kBatchWidth)
+		{
+			UInt32 mask = BatchMask(batch_planes, batch, i);
+			// always write, only move forward when the object is visible. visible_count
+			// can never be past i + lane, so it stays in the array without branching
+			for (UInt32 lane = 0; lane < kBatchWidth; ++lane)
+			{
+				visible_indices[visible_count] = i + lane;
+				visible_count += (mask >> lane) & 1;
+			}
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			visible_indices[visible_count] = i;
+			visible_count += ObjectVisible(planes, batch, i) ? 1 : 0;
+		}
+
+		return visible_count;
+	}
+
+	void Frustum::Visible(const SphereBatch& spheres, UInt32 count, UInt8* visible) const
+	{
+		VisibleBatch(planes_, spheres, count, visible);
+	}
+
+	void Frustum::Visible(const AabbBatch& boxes, UInt32 count, UInt8* visible) const
+	{
+		VisibleBatch(planes_, boxes, count, visible);
+	}
+
+	UInt32 Frustum::Cull(const SphereBatch& spheres, UInt32 count, UInt32* visible_indices) const
+	{
+		return CullBatch(planes_, spheres, count, visible_indices);
+	}
+
+	UInt32 Frustum::Cull(const AabbBatch& boxes, UInt32 count, UInt32* visible_indices) const
+	{
+		return CullBatch(planes_, boxes, count, visible_indices);
+	}
+}
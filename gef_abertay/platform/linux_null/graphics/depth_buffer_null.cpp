@@ -0,0 +1,19 @@
+#include <platform/linux_null/graphics/depth_buffer_null.h>
+#include <system/allocator.h>
+
+namespace gef
+{
+	DepthBuffer* DepthBuffer::Create(const Platform& platform, UInt32 width, UInt32 height, IAllocator *alloc)
+	{
+		return alloc->make<DepthBufferNull>(width, height);
+	}
+
+	DepthBufferNull::DepthBufferNull(UInt32 width, UInt32 height) :
+		DepthBuffer(width, height)
+	{
+	}
+
+	DepthBufferNull::~DepthBufferNull()
+	{
+	}
+}
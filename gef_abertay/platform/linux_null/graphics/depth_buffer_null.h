@@ -0,0 +1,16 @@
+#ifndef _GEF_DEPTH_BUFFER_NULL_H
+#define _GEF_DEPTH_BUFFER_NULL_H
+
+#include <graphics/depth_buffer.h>
+
+namespace gef
+{
+	class DepthBufferNull : public DepthBuffer
+	{
+	public:
+		DepthBufferNull(UInt32 width, UInt32 height);
+		~DepthBufferNull();
+	};
+}
+
+#endif // _GEF_DEPTH_BUFFER_NULL_H
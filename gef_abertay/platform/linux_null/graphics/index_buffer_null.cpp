@@ -0,0 +1,50 @@
+#include <platform/linux_null/graphics/index_buffer_null.h>
+#include <system/allocator.h>
+#include <cstring>
+
+namespace gef
+{
+	IndexBuffer* IndexBuffer::Create(Platform& platform, IAllocator *alloc)
+	{
+		return alloc->make<IndexBufferNull>();
+	}
+
+	IndexBufferNull::IndexBufferNull()
+	{
+	}
+
+	IndexBufferNull::~IndexBufferNull()
+	{
+	}
+
+	bool IndexBufferNull::Init(const Platform& platform, const void* indices, const UInt32 num_indices, const UInt32 index_byte_size, const bool read_only)
+	{
+		num_indices_ = num_indices;
+		index_byte_size_ = index_byte_size;
+
+		if (!read_only)
+		{
+			// take a copy of the index data
+			index_data_ = g_alloc->allocDebug(index_byte_size * num_indices, "ibuf index data");
+			if (!index_data_)
+				return false;
+			if (indices)
+				memcpy(index_data_, indices, index_byte_size * num_indices);
+		}
+
+		return true;
+	}
+
+	void IndexBufferNull::Bind(const Platform& platform) const
+	{
+	}
+
+	void IndexBufferNull::Unbind(const Platform& platform) const
+	{
+	}
+
+	bool IndexBufferNull::Update(const Platform& platform)
+	{
+		return true;
+	}
+}
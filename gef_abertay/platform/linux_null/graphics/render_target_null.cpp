@@ -0,0 +1,27 @@
+#include <platform/linux_null/graphics/render_target_null.h>
+#include <system/allocator.h>
+
+namespace gef
+{
+	RenderTarget* RenderTarget::Create(const Platform& platform, const Int32 width, const Int32 height, IAllocator *alloc)
+	{
+		return alloc->make<RenderTargetNull>(platform, width, height);
+	}
+
+	RenderTargetNull::RenderTargetNull(const Platform& platform, const Int32 width, const Int32 height) :
+		RenderTarget(platform, width, height)
+	{
+	}
+
+	RenderTargetNull::~RenderTargetNull()
+	{
+	}
+
+	void RenderTargetNull::Begin(const Platform& platform)
+	{
+	}
+
+	void RenderTargetNull::End(const Platform& platform)
+	{
+	}
+}
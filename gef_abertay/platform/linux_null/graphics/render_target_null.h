@@ -0,0 +1,19 @@
+#ifndef _GEF_RENDER_TARGET_NULL_H
+#define _GEF_RENDER_TARGET_NULL_H
+
+#include <graphics/render_target.h>
+
+namespace gef
+{
+	class RenderTargetNull : public RenderTarget
+	{
+	public:
+		RenderTargetNull(const Platform& platform, const Int32 width, const Int32 height);
+		~RenderTargetNull();
+
+		void Begin(const Platform& platform);
+		void End(const Platform& platform);
+	};
+}
+
+#endif // _GEF_RENDER_TARGET_NULL_H
@@ -0,0 +1,63 @@
+#include <platform/linux_null/graphics/renderer_3d_null.h>
+#include <graphics/mesh_instance.h>
+#include <graphics/mesh.h>
+#include <graphics/shader.h>
+#include <system/allocator.h>
+
+namespace gef
+{
+	Renderer3D* Renderer3D::Create(Platform& platform, IAllocator *alloc)
+	{
+		return alloc->make<Renderer3DNull>(platform);
+	}
+
+	Renderer3DNull::Renderer3DNull(Platform& platform) :
+		Renderer3D(platform),
+		draw_calls_(0)
+	{
+		SetShader(NULL);
+	}
+
+	Renderer3DNull::~Renderer3DNull()
+	{
+	}
+
+	void Renderer3DNull::Begin(bool clear)
+	{
+		draw_calls_ = 0;
+	}
+
+	void Renderer3DNull::End()
+	{
+	}
+
+	void Renderer3DNull::DrawMesh(const MeshInstance& mesh_instance)
+	{
+		if (mesh_instance.mesh())
+			DrawMesh(*mesh_instance.mesh(), mesh_instance.transform());
+	}
+
+	void Renderer3DNull::DrawMesh(const Mesh& mesh, const gef::Matrix44& matrix)
+	{
+		// the inverse transpose is only needed by the shaders, so it's skipped
+		world_matrix_ = matrix;
+		draw_calls_ += mesh.num_primitives();
+	}
+
+	void Renderer3DNull::SetFillMode(FillMode fill_mode)
+	{
+	}
+
+	void Renderer3DNull::SetDepthTest(DepthTest depth_test)
+	{
+	}
+
+	void Renderer3DNull::SetPrimitiveType(gef::PrimitiveType type)
+	{
+	}
+
+	void Renderer3DNull::DrawPrimitive(const IndexBuffer* index_buffer, int num_indices)
+	{
+		draw_calls_++;
+	}
+}
@@ -0,0 +1,32 @@
+#ifndef _GEF_RENDERER_3D_NULL_H
+#define _GEF_RENDERER_3D_NULL_H
+
+#include <graphics/renderer_3d.h>
+
+namespace gef
+{
+	// runs the shaders' cpu side but draws nothing, it only counts what it was asked to draw
+	class Renderer3DNull : public Renderer3D
+	{
+	public:
+		Renderer3DNull(Platform& platform);
+		~Renderer3DNull();
+
+		void Begin(bool clear = true);
+		void End();
+		void DrawMesh(const MeshInstance& mesh_instance);
+		void DrawMesh(const Mesh& mesh, const gef::Matrix44& matrix);
+		void SetFillMode(FillMode fill_mode);
+		void SetDepthTest(DepthTest depth_test);
+		void SetPrimitiveType(gef::PrimitiveType type);
+		void DrawPrimitive(const IndexBuffer* index_buffer, int num_indices);
+
+		// since the last Begin
+		inline UInt32 draw_calls() const { return draw_calls_; }
+
+	private:
+		UInt32 draw_calls_;
+	};
+}
+
+#endif // _GEF_RENDERER_3D_NULL_H
@@ -0,0 +1,52 @@
+#include <platform/linux_null/graphics/shader_interface_null.h>
+#include <system/allocator.h>
+
+namespace gef
+{
+	ShaderInterface* ShaderInterface::Create(const Platform& platform, IAllocator *alloc)
+	{
+		return alloc->make<ShaderInterfaceNull>();
+	}
+
+	ShaderInterfaceNull::ShaderInterfaceNull()
+	{
+	}
+
+	ShaderInterfaceNull::~ShaderInterfaceNull()
+	{
+	}
+
+	bool ShaderInterfaceNull::CreateProgram()
+	{
+		AllocateVariableData();
+		return true;
+	}
+
+	void ShaderInterfaceNull::CreateVertexFormat()
+	{
+	}
+
+	void ShaderInterfaceNull::UseProgram()
+	{
+	}
+
+	void ShaderInterfaceNull::SetVariableData()
+	{
+	}
+
+	void ShaderInterfaceNull::SetVertexFormat()
+	{
+	}
+
+	void ShaderInterfaceNull::ClearVertexFormat()
+	{
+	}
+
+	void ShaderInterfaceNull::BindTextureResources(const Platform& platform) const
+	{
+	}
+
+	void ShaderInterfaceNull::UnbindTextureResources(const Platform& platform) const
+	{
+	}
+}
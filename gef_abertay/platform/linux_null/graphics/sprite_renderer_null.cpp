@@ -0,0 +1,34 @@
+#include <platform/linux_null/graphics/sprite_renderer_null.h>
+#include <system/allocator.h>
+
+namespace gef
+{
+	SpriteRenderer* SpriteRenderer::Create(Platform& platform, IAllocator *alloc)
+	{
+		return alloc->make<SpriteRendererNull>(platform);
+	}
+
+	SpriteRendererNull::SpriteRendererNull(Platform& platform) :
+		SpriteRenderer(platform),
+		sprite_count_(0)
+	{
+	}
+
+	SpriteRendererNull::~SpriteRendererNull()
+	{
+	}
+
+	void SpriteRendererNull::Begin(bool clear)
+	{
+		sprite_count_ = 0;
+	}
+
+	void SpriteRendererNull::DrawSprite(const Sprite& sprite, const gef::Matrix33& transform)
+	{
+		sprite_count_++;
+	}
+
+	void SpriteRendererNull::End()
+	{
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef _GEF_SPRITE_RENDERER_NULL_H
+#define _GEF_SPRITE_RENDERER_NULL_H
+
+#include <graphics/sprite_renderer.h>
+
+namespace gef
+{
+	class SpriteRendererNull : public SpriteRenderer
+	{
+	public:
+		SpriteRendererNull(Platform& platform);
+		~SpriteRendererNull();
+
+		void Begin(bool clear = true);
+		void DrawSprite(const Sprite& sprite, const gef::Matrix33& transform);
+		void End();
+
+		// since the last Begin
+		inline UInt32 sprite_count() const { return sprite_count_; }
+
+	private:
+		UInt32 sprite_count_;
+	};
+}
+
+#endif // _GEF_SPRITE_RENDERER_NULL_H
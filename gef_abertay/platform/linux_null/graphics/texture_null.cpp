@@ -0,0 +1,30 @@
+#include <platform/linux_null/graphics/texture_null.h>
+#include <graphics/image_data.h>
+#include <system/allocator.h>
+
+namespace gef
+{
+	Texture* Texture::Create(const Platform& platform, const ImageData& image_data, IAllocator *alloc)
+	{
+		return alloc->make<TextureNull>(platform, image_data);
+	}
+
+	TextureNull::TextureNull(const Platform& platform, const ImageData& image_data) :
+		Texture(platform, image_data)
+	{
+		width_ = image_data.width();
+		height_ = image_data.height();
+	}
+
+	TextureNull::~TextureNull()
+	{
+	}
+
+	void TextureNull::Bind(const Platform& platform, const int texture_stage_num) const
+	{
+	}
+
+	void TextureNull::Unbind(const Platform& platform, const int texture_stage_num) const
+	{
+	}
+}
@@ -0,0 +1,20 @@
+#ifndef _GEF_TEXTURE_NULL_H
+#define _GEF_TEXTURE_NULL_H
+
+#include <graphics/texture.h>
+
+namespace gef
+{
+	// only keeps the size, the pixels are never uploaded anywhere
+	class TextureNull : public Texture
+	{
+	public:
+		TextureNull(const Platform& platform, const ImageData& image_data);
+		~TextureNull();
+
+		void Bind(const Platform& platform, const int texture_stage_num) const;
+		void Unbind(const Platform& platform, const int texture_stage_num) const;
+	};
+}
+
+#endif // _GEF_TEXTURE_NULL_H
@@ -0,0 +1,58 @@
+#include <platform/linux_null/graphics/vertex_buffer_null.h>
+#include <system/allocator.h>
+#include <cstring>
+
+namespace gef
+{
+	VertexBuffer* VertexBuffer::Create(Platform& platform, IAllocator *alloc)
+	{
+		return alloc->make<VertexBufferNull>();
+	}
+
+	VertexBufferNull::VertexBufferNull()
+	{
+	}
+
+	VertexBufferNull::~VertexBufferNull()
+	{
+	}
+
+	bool VertexBufferNull::Init(const Platform& platform, void* vertices, const UInt32 num_vertices, const UInt32 vertex_byte_size, const bool read_only)
+	{
+		// same as d3d11, the non const version doesn't take a copy
+		num_vertices_ = num_vertices;
+		vertex_byte_size_ = vertex_byte_size;
+		return true;
+	}
+
+	bool VertexBufferNull::Init(const Platform& platform, const void* vertices, const UInt32 num_vertices, const UInt32 vertex_byte_size, const bool read_only)
+	{
+		num_vertices_ = num_vertices;
+		vertex_byte_size_ = vertex_byte_size;
+
+		if (!read_only)
+		{
+			// take a copy of the vertex data
+			vertex_data_ = g_alloc->allocDebug(vertex_byte_size * num_vertices, "vbuf vertex data");
+			if (!vertex_data_)
+				return false;
+			if (vertices)
+				memcpy(vertex_data_, vertices, vertex_byte_size * num_vertices);
+		}
+
+		return true;
+	}
+
+	bool VertexBufferNull::Update(const Platform& platform)
+	{
+		return true;
+	}
+
+	void VertexBufferNull::Bind(const Platform& platform) const
+	{
+	}
+
+	void VertexBufferNull::Unbind(const Platform& platform) const
+	{
+	}
+}
@@ -0,0 +1,19 @@
+#include <platform/linux_null/input/input_manager_null.h>
+#include <system/allocator.h>
+
+namespace gef
+{
+	InputManager* InputManager::Create(Platform& platform, IAllocator *alloc)
+	{
+		return alloc->make<InputManagerNull>(platform);
+	}
+
+	InputManagerNull::InputManagerNull(Platform& platform) :
+		InputManager(platform)
+	{
+	}
+
+	InputManagerNull::~InputManagerNull()
+	{
+	}
+}
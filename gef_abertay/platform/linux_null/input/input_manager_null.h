@@ -0,0 +1,17 @@
+#ifndef _GEF_INPUT_MANAGER_NULL_H
+#define _GEF_INPUT_MANAGER_NULL_H
+
+#include <input/input_manager.h>
+
+namespace gef
+{
+	// no devices, touch_manager(), keyboard() and controller_input() are all NULL
+	class InputManagerNull : public InputManager
+	{
+	public:
+		InputManagerNull(Platform& platform);
+		~InputManagerNull();
+	};
+}
+
+#endif // _GEF_INPUT_MANAGER_NULL_H
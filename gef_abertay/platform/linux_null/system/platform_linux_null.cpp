@@ -0,0 +1,96 @@
+#include <platform/linux_null/system/platform_linux_null.h>
+#include <graphics/texture.h>
+#include <system/allocator.h>
+#include <maths/matrix44.h>
+
+namespace gef
+{
+	PlatformLinuxNull::PlatformLinuxNull(UInt32 width, UInt32 height) :
+		frame_time_(1.0f / 60.0f),
+		frame_count_(0)
+	{
+		set_width(width);
+		set_height(height);
+		default_texture_ = Texture::CreateCheckerTexture(16, 1, *this);
+	}
+
+	PlatformLinuxNull::~PlatformLinuxNull()
+	{
+		g_alloc->destroy(default_texture_);
+		default_texture_ = NULL;
+	}
+
+	bool PlatformLinuxNull::Update()
+	{
+		frame_count_++;
+		return true;
+	}
+
+	float PlatformLinuxNull::GetFrameTime()
+	{
+		return frame_time_;
+	}
+
+	void PlatformLinuxNull::PreRender()
+	{
+	}
+
+	void PlatformLinuxNull::PostRender()
+	{
+	}
+
+	void PlatformLinuxNull::Clear() const
+	{
+	}
+
+	std::string PlatformLinuxNull::FormatFilename(const std::string& filename) const
+	{
+		return filename;
+	}
+
+	std::string PlatformLinuxNull::FormatFilename(const char* filename) const
+	{
+		return std::string(filename);
+	}
+
+	// the projections are the same as d3d11 so that culling and picking give the same results
+	Matrix44 PlatformLinuxNull::PerspectiveProjectionFov(const float fov, const float aspect_ratio, const float near_distance, const float far_distance) const
+	{
+		Matrix44 projection_matrix;
+		projection_matrix.PerspectiveFovD3D(fov, aspect_ratio, near_distance, far_distance);
+		return projection_matrix;
+	}
+
+	Matrix44 PlatformLinuxNull::PerspectiveProjectionFrustum(const float left, const float right, const float top, const float bottom, const float near_distance, const float far_distance) const
+	{
+		Matrix44 projection_matrix;
+		projection_matrix.PerspectiveFrustumD3D(left, right, top, bottom, near_distance, far_distance);
+		return projection_matrix;
+	}
+
+	Matrix44 PlatformLinuxNull::OrthographicFrustum(const float left, const float right, const float top, const float bottom, const float near_distance, const float far_distance) const
+	{
+		Matrix44 projection_matrix;
+		projection_matrix.OrthographicFrustumD3D(left, right, top, bottom, near_distance, far_distance);
+		return projection_matrix;
+	}
+
+	void PlatformLinuxNull::BeginScene() const
+	{
+	}
+
+	void PlatformLinuxNull::EndScene() const
+	{
+	}
+
+	// the sources are loaded but never compiled, so the d3d11 ones are good enough
+	const char* PlatformLinuxNull::GetShaderDirectory() const
+	{
+		return "d3d11";
+	}
+
+	const char* PlatformLinuxNull::GetShaderFileExtension() const
+	{
+		return "hlsl";
+	}
+}
@@ -0,0 +1,47 @@
+#ifndef _GEF_PLATFORM_LINUX_NULL_H
+#define _GEF_PLATFORM_LINUX_NULL_H
+
+#include <system/platform.h>
+
+namespace gef
+{
+	// platform without a window or a graphics device, everything that would
+	// be sent to the gpu is kept on the cpu or thrown away.
+	// shader sources are still read from disk so the working directory has to be
+	// the media folder, like on windows
+	class PlatformLinuxNull : public Platform
+	{
+	public:
+		PlatformLinuxNull(UInt32 width = 960, UInt32 height = 544);
+		~PlatformLinuxNull();
+
+		bool Update();
+		float GetFrameTime();
+		void PreRender();
+		void PostRender();
+		void Clear() const;
+
+		std::string FormatFilename(const std::string& filename) const;
+		std::string FormatFilename(const char* filename) const;
+
+		Matrix44 PerspectiveProjectionFov(const float fov, const float aspect_ratio, const float near_distance, const float far_distance) const;
+		Matrix44 PerspectiveProjectionFrustum(const float left, const float right, const float top, const float bottom, const float near_distance, const float far_distance) const;
+		Matrix44 OrthographicFrustum(const float left, const float right, const float top, const float bottom, const float near_distance, const float far_distance) const;
+
+		void BeginScene() const;
+		void EndScene() const;
+		const char* GetShaderDirectory() const;
+		const char* GetShaderFileExtension() const;
+
+		// there is no vsync to time the frames with, so every frame takes the same time.
+		// this keeps batch runs reproducible
+		inline void set_frame_time(float frame_time) { frame_time_ = frame_time; }
+		inline UInt32 frame_count() const { return frame_count_; }
+
+	private:
+		float frame_time_;
+		UInt32 frame_count_;
+	};
+}
+
+#endif // _GEF_PLATFORM_LINUX_NULL_H
@@ -8,13 +8,15 @@
 #include "file_std.h"
 #include <sys/stat.h>
 
+#include <system/allocator.h>
+
 
 
 namespace gef
 {
-    gef::File* gef::File::Create()
+    File *File::Create(IAllocator *alloc)
     {
-        return new gef::FileStd();
+        return alloc->make<FileStd>();
     }
 
 	FileStd::FileStd()
@@ -160,7 +160,7 @@ namespace gef
 
 		// bone matrices
 		if(shader_data_->bone_matrices())
-			memcpy(bone_matrices_data_.bone_matrices, &(*shader_data_->bone_matrices())[0], shader_data_->bone_matrices()->size()*sizeof(Matrix44));
+			memcpy(bone_matrices_data_.bone_matrices, shader_data_->bone_matrices(), shader_data_->bone_count()*sizeof(Matrix44));
 
 		// set the vertex program constants
 		void *vertex_shader_data_buffer;
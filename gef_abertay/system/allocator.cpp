@@ -2,6 +2,7 @@
 
 #include <unordered_map>
 #include <string>
+#include <mutex>
 #include <assert.h>
 
 #include <gef.h>
@@ -44,9 +45,14 @@ struct DebugAlloc : public IAllocator, public IDebugAllocator {
 
     std::unordered_map<void *, DebugInfo> allocations;
     std::unordered_map<void *, DebugInfo> freed_allocs;
-    std::vector<std::string> extra_info;
+    // every thread keeps its own stack, otherwise jobs would mix up each other's info
+    static thread_local std::vector<std::string> extra_info;
+    // the job system can allocate from any thread
+    std::mutex mtx;
 };
 
+thread_local std::vector<std::string> DebugAlloc::extra_info;
+
 struct NullAlloc : public IAllocator, public IDebugAllocator {
     virtual void *alloc(size_t n) override { (void)n; return nullptr; }
     virtual void dealloc(void *ptr) override { (void)ptr; }
@@ -94,6 +100,7 @@ void DebugAlloc::cleanup() {
 }
 
 void *DebugAlloc::alloc(size_t n) {
+    std::lock_guard<std::mutex> lock(mtx);
     void *ptr = calloc(1, n);
     DebugInfo info = { "n/a", n };
     allocations[ptr] = info;
@@ -102,6 +109,7 @@ void *DebugAlloc::alloc(size_t n) {
 }
 
 void *DebugAlloc::allocDebug(size_t n, const char *type_name) {
+    std::lock_guard<std::mutex> lock(mtx);
     void *ptr = calloc(1, n);
     DebugInfo info = { type_name, n };
     allocations[ptr] = info;
@@ -115,6 +123,7 @@ void DebugAlloc::dealloc(void *ptr) {
 #else
     if (!ptr) return;
 
+    std::lock_guard<std::mutex> lock(mtx);
     auto iter = allocations.find(ptr);
     if (iter != allocations.end()) {
         freed_allocs[ptr] = std::move(iter->second);
@@ -167,8 +176,14 @@ void DebugAlloc::addAllocation(void *ptr, const DebugInfo &deb_info) {
     memset(&info, 0, sizeof(info));
     info.ptr = ptr;
     info.size = deb_info.size;
+#ifdef _WIN32
     strncpy_s(info.name, deb_info.name.c_str(), gef::min(sizeof(info.name) - 1, deb_info.name.size()));
     strncpy_s(info.extra, extra.c_str(), gef::min(sizeof(info.extra) - 1, extra.size()));
+#else
+    // info was cleared, so the last character is always left as the terminator
+    strncpy(info.name, deb_info.name.c_str(), gef::min(sizeof(info.name) - 1, deb_info.name.size()));
+    strncpy(info.extra, extra.c_str(), gef::min(sizeof(info.extra) - 1, extra.size()));
+#endif
     
     // add allocation in sorted vector
     bool found = false;
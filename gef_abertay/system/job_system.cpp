@@ -0,0 +1,263 @@
+#include "job_system.h"
+
+#include <assert.h>
+
+#include <system/allocator.h>
+#include <maths/math_utils.h>
+
+namespace gef {
+
+// index in JobSystem::queues of the thread we're running on, the main thread is always 0
+static thread_local uint32_t thread_index = 0;
+
+struct SpinLock {
+	SpinLock(std::atomic_flag &flag) : flag(flag) {
+		while (flag.test_and_set(std::memory_order_acquire)) {
+			std::this_thread::yield();
+		}
+	}
+	~SpinLock() {
+		flag.clear(std::memory_order_release);
+	}
+	std::atomic_flag &flag;
+};
+
+// == WORK QUEUE ====================================
+
+void JobSystem::WorkQueue::push(Job *job) {
+	std::lock_guard<std::mutex> lock(mtx);
+	assert((tail - head) < max_jobs && "too many jobs in the queue");
+	jobs[tail % max_jobs] = job;
+	tail++;
+}
+
+Job *JobSystem::WorkQueue::pop(bool fifo) {
+	std::lock_guard<std::mutex> lock(mtx);
+	if (head == tail) {
+		return nullptr;
+	}
+	if (fifo) {
+		return jobs[head++ % max_jobs];
+	}
+	return jobs[--tail % max_jobs];
+}
+
+Job *JobSystem::WorkQueue::steal() {
+	std::lock_guard<std::mutex> lock(mtx);
+	if (head == tail) {
+		return nullptr;
+	}
+	return jobs[head++ % max_jobs];
+}
+
+// == JOB SYSTEM ====================================
+
+JobSystem::~JobSystem() {
+	cleanup();
+}
+
+void JobSystem::init(int worker_count) {
+	cleanup();
+
+	if (worker_count < 0) {
+		worker_count = gef::max((int)std::thread::hardware_concurrency() - 1, 0);
+	}
+
+	thread_count = (uint32_t)worker_count + 1;
+	job_pool = g_alloc->makeArr<Job>(max_jobs);
+	queues = g_alloc->makeArr<WorkQueue>(thread_count);
+	next_job = 0;
+	queued = 0;
+	pending = 0;
+	running = true;
+
+	thread_index = 0;
+	workers.reserve(worker_count);
+	for (uint32_t i = 1; i < thread_count; ++i) {
+		workers.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+}
+
+void JobSystem::cleanup() {
+	if (!thread_count) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(wake_mtx);
+		running = false;
+	}
+	wake_cv.notify_all();
+
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+
+	workers.destroy();
+	g_alloc->destroyArr(queues);
+	g_alloc->destroyArr(job_pool);
+	thread_count = 0;
+}
+
+Job *JobSystem::create(JobFunc func, void *user_data, uint32_t begin, uint32_t end, Job *parent) {
+	assert(job_pool);
+	Job *job = &job_pool[next_job.fetch_add(1) % max_jobs];
+	assert(job->unfinished.load() == 0 && "reusing a job that hasn't finished yet, increase max_jobs");
+
+	job->func = func;
+	job->user_data = user_data;
+	job->begin = begin;
+	job->end = end;
+	job->parent = parent;
+	job->unfinished = 1;
+	job->dependencies = 1;
+	job->continuation_count = 0;
+	job->finished = false;
+
+	if (parent) {
+		parent->unfinished.fetch_add(1);
+	}
+
+	return job;
+}
+
+void JobSystem::addDependency(Job *job, Job *dependency) {
+	SpinLock lock(dependency->lock);
+	if (dependency->finished) {
+		return;
+	}
+
+	assert(dependency->continuation_count < Job::max_continuations);
+	dependency->continuations[dependency->continuation_count++] = job;
+	job->dependencies.fetch_add(1);
+}
+
+void JobSystem::run(Job *job) {
+	// remove the "not run yet" dependency
+	if (job->dependencies.fetch_sub(1) == 1) {
+		push(job);
+	}
+}
+
+void JobSystem::wait(Job *job) {
+	while (!isFinished(job)) {
+		if (!runOne()) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool JobSystem::runOne() {
+	Job *job = getJob();
+	if (!job) {
+		return false;
+	}
+	execute(job);
+	return true;
+}
+
+void JobSystem::waitIdle() {
+	if (!thread_count) {
+		return;
+	}
+	while (!isIdle()) {
+		if (!runOne()) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t batch_size, JobFunc func, void *user_data) {
+	if (!count) {
+		return;
+	}
+
+	batch_size = gef::max(batch_size, 1u);
+
+	Job *root = create(nullptr, nullptr);
+	for (uint32_t begin = 0; begin < count; begin += batch_size) {
+		run(create(func, user_data, begin, gef::min(begin + batch_size, count), root));
+	}
+	run(root);
+	wait(root);
+}
+
+uint32_t JobSystem::getThreadIndex() const {
+	return thread_index;
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+	thread_index = index;
+
+	while (running) {
+		if (Job *job = getJob()) {
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(wake_mtx);
+		wake_cv.wait(lock, [this]() { return queued.load() > 0 || !running; });
+	}
+}
+
+void JobSystem::push(Job *job) {
+	pending.fetch_add(1);
+	queues[thread_index].push(job);
+	queued.fetch_add(1);
+
+	if (!isDeterministic()) {
+		// lock so that a worker can't miss the notification between checking <queued> and sleeping
+		{ std::lock_guard<std::mutex> lock(wake_mtx); }
+		wake_cv.notify_one();
+	}
+}
+
+Job *JobSystem::getJob() {
+	Job *job = queues[thread_index].pop(isDeterministic());
+
+	for (uint32_t i = 1; !job && i < thread_count; ++i) {
+		job = queues[(thread_index + i) % thread_count].steal();
+	}
+
+	if (job) {
+		queued.fetch_sub(1);
+	}
+
+	return job;
+}
+
+void JobSystem::execute(Job *job) {
+	if (job->func) {
+		job->func(job->user_data, job->begin, job->end);
+	}
+	finish(job);
+	pending.fetch_sub(1);
+}
+
+void JobSystem::finish(Job *job) {
+	if (job->unfinished.fetch_sub(1) != 1) {
+		return;
+	}
+
+	Job *continuations[Job::max_continuations];
+	uint32_t continuation_count = 0;
+
+	{
+		SpinLock lock(job->lock);
+		job->finished = true;
+		continuation_count = job->continuation_count;
+		for (uint32_t i = 0; i < continuation_count; ++i) {
+			continuations[i] = job->continuations[i];
+		}
+	}
+
+	for (uint32_t i = 0; i < continuation_count; ++i) {
+		run(continuations[i]);
+	}
+
+	if (job->parent) {
+		finish(job->parent);
+	}
+}
+
+} // namespace gef
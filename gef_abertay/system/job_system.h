@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+
+#include <system/vec.h>
+
+namespace gef {
+
+class JobSystem;
+
+// function called by a job, it should do the work for the items in [begin, end)
+using JobFunc = void (*)(void *user_data, uint32_t begin, uint32_t end);
+
+struct Job {
+	static constexpr uint32_t max_continuations = 8;
+
+	JobFunc func = nullptr;
+	void *user_data = nullptr;
+	uint32_t begin = 0;
+	uint32_t end = 0;
+	Job *parent = nullptr;
+	// the job itself plus all of its unfinished children
+	std::atomic<int32_t> unfinished = 0;
+	// jobs that need to finish before this one can start, plus one until run is called
+	std::atomic<int32_t> dependencies = 0;
+	// jobs waiting on this one, protected by <lock>
+	Job *continuations[max_continuations];
+	uint32_t continuation_count = 0;
+	bool finished = false;
+	std::atomic_flag lock = ATOMIC_FLAG_INIT;
+};
+
+// small work-stealing scheduler.
+// every thread (the main thread is always thread 0) has its own deque of jobs,
+// it pops jobs from the back of its own deque and, when that is empty, it steals
+// from the front of the other threads' deques.
+// with 0 workers it runs in deterministic mode: nothing runs until someone waits,
+// then all the jobs run on the waiting thread in the order they were queued
+class JobSystem {
+public:
+	// jobs are taken from a ring buffer, a job pointer is valid until <max_jobs> more are created
+	static constexpr uint32_t max_jobs = 4096;
+
+	JobSystem() = default;
+	JobSystem(const JobSystem &) = delete;
+	~JobSystem();
+
+	// <worker_count> < 0 uses one worker per core, minus the main thread.
+	// jobs that are still queued are dropped, see waitIdle
+	void init(int worker_count = -1);
+	void cleanup();
+
+	// creates a job that calls <func> for [begin, end). <func> can be null, which is useful
+	// for jobs that only group their children. if <parent> is not null it won't be
+	// finished until this job is finished too
+	Job *create(JobFunc func, void *user_data, uint32_t begin = 0, uint32_t end = 1, Job *parent = nullptr);
+	// <job> won't start until <dependency> is finished, call it before running <job>
+	void addDependency(Job *job, Job *dependency);
+	// queues the job, it'll start as soon as all of its dependencies are finished
+	void run(Job *job);
+	// runs other jobs while waiting for <job> and its children to be finished
+	void wait(Job *job);
+	bool isFinished(const Job *job) const { return job->unfinished.load() == 0; }
+	// runs one of the queued jobs on the calling thread, returns false if there weren't any.
+	// useful to help out while waiting for something that isn't a job
+	bool runOne();
+	// runs jobs on the calling thread until none are queued or running anywhere. call it
+	// before init or cleanup when other code may still have jobs in flight on this system
+	void waitIdle();
+	bool isIdle() const { return pending.load() == 0; }
+
+	// splits [0, count) in batches of <batch_size> and waits for all of them to finish
+	void parallelFor(uint32_t count, uint32_t batch_size, JobFunc func, void *user_data);
+
+	// same as above, <func> is anything callable as func(begin, end)
+	template<typename TFunc>
+	void parallelFor(uint32_t count, uint32_t batch_size, TFunc &&func) {
+		using Func = std::remove_reference_t<TFunc>;
+		parallelFor(
+			count, batch_size,
+			[](void *user_data, uint32_t begin, uint32_t end) {
+				(*(Func *)user_data)(begin, end);
+			},
+			(void *)&func
+		);
+	}
+
+	// number of threads that run jobs, including the main thread
+	uint32_t getThreadCount() const { return thread_count; }
+	// index of the calling thread, between 0 and getThreadCount() - 1
+	uint32_t getThreadIndex() const;
+	bool isDeterministic() const { return thread_count == 1; }
+
+private:
+	struct WorkQueue {
+		void push(Job *job);
+		// owner side, from the back (or the front in deterministic mode)
+		Job *pop(bool fifo);
+		// thieves side, always from the front
+		Job *steal();
+
+		std::mutex mtx;
+		Job *jobs[max_jobs];
+		uint32_t head = 0;
+		uint32_t tail = 0;
+	};
+
+	void workerLoop(uint32_t index);
+	void push(Job *job);
+	Job *getJob();
+	void execute(Job *job);
+	void finish(Job *job);
+
+	Job *job_pool = nullptr;
+	std::atomic<uint32_t> next_job = 0;
+
+	WorkQueue *queues = nullptr;
+	uint32_t thread_count = 0;
+	gef::Vec<std::thread> workers;
+
+	std::mutex wake_mtx;
+	std::condition_variable wake_cv;
+	std::atomic<int32_t> queued = 0;
+	// queued plus running, a job queues the ones it starts before it stops counting
+	std::atomic<int32_t> pending = 0;
+	std::atomic<bool> running = false;
+};
+
+} // namespace gef
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <assert.h>
+#include <stdint.h>
 #include <initializer_list>
 #include <functional>
 
@@ -127,8 +128,8 @@ namespace gef {
 			}
 			else if (n > len) {
 				reserve(n);
-				for (size_t i = 0; i < n; ++i) {
-					new (buf + i) T(std::move(args)...);
+				for (size_t i = len; i < n; ++i) {
+					new (buf + i) T(args...);
 				}
 			}
 			len = n;
@@ -174,6 +175,7 @@ namespace gef {
 			for (size_t i = index; i < len; ++i) {
 				buf[i] = std::move(buf[i + 1]);
 			}
+			buf[len].~T();
 		}
 
 		// erases the item at the position specified by the iterator by swapping it
@@ -194,7 +196,11 @@ namespace gef {
 			if (index >= len) {
 				return;
 			}
-			buf[index] = std::move(buf[--len]);
+			len--;
+			if (index != len) {
+				buf[index] = std::move(buf[len]);
+			}
+			buf[len].~T();
 		}
 
 		// reallocates the vector to be able to hold at least <newcap> items